@@ -3,20 +3,32 @@ PHP_ARG_ENABLE(pht, whether to enable pht support,
 
 if test "$PHP_PHT" != "no"; then
     PHP_NEW_EXTENSION(pht, pht.c \
+        src/pht_alloc.c \
         src/pht_copy.c \
         src/pht_zend.c \
         src/pht_entry.c \
         src/pht_string.c \
+        src/pht_time.c \
+        src/pht_encoding.c \
+        src/pht_shared_string.c \
         src/ds/pht_queue.c \
+        src/ds/pht_priority_queue.c \
         src/ds/pht_hashtable.c \
         src/ds/pht_vector.c \
+        src/ds/pht_ring_buffer.c \
         src/classes/thread.c \
+        src/classes/pool.c \
+        src/classes/future.c \
         src/classes/threaded.c \
         src/classes/runnable.c \
         src/classes/queue.c \
         src/classes/hashtable.c \
         src/classes/vector.c \
-        src/classes/atomic_integer.c, $ext_shared,, -DZEND_ENABLE_STATIC_TSRMLS_CACHE=1)
+        src/classes/atomic_integer.c \
+        src/classes/immutable_array.c \
+        src/classes/numeric_vector.c \
+        src/classes/buffer.c \
+        src/classes/concurrent_queue.c, $ext_shared,, -DZEND_ENABLE_STATIC_TSRMLS_CACHE=1)
 
     EXTRA_CFLAGS="$EXTRA_CFLAGS -std=gnu99"
     PHP_SUBST(EXTRA_CFLAGS)
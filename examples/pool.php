@@ -1,6 +1,6 @@
 <?php
 
-use pht\{Thread, Runnable, Queue};
+use pht\{Pool, Runnable, Queue};
 
 class Task implements Runnable
 {
@@ -13,65 +13,26 @@ class Task implements Runnable
 
     public function run()
     {
+        $this->q->lock();
         $this->q->push(rand());
-    }
-}
-
-class Pool
-{
-    private $poolSize = 0;
-    private $q = NULL;
-    private $threads = [];
-
-    public function __construct(int $poolSize, Queue $q = NULL)
-    {
-        if ($poolSize < 1) {
-            throw new Exception("Invalid pool size given");
-        }
-
-        $this->poolSize = $poolSize;
-        $this->q = $q;
-
-        for ($i = 0; $i < $this->poolSize; ++$i) {
-            $this->threads[] = new Thread();
-            $this->threads[$i]->start();
-        }
-    }
-
-    public function addClassTask(string $className, ...$ctorArgs) : void
-    {
-        static $i = 0;
-
-        $this->threads[$i]->addClassTask($className, ...$ctorArgs);
-
-        $i = ($i + 1) % $this->poolSize;
-    }
-
-    public function close() : void
-    {
-        for ($i = 0; $i < $this->poolSize; ++$i) {
-            $this->threads[$i]->join();
-        }
+        $this->q->unlock();
     }
 }
 
 $q = new Queue();
-$pool = new Pool(5, $q);
+$pool = new Pool(5);
 $taskCount = 10;
 
+$pool->start();
+
+// tasks are distributed across the pool's threads, where idle threads will
+// steal tasks from the threads that have the longest backlogs
 for ($i = 0; $i < $taskCount; ++$i) {
     $pool->addClassTask(Task::class, $q);
 }
 
-for ($i = 0; $i < $taskCount; ) {
-    $q->lock();
-
-    if ($q->size()) {
-        var_dump($q->pop());
-        ++$i;
-    }
-
-    $q->unlock();
+for ($i = 0; $i < $taskCount; ++$i) {
+    var_dump($q->waitPop());
 }
 
-$pool->close();
+$pool->join();
@@ -31,10 +31,28 @@ extern zend_module_entry pht_module_entry;
 #  error "ZTS is required"
 #endif
 
+typedef struct _pht_task_cache_stats_t {
+    zend_long class_hits;
+    zend_long class_misses;
+    zend_long function_hits;
+    zend_long function_misses;
+} pht_task_cache_stats_t;
+
 ZEND_BEGIN_MODULE_GLOBALS(pht)
     void ***parent_thread_ls;
     HashTable op_array_file_names;
     HashTable child_threads;
+    HashTable child_pools;
+    HashTable closure_cache; // closures materialised in this thread, keyed by their source opcodes
+    HashTable class_task_cache; // resolved classes of class tasks, keyed by class name
+    HashTable function_task_cache; // resolved callables of function tasks, keyed by callable name
+    pht_task_cache_stats_t task_cache_stats;
+    zend_llist shared_op_arrays; // per-thread parts of op arrays sharing their parent's opcodes
+    struct _pht_snapshot_t *snapshot; // cached snapshot of this thread's context for its child threads
+    struct _pht_snapshot_t *import_snapshot; // the parent's snapshot to lazily import symbols from
+    zend_bool lazy_import;
+    zend_bool share_opcodes;
+    zend_bool pooled_allocator;
     zend_bool skip_qoi_creation;
     zend_bool skip_htoi_creation;
     zend_bool skip_voi_creation;
@@ -21,32 +21,82 @@
 #endif
 
 #include <main/php.h>
+#include <main/php_ini.h>
 #include <main/SAPI.h>
 #include <ext/standard/info.h>
 
 #include "php_pht.h"
+#include "src/pht_alloc.h"
+#include "src/pht_copy.h"
 #include "src/classes/thread.h"
+#include "src/classes/pool.h"
+#include "src/classes/future.h"
 #include "src/classes/threaded.h"
 #include "src/classes/runnable.h"
 #include "src/classes/queue.h"
 #include "src/classes/hashtable.h"
 #include "src/classes/vector.h"
 #include "src/classes/atomic_integer.h"
+#include "src/classes/immutable_array.h"
+#include "src/classes/numeric_vector.h"
+#include "src/classes/buffer.h"
+#include "src/classes/concurrent_queue.h"
 
 ZEND_DECLARE_MODULE_GLOBALS(pht)
 
 static int (*sapi_module_deactivate)(void);
 common_strings_t common_strings;
 
+PHP_INI_BEGIN()
+    STD_PHP_INI_BOOLEAN("pht.lazy_import", "0", PHP_INI_SYSTEM, OnUpdateBool, lazy_import, zend_pht_globals, pht_globals)
+    STD_PHP_INI_BOOLEAN("pht.share_opcodes", "0", PHP_INI_SYSTEM, OnUpdateBool, share_opcodes, zend_pht_globals, pht_globals)
+    STD_PHP_INI_BOOLEAN("pht.pooled_allocator", "1", PHP_INI_SYSTEM, OnUpdateBool, pooled_allocator, zend_pht_globals, pht_globals)
+PHP_INI_END()
+
+ZEND_BEGIN_ARG_INFO_EX(pht_allocator_stats_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_FUNCTION(allocator_stats)
+{
+    pht_alloc_stats_t stats;
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    pht_alloc_stats(&stats);
+
+    array_init(return_value);
+    add_assoc_bool(return_value, "pooled", pht_alloc_pooled());
+    add_assoc_long(return_value, "bytes_in_use", stats.bytes_in_use);
+    add_assoc_long(return_value, "bytes_pooled_free", stats.bytes_pooled_free);
+    add_assoc_long(return_value, "bytes_reserved", stats.bytes_reserved);
+}
+
+static const zend_function_entry pht_functions[] = {
+    ZEND_NS_FE("pht", allocator_stats, pht_allocator_stats_arginfo)
+    PHP_FE_END
+};
+
 PHP_MINIT_FUNCTION(pht)
 {
+    REGISTER_INI_ENTRIES();
+
+    pht_alloc_startup(PHT_ZG(pooled_allocator));
+
     threaded_ce_init();
     runnable_ce_init();
     thread_ce_init();
+    pool_ce_init();
+    future_ce_init();
     queue_ce_init();
     hashtable_ce_init();
     vector_ce_init();
     atomic_integer_ce_init();
+    immutable_array_ce_init();
+    numeric_vector_ce_init();
+    buffer_ce_init();
+    concurrent_queue_ce_init();
 
     common_strings.__construct = zend_string_init(ZEND_STRL("__construct"), 1);
     zend_string_hash_val(common_strings.__construct);
@@ -76,6 +126,8 @@ PHP_MINIT_FUNCTION(pht)
     sapi_module_deactivate = sapi_module.deactivate;
     sapi_module.deactivate = NULL;
 
+    pht_lazy_import_init();
+
     return SUCCESS;
 }
 
@@ -100,6 +152,12 @@ PHP_MSHUTDOWN_FUNCTION(pht)
 
     sapi_module.deactivate = sapi_module_deactivate;
 
+    pht_lazy_import_shutdown();
+
+    pht_alloc_shutdown();
+
+    UNREGISTER_INI_ENTRIES();
+
     return SUCCESS;
 }
 
@@ -109,6 +167,14 @@ PHP_RINIT_FUNCTION(pht)
 
     zend_hash_init(&PHT_ZG(op_array_file_names), 8, NULL, ZVAL_PTR_DTOR, 0);
     zend_hash_init(&PHT_ZG(child_threads), 8, NULL, thread_join_destroy, 0);
+    zend_hash_init(&PHT_ZG(child_pools), 8, NULL, pool_join_destroy, 0);
+    zend_hash_init(&PHT_ZG(closure_cache), 8, NULL, pht_closure_cache_entry_free, 0);
+    zend_hash_init(&PHT_ZG(class_task_cache), 8, NULL, task_cache_entry_free, 0);
+    zend_hash_init(&PHT_ZG(function_task_cache), 8, NULL, task_cache_entry_free, 0);
+    memset(&PHT_ZG(task_cache_stats), 0, sizeof(pht_task_cache_stats_t));
+    pht_shared_op_arrays_init();
+    PHT_ZG(snapshot) = NULL;
+    PHT_ZG(import_snapshot) = NULL;
     PHT_ZG(skip_qoi_creation) = 0;
     PHT_ZG(skip_htoi_creation) = 0;
     PHT_ZG(skip_voi_creation) = 0;
@@ -121,6 +187,30 @@ PHP_RSHUTDOWN_FUNCTION(pht)
 {
     zend_hash_destroy(&PHT_ZG(op_array_file_names));
     zend_hash_destroy(&PHT_ZG(child_threads));
+    zend_hash_destroy(&PHT_ZG(child_pools));
+    zend_hash_destroy(&PHT_ZG(closure_cache));
+    zend_hash_destroy(&PHT_ZG(class_task_cache));
+    zend_hash_destroy(&PHT_ZG(function_task_cache));
+
+    // released only once all child threads have been joined
+    if (PHT_ZG(snapshot)) {
+        pht_snapshot_release(PHT_ZG(snapshot));
+    }
+
+    if (PHT_ZG(import_snapshot)) {
+        pht_snapshot_release(PHT_ZG(import_snapshot));
+    }
+
+    return SUCCESS;
+}
+
+/*
+The thread's function and class tables are only destroyed after RSHUTDOWN, and
+so the per-thread parts of its shared op arrays are only freed here.
+*/
+ZEND_MODULE_POST_ZEND_DEACTIVATE_D(pht)
+{
+    pht_shared_op_arrays_free();
 
     return SUCCESS;
 }
@@ -130,12 +220,14 @@ PHP_MINFO_FUNCTION(pht)
     php_info_print_table_start();
     php_info_print_table_header(2, "pht support", "enabled");
     php_info_print_table_end();
+
+    DISPLAY_INI_ENTRIES();
 }
 
 zend_module_entry pht_module_entry = {
     STANDARD_MODULE_HEADER,
     "pht",
-    NULL,
+    pht_functions,
     PHP_MINIT(pht),
     PHP_MSHUTDOWN(pht),
     PHP_RINIT(pht),
@@ -145,7 +237,7 @@ zend_module_entry pht_module_entry = {
     PHP_MODULE_GLOBALS(pht),
     NULL,
     NULL,
-    NULL,
+    ZEND_MODULE_POST_ZEND_DEACTIVATE_N(pht),
     STANDARD_MODULE_PROPERTIES_EX
 };
 
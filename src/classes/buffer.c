@@ -0,0 +1,633 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifdef PHP_WIN32
+# include <windows.h>
+#else
+# include <sys/mman.h>
+#endif
+
+#include <Zend/zend_API.h>
+#include <Zend/zend_exceptions.h>
+#include <Zend/zend_interfaces.h>
+
+#include "php_pht.h"
+#include "src/pht_alloc.h"
+#include "src/pht_debug.h"
+#include "src/classes/buffer.h"
+
+extern zend_class_entry *Threaded_ce;
+
+zend_object_handlers buffer_handlers;
+zend_class_entry *Buffer_ce;
+
+#define BO_FROM_OBJ(zo) ((buffer_obj_t *)((char *)(zo) - (zo)->handlers->offset))
+#define BO_THIS() BO_FROM_OBJ(Z_OBJ(EX(This)))
+
+static char *buffer_map(size_t size)
+{
+#ifdef PHP_WIN32
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return data == MAP_FAILED ? NULL : data;
+#endif
+}
+
+static void buffer_unmap(char *data, size_t size)
+{
+#ifdef PHP_WIN32
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, size);
+#endif
+}
+
+static buffer_obj_internal_t *boi_create(size_t size, int flags)
+{
+    buffer_obj_internal_t *boi = calloc(1, sizeof(buffer_obj_internal_t));
+    pthread_mutexattr_t attr;
+
+    if (flags & PHT_BUFFER_MMAP) {
+        flags |= PHT_BUFFER_FIXED;
+        boi->data = buffer_map(size); // anonymous mappings are zero-filled
+    } else if (size) {
+        boi->data = calloc(1, size);
+    }
+
+    if (size && !boi->data) {
+        free(boi);
+        return NULL;
+    }
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&boi->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    boi->size = size;
+    boi->flags = flags;
+    boi->refcount = 1;
+
+    return boi;
+}
+
+void boi_addref(buffer_obj_internal_t *boi)
+{
+    pthread_mutex_lock(&boi->lock);
+    ++boi->refcount;
+    pthread_mutex_unlock(&boi->lock);
+}
+
+void boi_release(buffer_obj_internal_t *boi)
+{
+    pthread_mutex_lock(&boi->lock);
+    --boi->refcount;
+    pthread_mutex_unlock(&boi->lock);
+
+    if (boi->refcount) {
+        return;
+    }
+
+    if (boi->flags & PHT_BUFFER_MMAP) {
+        buffer_unmap(boi->data, boi->size);
+    } else {
+        free(boi->data);
+    }
+
+    pthread_mutex_destroy(&boi->lock);
+    free(boi);
+}
+
+/*
+Resizes the buffer, with any new bytes being zeroed. Returns 0 (with the buffer
+left untouched) on failure.
+*/
+static int boi_resize(buffer_obj_internal_t *boi, size_t size)
+{
+    char *data;
+
+    if (!size) {
+        free(boi->data);
+        boi->data = NULL;
+        boi->size = 0;
+        return 1;
+    }
+
+    if (!(data = realloc(boi->data, size))) {
+        return 0;
+    }
+
+    if (size > boi->size) {
+        memset(data + boi->size, 0, size - boi->size);
+    }
+
+    boi->data = data;
+    boi->size = size;
+
+    return 1;
+}
+
+buffer_slice_t *buffer_slice_copy(buffer_slice_t *slice)
+{
+    buffer_slice_t *copy;
+
+    if (!slice) {
+        return NULL;
+    }
+
+    copy = pht_alloc(sizeof(buffer_slice_t));
+    *copy = *slice;
+
+    return copy;
+}
+
+static zend_object *buffer_ctor(zend_class_entry *entry)
+{
+    buffer_obj_t *bo = ecalloc(1, sizeof(buffer_obj_t) + zend_object_properties_size(entry));
+
+    zend_object_std_init(&bo->obj, entry);
+    object_properties_init(&bo->obj, entry);
+
+    bo->obj.handlers = &buffer_handlers;
+    bo->boi = NULL; // created by the constructor, or attached by buffer_wrap()
+    bo->slice = NULL;
+
+    return &bo->obj;
+}
+
+void buffer_wrap(zval *value, buffer_obj_internal_t *boi, buffer_slice_t *slice)
+{
+    object_init_ex(value, Buffer_ce);
+
+    buffer_obj_t *bo = BO_FROM_OBJ(Z_OBJ_P(value));
+
+    boi_addref(boi);
+    bo->boi = boi;
+    bo->slice = buffer_slice_copy(slice);
+}
+
+void bo_dtor_obj(zend_object *obj)
+{
+    zend_object_std_dtor(obj);
+}
+
+void bo_free_obj(zend_object *obj)
+{
+    buffer_obj_t *bo = BO_FROM_OBJ(obj);
+
+    if (bo->boi) {
+        boi_release(bo->boi);
+    }
+
+    pht_free(bo->slice);
+}
+
+/*
+Fetches the region of the buffer visible to bo. Since the underlying buffer may
+have been shrunk by another object, slices must be checked against its size.
+*/
+static int bo_window(buffer_obj_t *bo, char **data, size_t *size)
+{
+    if (!bo->slice) {
+        *data = bo->boi->data;
+        *size = bo->boi->size;
+        return 1;
+    }
+
+    if (bo->slice->offset + bo->slice->length > bo->boi->size) {
+        zend_throw_error(NULL, "The slice is no longer within the bounds of its buffer");
+        return 0;
+    }
+
+    *data = bo->boi->data + bo->slice->offset;
+    *size = bo->slice->length;
+
+    return 1;
+}
+
+/*
+Writes the bytes at the offset, growing the buffer if necessary (only whole,
+growable buffers may be grown).
+*/
+static int bo_write(buffer_obj_t *bo, zend_long offset, const char *bytes, size_t len)
+{
+    char *data;
+    size_t size;
+
+    if (offset < 0) {
+        zend_throw_error(NULL, "Invalid offset - the offset must be a non-negative integer");
+        return 0;
+    }
+
+    if (!bo_window(bo, &data, &size)) {
+        return 0;
+    }
+
+    if ((size_t) offset + len > size) {
+        if (bo->slice || bo->boi->flags & PHT_BUFFER_FIXED) {
+            zend_throw_error(NULL, "Invalid range - the range must be within the buffer size");
+            return 0;
+        }
+
+        if (!boi_resize(bo->boi, (size_t) offset + len)) {
+            zend_throw_error(NULL, "Failed to grow the buffer");
+            return 0;
+        }
+
+        data = bo->boi->data;
+    }
+
+    memcpy(data + offset, bytes, len);
+
+    return 1;
+}
+
+/*
+Fetches the bytes from the offset onwards (up to length bytes, where length is
+negative for the remainder of the buffer).
+*/
+static int bo_read(buffer_obj_t *bo, zend_long offset, zend_long length, char **bytes, size_t *len)
+{
+    char *data;
+    size_t size;
+
+    if (!bo_window(bo, &data, &size)) {
+        return 0;
+    }
+
+    if (offset < 0 || (size_t) offset > size || (length >= 0 && (size_t) length > size - offset)) {
+        zend_throw_error(NULL, "Invalid range - the range must be within the buffer size");
+        return 0;
+    }
+
+    *bytes = data + offset;
+    *len = length < 0 ? size - offset : (size_t) length;
+
+    return 1;
+}
+
+HashTable *bo_get_debug_info(zval *zobj, int *is_temp)
+{
+    buffer_obj_t *bo = BO_FROM_OBJ(Z_OBJ_P(zobj));
+    zval zarr;
+
+    *is_temp = 1;
+
+    array_init(&zarr);
+
+    if (bo->boi) {
+        add_assoc_long(&zarr, "size", bo->slice ? bo->slice->length : bo->boi->size);
+        add_assoc_bool(&zarr, "fixed", bo->slice || bo->boi->flags & PHT_BUFFER_FIXED);
+        add_assoc_bool(&zarr, "mmap", bo->boi->flags & PHT_BUFFER_MMAP);
+    }
+
+    return Z_ARRVAL(zarr);
+}
+
+zval *bo_read_property(zval *object, zval *member, int type, void **cache, zval *rv)
+{
+    zend_throw_error(zend_ce_error, "Properties on Buffer objects are not enabled", 0);
+
+    return &EG(uninitialized_zval);
+}
+
+void bo_write_property(zval *object, zval *member, zval *value, void **cache_slot)
+{
+    zend_throw_error(zend_ce_error, "Properties on Buffer objects are not enabled", 0);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer___construct_arginfo, 0, 0, 0)
+    ZEND_ARG_INFO(0, size)
+    ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Buffer, __construct)
+{
+    buffer_obj_t *bo = BO_THIS();
+    zend_long size = 0, flags = 0;
+
+    ZEND_PARSE_PARAMETERS_START(0, 2)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(size)
+        Z_PARAM_LONG(flags)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (bo->boi) {
+        zend_throw_error(NULL, "Buffers cannot be constructed more than once");
+        return;
+    }
+
+    if (size < 0) {
+        zend_throw_error(NULL, "Invalid size given - size must be a non-negative integer");
+        return;
+    }
+
+    if (flags & ~(PHT_BUFFER_FIXED | PHT_BUFFER_MMAP)) {
+        zend_throw_error(NULL, "Invalid flags given - only Buffer::FIXED and Buffer::MMAP may be used");
+        return;
+    }
+
+    if (flags & PHT_BUFFER_MMAP && !size) {
+        zend_throw_error(NULL, "Memory-mapped buffers must have a non-zero size");
+        return;
+    }
+
+    if (!(bo->boi = boi_create(size, flags))) {
+        zend_throw_error(NULL, "Failed to create a buffer of the specified size");
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_size_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Buffer, size)
+{
+    buffer_obj_t *bo = BO_THIS();
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    RETVAL_LONG(bo->slice ? bo->slice->length : bo->boi->size);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_resize_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, size)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Buffer, resize)
+{
+    buffer_obj_t *bo = BO_THIS();
+    zend_long size;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(size)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (bo->slice || bo->boi->flags & PHT_BUFFER_FIXED) {
+        zend_throw_error(NULL, "Fixed-size buffers (and slices) cannot be resized");
+        return;
+    }
+
+    if (size < 0) {
+        zend_throw_error(NULL, "Invalid size given - size must be a non-negative integer");
+        return;
+    }
+
+    if (!boi_resize(bo->boi, size)) {
+        zend_throw_error(NULL, "Failed to resize the buffer to the specified size");
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_read_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, length)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Buffer, read)
+{
+    buffer_obj_t *bo = BO_THIS();
+    zend_long offset, length = -1;
+    char *bytes;
+    size_t len;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_LONG(offset)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(length)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!bo_read(bo, offset, length, &bytes, &len)) {
+        return;
+    }
+
+    RETVAL_STRINGL(bytes, len);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_write_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, data)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Buffer, write)
+{
+    buffer_obj_t *bo = BO_THIS();
+    zend_long offset;
+    zend_string *data;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_LONG(offset)
+        Z_PARAM_STR(data)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bo_write(bo, offset, ZSTR_VAL(data), ZSTR_LEN(data));
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_pack_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, format)
+    ZEND_ARG_VARIADIC_INFO(0, values)
+ZEND_END_ARG_INFO()
+
+/*
+Packs the values (as per pack()) directly into the buffer at the offset,
+returning the number of bytes written.
+*/
+PHP_METHOD(Buffer, pack)
+{
+    buffer_obj_t *bo = BO_THIS();
+    zend_long offset;
+    zval *args, fname, retval;
+    int argc;
+
+    ZEND_PARSE_PARAMETERS_START(2, -1)
+        Z_PARAM_LONG(offset)
+        Z_PARAM_VARIADIC('+', args, argc)
+    ZEND_PARSE_PARAMETERS_END();
+
+    ZVAL_STRINGL(&fname, "pack", sizeof("pack") - 1);
+
+    if (call_user_function(EG(function_table), NULL, &fname, &retval, argc, args) != SUCCESS || Z_TYPE(retval) != IS_STRING) {
+        zval_ptr_dtor(&fname);
+        zval_ptr_dtor(&retval);
+
+        if (!EG(exception)) {
+            zend_throw_error(NULL, "Failed to pack the values");
+        }
+        return;
+    }
+
+    if (bo_write(bo, offset, Z_STRVAL(retval), Z_STRLEN(retval))) {
+        RETVAL_LONG(Z_STRLEN(retval));
+    }
+
+    zval_ptr_dtor(&fname);
+    zval_ptr_dtor(&retval);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_unpack_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, format)
+    ZEND_ARG_INFO(0, length)
+ZEND_END_ARG_INFO()
+
+/*
+Unpacks values (as per unpack()) from the buffer at the offset. The bytes
+from the offset onwards are copied into a temporary string for unpack(), and
+so the length of data to be unpacked should be given for large buffers.
+*/
+PHP_METHOD(Buffer, unpack)
+{
+    buffer_obj_t *bo = BO_THIS();
+    zend_long offset, length = -1;
+    zend_string *format;
+    zval fname, args[2];
+    char *bytes;
+    size_t len;
+
+    ZEND_PARSE_PARAMETERS_START(2, 3)
+        Z_PARAM_LONG(offset)
+        Z_PARAM_STR(format)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(length)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!bo_read(bo, offset, length, &bytes, &len)) {
+        return;
+    }
+
+    ZVAL_STRINGL(&fname, "unpack", sizeof("unpack") - 1);
+    ZVAL_STR_COPY(&args[0], format);
+    ZVAL_STRINGL(&args[1], bytes, len);
+
+    if (call_user_function(EG(function_table), NULL, &fname, return_value, 2, args) != SUCCESS && !EG(exception)) {
+        zend_throw_error(NULL, "Failed to unpack the values");
+    }
+
+    zval_ptr_dtor(&fname);
+    zval_ptr_dtor(&args[0]);
+    zval_ptr_dtor(&args[1]);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_slice_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, length)
+ZEND_END_ARG_INFO()
+
+/*
+Returns a Buffer that views part of this buffer (without copying it). Slices
+have a fixed size, even if the underlying buffer is growable.
+*/
+PHP_METHOD(Buffer, slice)
+{
+    buffer_obj_t *bo = BO_THIS();
+    zend_long offset, length = -1;
+    buffer_slice_t slice;
+    char *bytes;
+    size_t len;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_LONG(offset)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(length)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!bo_read(bo, offset, length, &bytes, &len)) {
+        return;
+    }
+
+    slice.offset = bytes - bo->boi->data;
+    slice.length = len;
+
+    buffer_wrap(return_value, bo->boi, &slice);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_lock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Buffer, lock)
+{
+    buffer_obj_t *bo = BO_THIS();
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if (pthread_mutex_lock(&bo->boi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Buffer_unlock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Buffer, unlock)
+{
+    buffer_obj_t *bo = BO_THIS();
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if (pthread_mutex_unlock(&bo->boi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is either unheld, or is currently being held by another thread");
+    }
+}
+
+zend_function_entry Buffer_methods[] = {
+    PHP_ME(Buffer, __construct, Buffer___construct_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, size, Buffer_size_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, resize, Buffer_resize_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, read, Buffer_read_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, write, Buffer_write_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, pack, Buffer_pack_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, unpack, Buffer_unpack_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, slice, Buffer_slice_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, lock, Buffer_lock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Buffer, unlock, Buffer_unlock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+
+void buffer_ce_init(void)
+{
+    zend_class_entry ce;
+    zend_object_handlers *zh = zend_get_std_object_handlers();
+
+    INIT_CLASS_ENTRY(ce, "pht\\Buffer", Buffer_methods);
+    Buffer_ce = zend_register_internal_class(&ce);
+    Buffer_ce->create_object = buffer_ctor;
+    Buffer_ce->ce_flags |= ZEND_ACC_FINAL;
+    Buffer_ce->serialize = zend_class_serialize_deny;
+    Buffer_ce->unserialize = zend_class_unserialize_deny;
+
+    zend_declare_class_constant_long(Buffer_ce, ZEND_STRL("FIXED"), PHT_BUFFER_FIXED);
+    zend_declare_class_constant_long(Buffer_ce, ZEND_STRL("MMAP"), PHT_BUFFER_MMAP);
+
+    zend_class_implements(Buffer_ce, 1, Threaded_ce);
+    memcpy(&buffer_handlers, zh, sizeof(zend_object_handlers));
+
+    buffer_handlers.offset = XtOffsetOf(buffer_obj_t, obj);
+    buffer_handlers.dtor_obj = bo_dtor_obj;
+    buffer_handlers.free_obj = bo_free_obj;
+    buffer_handlers.clone_obj = NULL;
+    buffer_handlers.read_property = bo_read_property;
+    buffer_handlers.write_property = bo_write_property;
+    buffer_handlers.get_debug_info = bo_get_debug_info;
+}
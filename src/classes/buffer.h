@@ -0,0 +1,60 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_BUFFER_CLASS_H
+#define PHT_BUFFER_CLASS_H
+
+#include <main/php.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define PHT_BUFFER_FIXED 1 // the buffer cannot be resized
+#define PHT_BUFFER_MMAP 2 // the buffer is backed by an anonymous memory mapping (implies PHT_BUFFER_FIXED)
+
+typedef struct _buffer_obj_internal_t {
+    char *data;
+    size_t size;
+    int flags;
+    pthread_mutex_t lock;
+    uint32_t refcount;
+} buffer_obj_internal_t;
+
+/*
+A window onto part of a buffer. Buffer objects (and entries) without a slice
+cover the whole buffer, including any growth of it.
+*/
+typedef struct _buffer_slice_t {
+    size_t offset;
+    size_t length;
+} buffer_slice_t;
+
+typedef struct _buffer_obj_t {
+    buffer_obj_internal_t *boi;
+    buffer_slice_t *slice;
+    zend_object obj;
+} buffer_obj_t;
+
+extern zend_class_entry *Buffer_ce;
+
+void boi_addref(buffer_obj_internal_t *boi);
+void boi_release(buffer_obj_internal_t *boi);
+buffer_slice_t *buffer_slice_copy(buffer_slice_t *slice);
+void buffer_wrap(zval *value, buffer_obj_internal_t *boi, buffer_slice_t *slice);
+void buffer_ce_init(void);
+
+#endif
@@ -0,0 +1,307 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <Zend/zend_API.h>
+#include <Zend/zend_exceptions.h>
+#include <Zend/zend_interfaces.h>
+
+#include "php_pht.h"
+#include "src/pht_entry.h"
+#include "src/classes/concurrent_queue.h"
+
+extern zend_class_entry *Threaded_ce;
+
+zend_object_handlers concurrent_queue_handlers;
+zend_class_entry *ConcurrentQueue_ce;
+
+#define CQO_FROM_OBJ(zo) ((concurrent_queue_obj_t *)((char *)(zo) - (zo)->handlers->offset))
+#define CQO_THIS() CQO_FROM_OBJ(Z_OBJ(EX(This)))
+
+/*
+The reference count is atomic (rather than mutex-guarded, like the other ITC
+data structures), since nothing else about a concurrent queue takes a lock.
+*/
+void cqoi_addref(concurrent_queue_obj_internal_t *cqoi)
+{
+    pht_atomic_inc(&cqoi->refcount);
+}
+
+void cqoi_release(concurrent_queue_obj_internal_t *cqoi)
+{
+    if (!pht_atomic_dec(&cqoi->refcount)) {
+        pht_ring_buffer_destroy(&cqoi->ring);
+        free(cqoi);
+    }
+}
+
+static zend_object *concurrent_queue_ctor(zend_class_entry *entry)
+{
+    concurrent_queue_obj_t *cqo = ecalloc(1, sizeof(concurrent_queue_obj_t) + zend_object_properties_size(entry));
+
+    zend_object_std_init(&cqo->obj, entry);
+    object_properties_init(&cqo->obj, entry);
+
+    cqo->obj.handlers = &concurrent_queue_handlers;
+    cqo->cqoi = NULL; // created by the constructor, or attached by concurrent_queue_wrap()
+
+    return &cqo->obj;
+}
+
+void concurrent_queue_wrap(zval *value, concurrent_queue_obj_internal_t *cqoi)
+{
+    object_init_ex(value, ConcurrentQueue_ce);
+
+    concurrent_queue_obj_t *cqo = CQO_FROM_OBJ(Z_OBJ_P(value));
+
+    cqoi_addref(cqoi);
+    cqo->cqoi = cqoi;
+}
+
+void cqo_dtor_obj(zend_object *obj)
+{
+    zend_object_std_dtor(obj);
+}
+
+void cqo_free_obj(zend_object *obj)
+{
+    concurrent_queue_obj_t *cqo = CQO_FROM_OBJ(obj);
+
+    if (cqo->cqoi) {
+        cqoi_release(cqo->cqoi);
+    }
+}
+
+zval *cqo_read_property(zval *object, zval *member, int type, void **cache, zval *rv)
+{
+    zend_throw_error(zend_ce_error, "Properties on ConcurrentQueue objects are not enabled", 0);
+
+    return &EG(uninitialized_zval);
+}
+
+void cqo_write_property(zval *object, zval *member, zval *value, void **cache_slot)
+{
+    zend_throw_error(zend_ce_error, "Properties on ConcurrentQueue objects are not enabled", 0);
+}
+
+static concurrent_queue_obj_internal_t *cqo_fetch_internal(concurrent_queue_obj_t *cqo)
+{
+    if (!cqo->cqoi) {
+        zend_throw_error(NULL, "The ConcurrentQueue object has not been constructed");
+    }
+
+    return cqo->cqoi;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ConcurrentQueue___construct_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, capacity)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ConcurrentQueue, __construct)
+{
+    concurrent_queue_obj_t *cqo = CQO_THIS();
+    concurrent_queue_obj_internal_t *cqoi;
+    zend_long capacity;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(capacity)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (cqo->cqoi) {
+        zend_throw_error(NULL, "Concurrent queues cannot be constructed more than once");
+        return;
+    }
+
+    if (capacity < 1 || capacity > PHT_RING_BUFFER_MAX_CAPACITY) {
+        zend_throw_error(NULL, "Invalid capacity given - capacity must be between 1 and %d", PHT_RING_BUFFER_MAX_CAPACITY);
+        return;
+    }
+
+    cqoi = malloc(sizeof(concurrent_queue_obj_internal_t));
+
+    if (!cqoi || !pht_ring_buffer_init(&cqoi->ring, capacity, pht_entry_delete)) {
+        free(cqoi);
+        zend_throw_error(NULL, "Failed to create a queue of the specified capacity");
+        return;
+    }
+
+    pht_atomic_init(&cqoi->refcount, 1);
+
+    cqo->cqoi = cqoi;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ConcurrentQueue_tryPush_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+/*
+Returns false (without converting the value) if the queue is already full.
+Otherwise, the queue could still fill up whilst the value is being converted,
+in which case the converted value is discarded.
+*/
+PHP_METHOD(ConcurrentQueue, tryPush)
+{
+    concurrent_queue_obj_internal_t *cqoi;
+    pht_entry_t *entry;
+    zval *value;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL(value)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!(cqoi = cqo_fetch_internal(CQO_THIS()))) {
+        return;
+    }
+
+    if (pht_ring_buffer_size(&cqoi->ring) == pht_ring_buffer_capacity(&cqoi->ring)) {
+        RETURN_FALSE;
+    }
+
+    entry = pht_create_entry_from_zval(value);
+
+    if (!entry) {
+        zend_throw_error(NULL, "Failed to serialise the value");
+        return;
+    }
+
+    if (!pht_ring_buffer_push(&cqoi->ring, entry)) {
+        pht_entry_delete(entry);
+        RETURN_FALSE;
+    }
+
+    RETURN_TRUE;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ConcurrentQueue_tryPop_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(1, value)
+ZEND_END_ARG_INFO()
+
+/*
+Returns false (leaving the given variable untouched) if the queue is empty.
+The popped value is written to the variable instead of being returned, since
+null is a valid value to have pushed.
+*/
+PHP_METHOD(ConcurrentQueue, tryPop)
+{
+    concurrent_queue_obj_internal_t *cqoi;
+    pht_entry_t *entry;
+    zval *value;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL_DEREF(value)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!(cqoi = cqo_fetch_internal(CQO_THIS()))) {
+        return;
+    }
+
+    entry = pht_ring_buffer_pop(&cqoi->ring);
+
+    if (!entry) {
+        RETURN_FALSE;
+    }
+
+    zval_ptr_dtor(value);
+    pht_convert_entry_to_zval(value, entry);
+    pht_entry_delete(entry);
+
+    RETURN_TRUE;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ConcurrentQueue_capacity_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ConcurrentQueue, capacity)
+{
+    concurrent_queue_obj_internal_t *cqoi;
+
+    if (zend_parse_parameters_none() != SUCCESS || !(cqoi = cqo_fetch_internal(CQO_THIS()))) {
+        return;
+    }
+
+    RETVAL_LONG(pht_ring_buffer_capacity(&cqoi->ring));
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ConcurrentQueue_size_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+// the size is only approximate whilst other threads are using the queue
+PHP_METHOD(ConcurrentQueue, size)
+{
+    concurrent_queue_obj_internal_t *cqoi;
+
+    if (zend_parse_parameters_none() != SUCCESS || !(cqoi = cqo_fetch_internal(CQO_THIS()))) {
+        return;
+    }
+
+    RETVAL_LONG(pht_ring_buffer_size(&cqoi->ring));
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ConcurrentQueue_lock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+// concurrent queues never need locking, and so these are no-ops
+PHP_METHOD(ConcurrentQueue, lock)
+{
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ConcurrentQueue_unlock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ConcurrentQueue, unlock)
+{
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+}
+
+zend_function_entry ConcurrentQueue_methods[] = {
+    PHP_ME(ConcurrentQueue, __construct, ConcurrentQueue___construct_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ConcurrentQueue, tryPush, ConcurrentQueue_tryPush_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ConcurrentQueue, tryPop, ConcurrentQueue_tryPop_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ConcurrentQueue, capacity, ConcurrentQueue_capacity_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ConcurrentQueue, size, ConcurrentQueue_size_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ConcurrentQueue, lock, ConcurrentQueue_lock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ConcurrentQueue, unlock, ConcurrentQueue_unlock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+
+void concurrent_queue_ce_init(void)
+{
+    zend_class_entry ce;
+    zend_object_handlers *zh = zend_get_std_object_handlers();
+
+    INIT_CLASS_ENTRY(ce, "pht\\ConcurrentQueue", ConcurrentQueue_methods);
+    ConcurrentQueue_ce = zend_register_internal_class(&ce);
+    ConcurrentQueue_ce->create_object = concurrent_queue_ctor;
+    ConcurrentQueue_ce->ce_flags |= ZEND_ACC_FINAL;
+    ConcurrentQueue_ce->serialize = zend_class_serialize_deny;
+    ConcurrentQueue_ce->unserialize = zend_class_unserialize_deny;
+
+    zend_class_implements(ConcurrentQueue_ce, 1, Threaded_ce);
+    memcpy(&concurrent_queue_handlers, zh, sizeof(zend_object_handlers));
+
+    concurrent_queue_handlers.offset = XtOffsetOf(concurrent_queue_obj_t, obj);
+    concurrent_queue_handlers.dtor_obj = cqo_dtor_obj;
+    concurrent_queue_handlers.free_obj = cqo_free_obj;
+    concurrent_queue_handlers.clone_obj = NULL;
+    concurrent_queue_handlers.read_property = cqo_read_property;
+    concurrent_queue_handlers.write_property = cqo_write_property;
+}
@@ -0,0 +1,44 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_CONCURRENT_QUEUE_CLASS_H
+#define PHT_CONCURRENT_QUEUE_CLASS_H
+
+#include <main/php.h>
+
+#include "src/pht_atomic.h"
+#include "src/ds/pht_ring_buffer.h"
+
+typedef struct _concurrent_queue_obj_internal_t {
+    pht_ring_buffer_t ring;
+    pht_atomic_t refcount;
+} concurrent_queue_obj_internal_t;
+
+typedef struct _concurrent_queue_obj_t {
+    concurrent_queue_obj_internal_t *cqoi;
+    zend_object obj;
+} concurrent_queue_obj_t;
+
+extern zend_class_entry *ConcurrentQueue_ce;
+
+void cqoi_addref(concurrent_queue_obj_internal_t *cqoi);
+void cqoi_release(concurrent_queue_obj_internal_t *cqoi);
+void concurrent_queue_wrap(zval *value, concurrent_queue_obj_internal_t *cqoi);
+void concurrent_queue_ce_init(void);
+
+#endif
@@ -0,0 +1,307 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <errno.h>
+#include <main/php.h>
+#include <Zend/zend_API.h>
+#include <Zend/zend_exceptions.h>
+#include <Zend/zend_interfaces.h>
+
+#include "php_pht.h"
+#include "src/pht_debug.h"
+#include "src/pht_time.h"
+#include "src/classes/future.h"
+
+zend_object_handlers future_handlers;
+zend_class_entry *Future_ce;
+
+future_obj_internal_t *foi_create(void)
+{
+    future_obj_internal_t *foi = calloc(1, sizeof(future_obj_internal_t));
+
+    foi->state = FUTURE_PENDING;
+    foi->refcount = 1;
+
+    pthread_mutex_init(&foi->lock, NULL);
+    pthread_cond_init(&foi->cond, NULL);
+
+    return foi;
+}
+
+static void foi_free(future_obj_internal_t *foi)
+{
+    switch (foi->state) {
+        case FUTURE_RESOLVED:
+            pht_entry_delete_value(&foi->value);
+            break;
+        case FUTURE_REJECTED:
+            pht_str_free(&foi->exception_class);
+            pht_str_free(&foi->exception_message);
+            break;
+        case FUTURE_PENDING:
+            break;
+    }
+
+    pthread_cond_destroy(&foi->cond);
+    pthread_mutex_destroy(&foi->lock);
+    free(foi);
+}
+
+void foi_release(future_obj_internal_t *foi)
+{
+    int refcount;
+
+    pthread_mutex_lock(&foi->lock);
+    refcount = --foi->refcount;
+    pthread_mutex_unlock(&foi->lock);
+
+    if (!refcount) {
+        foi_free(foi);
+    }
+}
+
+void foi_resolve(future_obj_internal_t *foi, zval *value)
+{
+    pht_entry_t entry;
+    zval null;
+
+    if (Z_TYPE_P(value) == IS_UNDEF) {
+        ZVAL_NULL(&null);
+        value = &null;
+    }
+
+    ZVAL_DEREF(value);
+
+    // the conversion is done outside of the lock, so that waiting threads are
+    // only ever woken up to a fully constructed value
+    if (!pht_convert_zval_to_entry(&entry, value)) {
+        if (EG(exception)) {
+            zend_clear_exception();
+        }
+
+        foi_reject_with_message(foi, "Failed to serialise the return value of the task");
+        return;
+    }
+
+    pthread_mutex_lock(&foi->lock);
+
+    if (foi->state != FUTURE_PENDING) {
+        pthread_mutex_unlock(&foi->lock);
+        pht_entry_delete_value(&entry);
+        return;
+    }
+
+    foi->value = entry;
+    foi->state = FUTURE_RESOLVED;
+
+    pthread_cond_broadcast(&foi->cond);
+    pthread_mutex_unlock(&foi->lock);
+}
+
+static void foi_reject_with(future_obj_internal_t *foi, zend_string *ce_name, zend_string *message, zend_long code)
+{
+    pthread_mutex_lock(&foi->lock);
+
+    if (foi->state == FUTURE_PENDING) {
+        pht_str_update(&foi->exception_class, ZSTR_VAL(ce_name), ZSTR_LEN(ce_name));
+        pht_str_update(&foi->exception_message, ZSTR_VAL(message), ZSTR_LEN(message));
+        foi->exception_code = code;
+        foi->state = FUTURE_REJECTED;
+
+        pthread_cond_broadcast(&foi->cond);
+    }
+
+    pthread_mutex_unlock(&foi->lock);
+}
+
+void foi_reject(future_obj_internal_t *foi, zend_object *exception)
+{
+    zend_class_entry *base_ce;
+    zend_string *message;
+    zend_long code;
+    zval zexception, rv, *zmessage, *zcode;
+
+    ZVAL_OBJ(&zexception, exception);
+    base_ce = zend_get_exception_base(&zexception);
+
+    zmessage = zend_read_property(base_ce, &zexception, ZEND_STRL("message"), 1, &rv);
+    message = zval_get_string(zmessage);
+    zcode = zend_read_property(base_ce, &zexception, ZEND_STRL("code"), 1, &rv);
+    code = zval_get_long(zcode);
+
+    foi_reject_with(foi, exception->ce->name, message, code);
+
+    zend_string_release(message);
+}
+
+void foi_reject_with_message(future_obj_internal_t *foi, const char *message)
+{
+    zend_string *zmessage = zend_string_init(message, strlen(message), 0);
+
+    foi_reject_with(foi, zend_ce_error->name, zmessage, 0);
+
+    zend_string_release(zmessage);
+}
+
+static zend_object *future_ctor(zend_class_entry *entry)
+{
+    future_obj_t *fo = ecalloc(1, sizeof(future_obj_t) + zend_object_properties_size(entry));
+
+    zend_object_std_init(&fo->obj, entry);
+    object_properties_init(&fo->obj, entry);
+
+    fo->obj.handlers = &future_handlers;
+
+    return &fo->obj;
+}
+
+void future_object_create(zval *zfuture, future_obj_internal_t *foi)
+{
+    object_init_ex(zfuture, Future_ce);
+
+    future_obj_t *fo = (future_obj_t *)((char *)Z_OBJ_P(zfuture) - Z_OBJ_P(zfuture)->handlers->offset);
+
+    pthread_mutex_lock(&foi->lock);
+    ++foi->refcount;
+    pthread_mutex_unlock(&foi->lock);
+
+    fo->foi = foi;
+}
+
+void fo_free_obj(zend_object *obj)
+{
+    future_obj_t *fo = (future_obj_t *)((char *)obj - obj->handlers->offset);
+
+    if (fo->foi) {
+        foi_release(fo->foi);
+    }
+
+    zend_object_std_dtor(obj);
+}
+
+static zend_function *fo_get_constructor(zend_object *obj)
+{
+    zend_throw_error(NULL, "Future objects can only be obtained from a task submission");
+
+    return NULL;
+}
+
+static void future_rethrow(future_obj_internal_t *foi)
+{
+    zend_string *ce_name = zend_string_init(PHT_STRV(foi->exception_class), PHT_STRL(foi->exception_class), 0);
+    zend_class_entry *ce = zend_lookup_class(ce_name);
+
+    // the exception's class may only have been declared inside of the thread
+    if (ce && instanceof_function(ce, zend_ce_throwable)) {
+        zend_throw_exception(ce, PHT_STRV(foi->exception_message), foi->exception_code);
+    } else {
+        zend_throw_exception_ex(zend_ce_exception, foi->exception_code, "%s: %s", PHT_STRV(foi->exception_class), PHT_STRV(foi->exception_message));
+    }
+
+    zend_string_release(ce_name);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Future_get_arginfo, 0, 0, 0)
+    ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Future, get)
+{
+    future_obj_t *fo = (future_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    future_obj_internal_t *foi = fo->foi;
+    double timeout = -1;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_DOUBLE(timeout)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pthread_mutex_lock(&foi->lock);
+
+    if (timeout < 0) {
+        while (foi->state == FUTURE_PENDING) {
+            pthread_cond_wait(&foi->cond, &foi->lock);
+        }
+    } else {
+        struct timespec deadline;
+
+        pht_timespec_from_timeout(&deadline, timeout);
+
+        while (foi->state == FUTURE_PENDING) {
+            if (pthread_cond_timedwait(&foi->cond, &foi->lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    // once settled, a future's state and value never change again
+    pthread_mutex_unlock(&foi->lock);
+
+    switch (foi->state) {
+        case FUTURE_PENDING:
+            zend_throw_error(NULL, "Timed out whilst waiting for the future to complete");
+            break;
+        case FUTURE_RESOLVED:
+            pht_convert_entry_to_zval(return_value, &foi->value);
+            break;
+        case FUTURE_REJECTED:
+            future_rethrow(foi);
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Future_is_done_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Future, isDone)
+{
+    future_obj_t *fo = (future_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    pthread_mutex_lock(&fo->foi->lock);
+    RETVAL_BOOL(fo->foi->state != FUTURE_PENDING);
+    pthread_mutex_unlock(&fo->foi->lock);
+}
+
+zend_function_entry Future_methods[] = {
+    PHP_ME(Future, get, Future_get_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Future, isDone, Future_is_done_arginfo, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+
+void future_ce_init(void)
+{
+    zend_class_entry ce;
+    zend_object_handlers *zh = zend_get_std_object_handlers();
+
+    INIT_CLASS_ENTRY(ce, "pht\\Future", Future_methods);
+    Future_ce = zend_register_internal_class(&ce);
+    Future_ce->create_object = future_ctor;
+    Future_ce->ce_flags |= ZEND_ACC_FINAL;
+    Future_ce->serialize = zend_class_serialize_deny;
+    Future_ce->unserialize = zend_class_unserialize_deny;
+
+    memcpy(&future_handlers, zh, sizeof(zend_object_handlers));
+
+    future_handlers.offset = XtOffsetOf(future_obj_t, obj);
+    future_handlers.free_obj = fo_free_obj;
+    future_handlers.get_constructor = fo_get_constructor;
+    future_handlers.clone_obj = NULL;
+}
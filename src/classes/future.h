@@ -0,0 +1,61 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_FUTURE_CLASS_H
+#define PHT_FUTURE_CLASS_H
+
+#include <main/php.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "src/pht_entry.h"
+#include "src/pht_string.h"
+
+typedef enum _future_state_t {
+    FUTURE_PENDING,
+    FUTURE_RESOLVED,
+    FUTURE_REJECTED
+} future_state_t;
+
+typedef struct _future_obj_internal_t {
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // broadcast once the future has been settled
+    future_state_t state;
+    pht_entry_t value; // set when resolved
+    pht_string_t exception_class; // set when rejected
+    pht_string_t exception_message;
+    zend_long exception_code;
+    uint32_t refcount;
+} future_obj_internal_t;
+
+typedef struct _future_obj_t {
+    future_obj_internal_t *foi;
+    zend_object obj;
+} future_obj_t;
+
+future_obj_internal_t *foi_create(void);
+void foi_release(future_obj_internal_t *foi);
+void foi_resolve(future_obj_internal_t *foi, zval *value);
+void foi_reject(future_obj_internal_t *foi, zend_object *exception);
+void foi_reject_with_message(future_obj_internal_t *foi, const char *message);
+void future_object_create(zval *zfuture, future_obj_internal_t *foi);
+void future_ce_init(void);
+
+extern zend_class_entry *Future_ce;
+
+#endif
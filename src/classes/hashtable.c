@@ -32,6 +32,12 @@ zend_class_entry *HashTable_ce;
 
 void htoi_free(hashtable_obj_internal_t *htoi)
 {
+    for (int i = 0; i < htoi->shard_count; ++i) {
+        pthread_mutex_destroy(&htoi->shards[i].lock);
+        pht_hashtable_destroy(&htoi->shards[i].hashtable);
+    }
+
+    free(htoi->shards);
     pthread_mutex_destroy(&htoi->lock);
     pht_hashtable_destroy(&htoi->hashtable);
     free(htoi);
@@ -84,6 +90,80 @@ void hto_free_obj(zend_object *obj)
     }
 }
 
+/*
+Fetches the table holding the given (string or integer) key. For sharded hash
+tables, the key's shard is locked, unless the calling thread already holds its
+lock (through HashTable::lock()). The shard to unlock afterwards (if any) is
+set in locked.
+*/
+static pht_hashtable_t *htoi_table_for(hashtable_obj_internal_t *htoi, zval *offset, hashtable_shard_t **locked)
+{
+    hashtable_shard_t *shard;
+    zend_ulong hash;
+
+    *locked = NULL;
+
+    if (!htoi->shards) {
+        return &htoi->hashtable;
+    }
+
+    hash = Z_TYPE_P(offset) == IS_STRING ? ZSTR_HASH(Z_STR_P(offset)) : (zend_ulong) Z_LVAL_P(offset);
+
+    /*
+    The tables index buckets by the low bits of the hash, and so the shard is
+    chosen by the high bits of a multiplicative hash instead. Otherwise, all of
+    the keys within a shard could share the same low bits.
+    */
+    shard = htoi->shards + ((uint32_t) hash * 0x9E3779B9U >> 16) % htoi->shard_count;
+
+    if (!pthread_mutex_lock(&shard->lock)) {
+        *locked = shard;
+    }
+
+    return &shard->hashtable;
+}
+
+static void htoi_table_release(hashtable_shard_t *locked)
+{
+    if (locked) {
+        pthread_mutex_unlock(&locked->lock);
+    }
+}
+
+// sharded hash tables are modified under different locks, and so do not track a version number
+static void htoi_modified(hashtable_obj_internal_t *htoi)
+{
+    if (!htoi->shards) {
+        ++htoi->vn;
+    }
+}
+
+static pht_entry_t *hashtable_search(pht_hashtable_t *ht, zval *offset)
+{
+    pht_entry_t *entry;
+    pht_string_t key;
+
+    if (Z_TYPE_P(offset) == IS_LONG) {
+        return pht_hashtable_search_ind(ht, Z_LVAL_P(offset));
+    }
+
+    pht_str_update(&key, Z_STRVAL_P(offset), Z_STRLEN_P(offset));
+    entry = pht_hashtable_search(ht, &key);
+    pht_str_free(&key);
+
+    return entry;
+}
+
+static int hto_check_offset(zval *offset)
+{
+    if (Z_TYPE_P(offset) != IS_STRING && Z_TYPE_P(offset) != IS_LONG) {
+        zend_throw_error(NULL, "Invalid offset type"); // @todo cater for Object::__toString()?
+        return 0;
+    }
+
+    return 1;
+}
+
 zval *hto_read_dimension(zval *zobj, zval *offset, int type, zval *rv)
 {
     if (offset == NULL) {
@@ -92,27 +172,20 @@ zval *hto_read_dimension(zval *zobj, zval *offset, int type, zval *rv)
     }
 
     hashtable_obj_t *hto = (hashtable_obj_t *)((char *)Z_OBJ_P(zobj) - Z_OBJ_P(zobj)->handlers->offset);
-    pht_entry_t *e = NULL;
-
-    switch (Z_TYPE_P(offset)) {
-        case IS_STRING:
-            {
-                pht_string_t key;
+    hashtable_shard_t *locked;
+    pht_hashtable_t *ht;
+    pht_entry_t *e;
 
-                pht_str_update(&key, Z_STRVAL_P(offset), Z_STRLEN_P(offset));
-                e = pht_hashtable_search(&hto->htoi->hashtable, &key);
-                pht_str_free(&key);
-            }
-            break;
-        case IS_LONG:
-            e = pht_hashtable_search_ind(&hto->htoi->hashtable, Z_LVAL_P(offset));
-            break;
-        default:
-            zend_throw_error(NULL, "Invalid offset type"); // @todo cater for Object::__toString()?
-            return NULL;
+    if (!hto_check_offset(offset)) {
+        return NULL;
     }
 
+    ht = htoi_table_for(hto->htoi, offset, &locked);
+    e = hashtable_search(ht, offset);
+
     if (!e) {
+        htoi_table_release(locked);
+
         if (type != BP_VAR_IS) {
             zend_throw_error(NULL, "Undefined offset");
         }
@@ -120,6 +193,7 @@ zval *hto_read_dimension(zval *zobj, zval *offset, int type, zval *rv)
     }
 
     pht_convert_entry_to_zval(rv, e);
+    htoi_table_release(locked);
 
     return rv;
 }
@@ -127,12 +201,19 @@ zval *hto_read_dimension(zval *zobj, zval *offset, int type, zval *rv)
 void hto_write_dimension(zval *zobj, zval *offset, zval *value)
 {
     hashtable_obj_t *hto = (hashtable_obj_t *)((char *)Z_OBJ_P(zobj) - Z_OBJ_P(zobj)->handlers->offset);
+    hashtable_shard_t *locked;
+    pht_hashtable_t *ht;
 
     if (!offset) {
         zend_throw_error(NULL, "Empty offset insertions are not allowed");
         return;
     }
 
+    if (!hto_check_offset(offset)) {
+        return;
+    }
+
+    // the value is converted before any shard is locked
     pht_entry_t *entry = pht_create_entry_from_zval(value);
 
     if (!entry) {
@@ -140,75 +221,55 @@ void hto_write_dimension(zval *zobj, zval *offset, zval *value)
         return;
     }
 
-    switch (Z_TYPE_P(offset)) {
-        case IS_STRING:
-            {
-                pht_string_t *key = pht_str_new(Z_STRVAL_P(offset), Z_STRLEN_P(offset));
+    ht = htoi_table_for(hto->htoi, offset, &locked);
 
-                if (pht_hashtable_search(&hto->htoi->hashtable, key)) {
-                    pht_hashtable_update(&hto->htoi->hashtable, key, entry);
-                } else {
-                    pht_hashtable_insert(&hto->htoi->hashtable, key, entry);
-                }
+    if (Z_TYPE_P(offset) == IS_STRING) {
+        pht_string_t *key = pht_str_new(Z_STRVAL_P(offset), Z_STRLEN_P(offset));
 
-                ++hto->htoi->vn;
-            }
-            break;
-        case IS_LONG:
-            {
-                if (pht_hashtable_search_ind(&hto->htoi->hashtable, Z_LVAL_P(offset))) {
-                    pht_hashtable_update_ind(&hto->htoi->hashtable, Z_LVAL_P(offset), entry);
-                } else {
-                    pht_hashtable_insert_ind(&hto->htoi->hashtable, Z_LVAL_P(offset), entry);
-                }
-
-                ++hto->htoi->vn;
-            }
-            break;
-        default:
-            zend_throw_error(NULL, "Invalid offset type"); // @todo cater for Object::__toString()?
-            return;
+        if (pht_hashtable_search(ht, key)) {
+            pht_hashtable_update(ht, key, entry);
+        } else {
+            pht_hashtable_insert(ht, key, entry);
+        }
+    } else {
+        if (pht_hashtable_search_ind(ht, Z_LVAL_P(offset))) {
+            pht_hashtable_update_ind(ht, Z_LVAL_P(offset), entry);
+        } else {
+            pht_hashtable_insert_ind(ht, Z_LVAL_P(offset), entry);
+        }
     }
+
+    htoi_modified(hto->htoi);
+    htoi_table_release(locked);
 }
 
 int hto_has_dimension(zval *zobj, zval *offset, int check_empty)
 {
     zend_object *obj = Z_OBJ_P(zobj);
     hashtable_obj_t *hto = (hashtable_obj_t *)((char *)obj - obj->handlers->offset);
-    pht_entry_t *entry = NULL;
-
-    switch (Z_TYPE_P(offset)) {
-        case IS_STRING:
-            {
-                pht_string_t key;
+    hashtable_shard_t *locked;
+    pht_entry_t *entry;
+    int result;
 
-                pht_str_update(&key, Z_STRVAL_P(offset), Z_STRLEN_P(offset));
-                entry = pht_hashtable_search(&hto->htoi->hashtable, &key);
-                pht_str_free(&key);
-            }
-            break;
-        case IS_LONG:
-            entry = pht_hashtable_search_ind(&hto->htoi->hashtable, Z_LVAL_P(offset));
-            break;
-        default:
-            zend_throw_error(NULL, "Invalid offset type"); // @todo cater for Object::__toString()?
-            return 0;
+    if (!hto_check_offset(offset)) {
+        return 0;
     }
 
+    entry = hashtable_search(htoi_table_for(hto->htoi, offset, &locked), offset);
+
     if (!entry) {
-        return 0;
-    }
+        result = 0;
+    } else if (!check_empty) {
+        result = PHT_ENTRY_TYPE(entry) != IS_NULL;
+    } else {
+        zval value;
 
-    if (!check_empty) {
-        return PHT_ENTRY_TYPE(entry) != IS_NULL;
+        pht_convert_entry_to_zval(&value, entry);
+        result = i_zend_is_true(&value);
+        zval_ptr_dtor(&value);
     }
 
-    zval value;
-    int result;
-
-    pht_convert_entry_to_zval(&value, entry);
-    result = i_zend_is_true(&value);
-    zval_ptr_dtor(&value);
+    htoi_table_release(locked);
 
     return result;
 }
@@ -217,24 +278,44 @@ void hto_unset_dimension(zval *zobj, zval *offset)
 {
     zend_object *obj = Z_OBJ_P(zobj);
     hashtable_obj_t *hto = (hashtable_obj_t *)((char *)obj - obj->handlers->offset);
+    hashtable_shard_t *locked;
+    pht_hashtable_t *ht;
 
-    switch (Z_TYPE_P(offset)) {
-        case IS_STRING:
-            {
-                pht_string_t key;
+    if (!hto_check_offset(offset)) {
+        return;
+    }
 
-                pht_str_update(&key, Z_STRVAL_P(offset), Z_STRLEN_P(offset));
-                pht_hashtable_delete(&hto->htoi->hashtable, &key);
-                pht_str_free(&key);
-                ++hto->htoi->vn;
-            }
-            break;
-        case IS_LONG:
-            pht_hashtable_delete_ind(&hto->htoi->hashtable, Z_LVAL_P(offset));
-            ++hto->htoi->vn;
-            break;
-        default:
-            zend_throw_error(NULL, "Invalid offset type"); // @todo cater for Object::__toString()?
+    ht = htoi_table_for(hto->htoi, offset, &locked);
+
+    if (Z_TYPE_P(offset) == IS_STRING) {
+        pht_string_t key;
+
+        pht_str_update(&key, Z_STRVAL_P(offset), Z_STRLEN_P(offset));
+        pht_hashtable_delete(ht, &key);
+        pht_str_free(&key);
+    } else {
+        pht_hashtable_delete_ind(ht, Z_LVAL_P(offset));
+    }
+
+    htoi_modified(hto->htoi);
+    htoi_table_release(locked);
+}
+
+/*
+Copies the values of a sharded hash table into zht, locking one shard at a time
+(and so the result is not a snapshot of the whole table).
+*/
+static void htoi_shards_to_zend_hashtable(HashTable *zht, hashtable_obj_internal_t *htoi)
+{
+    for (int i = 0; i < htoi->shard_count; ++i) {
+        hashtable_shard_t *shard = htoi->shards + i;
+        int acquired = !pthread_mutex_lock(&shard->lock);
+
+        pht_hashtable_to_zend_hashtable(zht, &shard->hashtable);
+
+        if (acquired) {
+            pthread_mutex_unlock(&shard->lock);
+        }
     }
 }
 
@@ -243,7 +324,7 @@ HashTable *hto_get_properties(zval *zobj)
     zend_object *obj = Z_OBJ_P(zobj);
     hashtable_obj_t *hto = (hashtable_obj_t *)((char *)obj - obj->handlers->offset);
 
-    if (obj->properties && hto->vn == hto->htoi->vn) {
+    if (obj->properties && !hto->htoi->shards && hto->vn == hto->htoi->vn) {
         return obj->properties;
     }
 
@@ -254,7 +335,11 @@ HashTable *hto_get_properties(zval *zobj)
         zend_hash_init(obj->properties, 8, NULL, ZVAL_PTR_DTOR, 0);
     }
 
-    pht_hashtable_to_zend_hashtable(obj->properties, &hto->htoi->hashtable);
+    if (hto->htoi->shards) {
+        htoi_shards_to_zend_hashtable(obj->properties, hto->htoi);
+    } else {
+        pht_hashtable_to_zend_hashtable(obj->properties, &hto->htoi->hashtable);
+    }
 
     hto->vn = hto->htoi->vn;
 
@@ -268,11 +353,81 @@ HashTable *hto_get_debug_info(zval *zobj, int *is_temp)
 
     zend_hash_init(zht, 8, NULL, ZVAL_PTR_DTOR, 0);
     *is_temp = 1;
-    pht_hashtable_to_zend_hashtable(zht, &hto->htoi->hashtable);
+
+    if (hto->htoi->shards) {
+        htoi_shards_to_zend_hashtable(zht, hto->htoi);
+    } else {
+        pht_hashtable_to_zend_hashtable(zht, &hto->htoi->hashtable);
+    }
 
     return zht;
 }
 
+ZEND_BEGIN_ARG_INFO_EX(HashTable___construct_arginfo, 0, 0, 0)
+    ZEND_ARG_INFO(0, shards)
+ZEND_END_ARG_INFO()
+
+/*
+A shard count of 0 (the default) creates a single table, which must be locked
+by the user around every operation.
+*/
+PHP_METHOD(HashTable, __construct)
+{
+    hashtable_obj_t *hto = (hashtable_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    hashtable_obj_internal_t *htoi = hto->htoi;
+    zend_long shard_count = 0;
+    pthread_mutexattr_t attr;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(shard_count)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (shard_count < 0 || shard_count > PHT_HASHTABLE_MAX_SHARDS) {
+        zend_throw_error(NULL, "Invalid shard count given - it must be between 0 and %d", PHT_HASHTABLE_MAX_SHARDS);
+        return;
+    }
+
+    // the table may already be in use by other threads, and so is checked under its lock
+    if (pthread_mutex_lock(&htoi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+        return;
+    }
+
+    if (htoi->constructed) {
+        pthread_mutex_unlock(&htoi->lock);
+        zend_throw_error(NULL, "The hash table has already been constructed");
+        return;
+    }
+
+    if (!shard_count) {
+        htoi->constructed = 1;
+        pthread_mutex_unlock(&htoi->lock);
+        return;
+    }
+
+    if (!(htoi->shards = calloc(shard_count, sizeof(hashtable_shard_t)))) {
+        pthread_mutex_unlock(&htoi->lock);
+        zend_throw_error(NULL, "Failed to create a hash table with the specified number of shards");
+        return;
+    }
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+
+    for (int i = 0; i < shard_count; ++i) {
+        pthread_mutex_init(&htoi->shards[i].lock, &attr);
+        pht_hashtable_init(&htoi->shards[i].hashtable, 2, pht_entry_delete);
+    }
+
+    pthread_mutexattr_destroy(&attr);
+
+    htoi->shard_count = shard_count;
+    htoi->constructed = 1;
+
+    pthread_mutex_unlock(&htoi->lock);
+}
+
 ZEND_BEGIN_ARG_INFO_EX(HashTable_lock_arginfo, 0, 0, 0)
 ZEND_END_ARG_INFO()
 
@@ -284,6 +439,20 @@ PHP_METHOD(HashTable, lock)
         return;
     }
 
+    if (hto->htoi->shards) {
+        // all of the shards are locked (always in the same order), for multi-key operations
+        if (pthread_mutex_lock(&hto->htoi->shards[0].lock)) {
+            zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+            return;
+        }
+
+        for (int i = 1; i < hto->htoi->shard_count; ++i) {
+            pthread_mutex_lock(&hto->htoi->shards[i].lock);
+        }
+
+        return;
+    }
+
     if (pthread_mutex_lock(&hto->htoi->lock)) {
         zend_throw_error(NULL, "This mutex lock is already being held by this thread");
     }
@@ -300,6 +469,19 @@ PHP_METHOD(HashTable, unlock)
         return;
     }
 
+    if (hto->htoi->shards) {
+        if (pthread_mutex_unlock(&hto->htoi->shards[0].lock)) {
+            zend_throw_error(NULL, "This mutex lock is either unheld, or is currently being held by another thread");
+            return;
+        }
+
+        for (int i = 1; i < hto->htoi->shard_count; ++i) {
+            pthread_mutex_unlock(&hto->htoi->shards[i].lock);
+        }
+
+        return;
+    }
+
     if (pthread_mutex_unlock(&hto->htoi->lock)) {
         zend_throw_error(NULL, "This mutex lock is either unheld, or is currently being held by another thread");
     }
@@ -316,10 +498,28 @@ PHP_METHOD(HashTable, size)
         return;
     }
 
+    if (hto->htoi->shards) {
+        zend_long size = 0;
+
+        for (int i = 0; i < hto->htoi->shard_count; ++i) {
+            hashtable_shard_t *shard = hto->htoi->shards + i;
+            int acquired = !pthread_mutex_lock(&shard->lock);
+
+            size += shard->hashtable.used;
+
+            if (acquired) {
+                pthread_mutex_unlock(&shard->lock);
+            }
+        }
+
+        RETURN_LONG(size);
+    }
+
     RETVAL_LONG(hto->htoi->hashtable.used);
 }
 
 zend_function_entry HashTable_methods[] = {
+    PHP_ME(HashTable, __construct, HashTable___construct_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(HashTable, lock, HashTable_lock_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(HashTable, unlock, HashTable_unlock_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(HashTable, size, HashTable_size_arginfo, ZEND_ACC_PUBLIC)
@@ -25,9 +25,25 @@
 
 #include "src/ds/pht_hashtable.h"
 
+#define PHT_HASHTABLE_MAX_SHARDS 1024
+
+typedef struct _hashtable_shard_t {
+    pht_hashtable_t hashtable;
+    pthread_mutex_t lock;
+} hashtable_shard_t;
+
+/*
+A hash table is either a single table (guarded by the user through lock() and
+unlock()), or, when constructed with a shard count, a set of independently
+locked shards that the keys are distributed across by their hash. Single-key
+operations on a sharded table lock the key's shard internally.
+*/
 typedef struct _hashtable_obj_internal_t {
     pht_hashtable_t hashtable;
     pthread_mutex_t lock;
+    hashtable_shard_t *shards; // NULL unless sharded
+    int shard_count;
+    zend_bool constructed;
     uint32_t refcount;
     zend_ulong vn;
 } hashtable_obj_internal_t;
@@ -0,0 +1,807 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <Zend/zend_API.h>
+#include <Zend/zend_exceptions.h>
+#include <Zend/zend_interfaces.h>
+
+#include "php_pht.h"
+#include "src/pht_shared_string.h"
+#include "src/classes/immutable_array.h"
+
+#define IA_INVALID_IDX ((uint32_t) -1)
+#define IA_MAX_DEPTH 256
+
+typedef struct _ia_value_t {
+    union {
+        zend_long lval;
+        double dval;
+        uint32_t offset; // of the string or array node
+    } v;
+    uint32_t type;
+} ia_value_t;
+
+typedef struct _ia_bucket_t {
+    ia_value_t val;
+    zend_ulong h; // the integer key, or the hash of the string key
+    uint32_t key; // offset of the string key (0 for integer keys)
+    uint32_t next; // next bucket in the hash chain
+} ia_bucket_t;
+
+typedef struct _ia_array_t {
+    uint32_t count;
+    uint32_t mask; // hash slots - 1 (unused for packed lists)
+    uint32_t packed;
+    ia_bucket_t buckets[1]; // followed by the hash slots
+} ia_array_t;
+
+#define IA_ARRAY_SIZE(count, slots) (XtOffsetOf(ia_array_t, buckets) + sizeof(ia_bucket_t) * (count) + sizeof(uint32_t) * (slots))
+#define IA_SLOTS(arr) ((uint32_t *)((arr)->buckets + (arr)->count))
+#define IA_PTR(iaoi, offset) ((void *)((char *)(iaoi) + (offset)))
+
+typedef struct _ia_builder_t {
+    char *buf;
+    size_t len;
+    size_t cap;
+} ia_builder_t;
+
+typedef struct _ia_iterator_t {
+    zend_object_iterator it;
+    uint32_t pos;
+    zval current;
+} ia_iterator_t;
+
+zend_object_handlers immutable_array_handlers;
+zend_class_entry *ImmutableArray_ce;
+
+extern zend_class_entry *Threaded_ce;
+
+static int ia_build_array(ia_builder_t *b, HashTable *ht, uint32_t *offset, int depth);
+
+void iaoi_addref(immutable_array_obj_internal_t *iaoi)
+{
+    pht_atomic_inc(&iaoi->refcount);
+}
+
+void iaoi_release(immutable_array_obj_internal_t *iaoi)
+{
+    if (!pht_atomic_dec(&iaoi->refcount)) {
+        free(iaoi);
+    }
+}
+
+// returns 0 if the buffer could not be grown (leaving it as it was)
+static int ia_builder_alloc(ia_builder_t *b, size_t size, uint32_t *offset)
+{
+    size_t aligned_len = ZEND_MM_ALIGNED_SIZE(b->len);
+
+    if (aligned_len + size > b->cap) {
+        size_t cap = b->cap;
+        char *buf;
+
+        while (aligned_len + size > cap) {
+            cap <<= 1;
+        }
+
+        if (!(buf = realloc(b->buf, cap))) {
+            return 0;
+        }
+
+        b->buf = buf;
+        b->cap = cap;
+    }
+
+    b->len = aligned_len + size;
+    *offset = (uint32_t) aligned_len;
+
+    return 1;
+}
+
+static int ia_build_string(ia_builder_t *b, zend_string *s, uint32_t *offset)
+{
+    if (!ia_builder_alloc(b, _ZSTR_STRUCT_SIZE(ZSTR_LEN(s)), offset)) {
+        return 0;
+    }
+
+    pht_shared_string_init((zend_string *)(b->buf + *offset), s);
+
+    return 1;
+}
+
+static int ia_build_value(ia_builder_t *b, ia_value_t *iav, zval *value, int depth)
+{
+    ZVAL_DEREF(value);
+
+    iav->type = Z_TYPE_P(value);
+
+    switch (Z_TYPE_P(value)) {
+        case IS_NULL:
+        case IS_FALSE:
+        case IS_TRUE:
+            break;
+        case IS_LONG:
+            iav->v.lval = Z_LVAL_P(value);
+            break;
+        case IS_DOUBLE:
+            iav->v.dval = Z_DVAL_P(value);
+            break;
+        case IS_STRING:
+            return ia_build_string(b, Z_STR_P(value), &iav->v.offset);
+        case IS_ARRAY:
+            return ia_build_array(b, Z_ARRVAL_P(value), &iav->v.offset, depth + 1);
+        default:
+            zend_throw_error(NULL, "ImmutableArray values may only be scalars or arrays");
+            return 0;
+    }
+
+    return 1;
+}
+
+static int ia_build_array(ia_builder_t *b, HashTable *ht, uint32_t *node, int depth)
+{
+    uint32_t count = zend_hash_num_elements(ht), slots = 0, idx = 0, offset;
+    int packed = HT_IS_PACKED(ht) && ht->nNumUsed == ht->nNumOfElements;
+    zend_ulong h;
+    zend_string *key;
+    zval *value;
+    ia_array_t *arr;
+
+    if (depth > IA_MAX_DEPTH) {
+        zend_throw_error(NULL, "ImmutableArray nesting level too deep (is the array recursive?)");
+        return 0;
+    }
+
+    if (!packed) {
+        slots = 8;
+
+        while (slots < count) {
+            slots <<= 1;
+        }
+    }
+
+    if (!ia_builder_alloc(b, IA_ARRAY_SIZE(count, slots), &offset)) {
+        return 0;
+    }
+
+    arr = (ia_array_t *)(b->buf + offset);
+    arr->count = count;
+    arr->mask = slots - 1;
+    arr->packed = packed;
+
+    for (uint32_t i = 0; i < slots; ++i) {
+        IA_SLOTS(arr)[i] = IA_INVALID_IDX;
+    }
+
+    ZEND_HASH_FOREACH_KEY_VAL(ht, h, key, value) {
+        ia_bucket_t bucket;
+
+        bucket.h = h;
+        bucket.key = 0;
+
+        if (key) {
+            if (!ia_build_string(b, key, &bucket.key)) {
+                return 0;
+            }
+
+            bucket.h = ZSTR_H((zend_string *)(b->buf + bucket.key));
+        }
+
+        if (!ia_build_value(b, &bucket.val, value, depth)) {
+            return 0;
+        }
+
+        // the buffer may have been reallocated whilst building the value
+        arr = (ia_array_t *)(b->buf + offset);
+
+        if (!packed) {
+            uint32_t *slot = IA_SLOTS(arr) + (bucket.h & arr->mask);
+
+            bucket.next = *slot;
+            *slot = idx;
+        }
+
+        arr->buckets[idx++] = bucket;
+    } ZEND_HASH_FOREACH_END();
+
+    *node = offset;
+
+    return 1;
+}
+
+static immutable_array_obj_internal_t *iaoi_create(HashTable *ht)
+{
+    ia_builder_t b;
+    uint32_t header, root;
+
+    b.cap = 256;
+    b.len = 0;
+
+    if (!(b.buf = malloc(b.cap))) {
+        zend_throw_error(NULL, "Failed to create an immutable array of the specified size");
+        return NULL;
+    }
+
+    ia_builder_alloc(&b, sizeof(immutable_array_obj_internal_t), &header); // fits in the initial capacity
+
+    if (!ia_build_array(&b, ht, &root, 0)) {
+        // invalid values throw, so only a failed allocation leaves no exception
+        if (!EG(exception)) {
+            zend_throw_error(NULL, "Failed to create an immutable array of the specified size");
+        }
+
+        free(b.buf);
+        return NULL;
+    }
+
+    if (b.len > UINT32_MAX) {
+        zend_throw_error(NULL, "The array is too large to be made immutable");
+        free(b.buf);
+        return NULL;
+    }
+
+    // shrinking the buffer to fit may fail, in which case it is kept as it is
+    immutable_array_obj_internal_t *iaoi = (immutable_array_obj_internal_t *) realloc(b.buf, b.len);
+
+    if (!iaoi) {
+        iaoi = (immutable_array_obj_internal_t *) b.buf;
+    }
+
+    pht_atomic_init(&iaoi->refcount, 1);
+    iaoi->root = root;
+
+    return iaoi;
+}
+
+static ia_array_t *iao_array(immutable_array_obj_t *iao)
+{
+    if (!iao->iaoi) {
+        zend_throw_error(NULL, "The ImmutableArray object has not been constructed");
+        return NULL;
+    }
+
+    return IA_PTR(iao->iaoi, iao->node);
+}
+
+/*
+Strings are copied out of the immutable array when read, so that they do not
+outlive it (the engine does not track references to read-only strings).
+*/
+static zend_string *ia_string_copy(immutable_array_obj_internal_t *iaoi, uint32_t offset)
+{
+    return pht_shared_string_copy(IA_PTR(iaoi, offset));
+}
+
+static void ia_value_to_zval(immutable_array_obj_internal_t *iaoi, ia_value_t *iav, zval *value)
+{
+    switch (iav->type) {
+        case IS_NULL:
+            ZVAL_NULL(value);
+            break;
+        case IS_FALSE:
+            ZVAL_FALSE(value);
+            break;
+        case IS_TRUE:
+            ZVAL_TRUE(value);
+            break;
+        case IS_LONG:
+            ZVAL_LONG(value, iav->v.lval);
+            break;
+        case IS_DOUBLE:
+            ZVAL_DOUBLE(value, iav->v.dval);
+            break;
+        case IS_STRING:
+            ZVAL_STR(value, ia_string_copy(iaoi, iav->v.offset));
+            break;
+        case IS_ARRAY:
+            immutable_array_view_create(value, iaoi, iav->v.offset);
+            break;
+        EMPTY_SWITCH_DEFAULT_CASE();
+    }
+}
+
+static void ia_to_zend_array(immutable_array_obj_internal_t *iaoi, ia_array_t *arr, zval *zarr)
+{
+    array_init_size(zarr, arr->count);
+
+    for (uint32_t i = 0; i < arr->count; ++i) {
+        ia_bucket_t *bucket = arr->buckets + i;
+        zval value;
+
+        if (bucket->val.type == IS_ARRAY) {
+            ia_to_zend_array(iaoi, IA_PTR(iaoi, bucket->val.v.offset), &value);
+        } else {
+            ia_value_to_zval(iaoi, &bucket->val, &value);
+        }
+
+        if (bucket->key) {
+            zend_string *key = ia_string_copy(iaoi, bucket->key);
+
+            zend_hash_add_new(Z_ARRVAL_P(zarr), key, &value);
+            zend_string_release(key);
+        } else {
+            zend_hash_index_add_new(Z_ARRVAL_P(zarr), bucket->h, &value);
+        }
+    }
+}
+
+static ia_bucket_t *ia_find(ia_array_t *arr, immutable_array_obj_internal_t *iaoi, zval *offset)
+{
+    zend_ulong h;
+    zend_string *key;
+
+    switch (Z_TYPE_P(offset)) {
+        case IS_LONG:
+            h = (zend_ulong) Z_LVAL_P(offset);
+            goto num_index;
+        case IS_STRING:
+            key = Z_STR_P(offset);
+
+            if (ZEND_HANDLE_NUMERIC_STR(key, h)) {
+                goto num_index;
+            }
+            break;
+        default:
+            zend_throw_error(NULL, "Invalid offset type");
+            return NULL;
+    }
+
+    if (arr->packed) {
+        return NULL;
+    }
+
+    h = zend_string_hash_val(key);
+
+    for (uint32_t idx = IA_SLOTS(arr)[h & arr->mask]; idx != IA_INVALID_IDX; idx = arr->buckets[idx].next) {
+        ia_bucket_t *bucket = arr->buckets + idx;
+
+        if (bucket->key && bucket->h == h && zend_string_equal_content(IA_PTR(iaoi, bucket->key), key)) {
+            return bucket;
+        }
+    }
+
+    return NULL;
+
+num_index:
+    if (arr->packed) {
+        return h < arr->count ? arr->buckets + h : NULL;
+    }
+
+    for (uint32_t idx = IA_SLOTS(arr)[h & arr->mask]; idx != IA_INVALID_IDX; idx = arr->buckets[idx].next) {
+        ia_bucket_t *bucket = arr->buckets + idx;
+
+        if (!bucket->key && bucket->h == h) {
+            return bucket;
+        }
+    }
+
+    return NULL;
+}
+
+static zend_object *immutable_array_ctor(zend_class_entry *entry)
+{
+    immutable_array_obj_t *iao = ecalloc(1, sizeof(immutable_array_obj_t) + zend_object_properties_size(entry));
+
+    zend_object_std_init(&iao->obj, entry);
+    object_properties_init(&iao->obj, entry);
+
+    iao->obj.handlers = &immutable_array_handlers;
+    iao->iaoi = NULL;
+    iao->node = 0;
+
+    return &iao->obj;
+}
+
+void immutable_array_view_create(zval *value, immutable_array_obj_internal_t *iaoi, uint32_t node)
+{
+    object_init_ex(value, ImmutableArray_ce);
+
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ_P(value) - Z_OBJ_P(value)->handlers->offset);
+
+    iaoi_addref(iaoi);
+    iao->iaoi = iaoi;
+    iao->node = node;
+}
+
+void iao_free_obj(zend_object *obj)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)obj - obj->handlers->offset);
+
+    if (iao->iaoi) {
+        iaoi_release(iao->iaoi);
+    }
+
+    zend_object_std_dtor(obj);
+}
+
+zval *iao_read_dimension(zval *zobj, zval *offset, int type, zval *rv)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ_P(zobj) - Z_OBJ_P(zobj)->handlers->offset);
+    ia_array_t *arr;
+    ia_bucket_t *bucket;
+
+    if (offset == NULL) {
+        zend_throw_error(NULL, "Cannot read an empty offset");
+        return NULL;
+    }
+
+    if (type != BP_VAR_R && type != BP_VAR_IS) {
+        zend_throw_error(NULL, "ImmutableArray objects cannot be modified");
+        return NULL;
+    }
+
+    if (!(arr = iao_array(iao))) {
+        return NULL;
+    }
+
+    if (!(bucket = ia_find(arr, iao->iaoi, offset))) {
+        if (type != BP_VAR_IS && !EG(exception)) {
+            zend_throw_error(NULL, "Undefined offset");
+        }
+
+        return NULL;
+    }
+
+    ia_value_to_zval(iao->iaoi, &bucket->val, rv);
+
+    return rv;
+}
+
+void iao_write_dimension(zval *zobj, zval *offset, zval *value)
+{
+    zend_throw_error(NULL, "ImmutableArray objects cannot be modified");
+}
+
+void iao_unset_dimension(zval *zobj, zval *offset)
+{
+    zend_throw_error(NULL, "ImmutableArray objects cannot be modified");
+}
+
+int iao_has_dimension(zval *zobj, zval *offset, int check_empty)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ_P(zobj) - Z_OBJ_P(zobj)->handlers->offset);
+    ia_array_t *arr = iao_array(iao);
+    ia_bucket_t *bucket;
+
+    if (!arr || !(bucket = ia_find(arr, iao->iaoi, offset))) {
+        return 0;
+    }
+
+    if (!check_empty) {
+        return bucket->val.type != IS_NULL;
+    }
+
+    zval value;
+    int result;
+
+    ia_value_to_zval(iao->iaoi, &bucket->val, &value);
+    result = i_zend_is_true(&value);
+    zval_ptr_dtor(&value);
+
+    return result;
+}
+
+int iao_count_elements(zval *zobj, zend_long *count)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ_P(zobj) - Z_OBJ_P(zobj)->handlers->offset);
+    ia_array_t *arr = iao_array(iao);
+
+    *count = arr ? arr->count : 0;
+
+    return arr ? SUCCESS : FAILURE;
+}
+
+HashTable *iao_get_debug_info(zval *zobj, int *is_temp)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ_P(zobj) - Z_OBJ_P(zobj)->handlers->offset);
+    zval zarr;
+
+    *is_temp = 1;
+
+    if (!iao->iaoi) {
+        array_init(&zarr);
+    } else {
+        ia_to_zend_array(iao->iaoi, IA_PTR(iao->iaoi, iao->node), &zarr);
+    }
+
+    return Z_ARRVAL(zarr);
+}
+
+zval *iao_read_property(zval *object, zval *member, int type, void **cache, zval *rv)
+{
+    zend_throw_error(zend_ce_error, "Properties on ImmutableArray objects are not enabled", 0);
+
+    return &EG(uninitialized_zval);
+}
+
+void iao_write_property(zval *object, zval *member, zval *value, void **cache_slot)
+{
+    zend_throw_error(zend_ce_error, "Properties on ImmutableArray objects are not enabled", 0);
+}
+
+static ia_bucket_t *ia_iterator_bucket(ia_iterator_t *iter)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ(iter->it.data) - Z_OBJ(iter->it.data)->handlers->offset);
+    ia_array_t *arr = IA_PTR(iao->iaoi, iao->node);
+
+    return iter->pos < arr->count ? arr->buckets + iter->pos : NULL;
+}
+
+static void ia_iterator_dtor(zend_object_iterator *it)
+{
+    ia_iterator_t *iter = (ia_iterator_t *) it;
+
+    zval_ptr_dtor(&iter->current);
+    zval_ptr_dtor(&iter->it.data);
+}
+
+static int ia_iterator_valid(zend_object_iterator *it)
+{
+    return ia_iterator_bucket((ia_iterator_t *) it) ? SUCCESS : FAILURE;
+}
+
+static zval *ia_iterator_get_current_data(zend_object_iterator *it)
+{
+    ia_iterator_t *iter = (ia_iterator_t *) it;
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ(it->data) - Z_OBJ(it->data)->handlers->offset);
+
+    zval_ptr_dtor(&iter->current);
+    ia_value_to_zval(iao->iaoi, &ia_iterator_bucket(iter)->val, &iter->current);
+
+    return &iter->current;
+}
+
+static void ia_iterator_get_current_key(zend_object_iterator *it, zval *key)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ(it->data) - Z_OBJ(it->data)->handlers->offset);
+    ia_bucket_t *bucket = ia_iterator_bucket((ia_iterator_t *) it);
+
+    if (bucket->key) {
+        ZVAL_STR(key, ia_string_copy(iao->iaoi, bucket->key));
+    } else {
+        ZVAL_LONG(key, bucket->h);
+    }
+}
+
+static void ia_iterator_move_forward(zend_object_iterator *it)
+{
+    ++((ia_iterator_t *) it)->pos;
+}
+
+static void ia_iterator_rewind(zend_object_iterator *it)
+{
+    ((ia_iterator_t *) it)->pos = 0;
+}
+
+static zend_object_iterator_funcs ia_iterator_funcs = {
+    ia_iterator_dtor,
+    ia_iterator_valid,
+    ia_iterator_get_current_data,
+    ia_iterator_get_current_key,
+    ia_iterator_move_forward,
+    ia_iterator_rewind,
+    NULL
+};
+
+zend_object_iterator *iao_get_iterator(zend_class_entry *ce, zval *object, int by_ref)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ_P(object) - Z_OBJ_P(object)->handlers->offset);
+    ia_iterator_t *iter;
+
+    if (by_ref) {
+        zend_throw_error(NULL, "ImmutableArray objects cannot be iterated by reference");
+        return NULL;
+    }
+
+    if (!iao_array(iao)) {
+        return NULL;
+    }
+
+    iter = emalloc(sizeof(ia_iterator_t));
+
+    zend_iterator_init(&iter->it);
+
+    ZVAL_COPY(&iter->it.data, object);
+    iter->it.funcs = &ia_iterator_funcs;
+    iter->pos = 0;
+    ZVAL_UNDEF(&iter->current);
+
+    return &iter->it;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray___construct_arginfo, 0, 0, 1)
+    ZEND_ARG_ARRAY_INFO(0, array, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ImmutableArray, __construct)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    HashTable *ht;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ARRAY_HT(ht)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (iao->iaoi) {
+        zend_throw_error(NULL, "ImmutableArray objects cannot be modified");
+        return;
+    }
+
+    if ((iao->iaoi = iaoi_create(ht))) {
+        iao->node = iao->iaoi->root;
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_count_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ImmutableArray, count)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    ia_array_t *arr;
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if ((arr = iao_array(iao))) {
+        RETVAL_LONG(arr->count);
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_to_array_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ImmutableArray, toArray)
+{
+    immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    ia_array_t *arr;
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if ((arr = iao_array(iao))) {
+        ia_to_zend_array(iao->iaoi, arr, return_value);
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_offset_get_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, offset)
+ZEND_END_ARG_INFO()
+
+// the ArrayAccess methods share the lookups of the dimension handlers
+PHP_METHOD(ImmutableArray, offsetGet)
+{
+    zval *offset;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL(offset)
+    ZEND_PARSE_PARAMETERS_END();
+
+    iao_read_dimension(&EX(This), offset, BP_VAR_R, return_value);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_offset_exists_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, offset)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ImmutableArray, offsetExists)
+{
+    zval *offset;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL(offset)
+    ZEND_PARSE_PARAMETERS_END();
+
+    RETVAL_BOOL(iao_has_dimension(&EX(This), offset, 0));
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_offset_set_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ImmutableArray, offsetSet)
+{
+    zval *offset, *value;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_ZVAL(offset)
+        Z_PARAM_ZVAL(value)
+    ZEND_PARSE_PARAMETERS_END();
+
+    iao_write_dimension(&EX(This), offset, value);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_offset_unset_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, offset)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ImmutableArray, offsetUnset)
+{
+    zval *offset;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL(offset)
+    ZEND_PARSE_PARAMETERS_END();
+
+    iao_unset_dimension(&EX(This), offset);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_lock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+// immutable arrays never need locking, and so these are no-ops
+PHP_METHOD(ImmutableArray, lock)
+{
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ImmutableArray_unlock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(ImmutableArray, unlock)
+{
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+}
+
+zend_function_entry ImmutableArray_methods[] = {
+    PHP_ME(ImmutableArray, __construct, ImmutableArray___construct_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, count, ImmutableArray_count_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, toArray, ImmutableArray_to_array_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, offsetGet, ImmutableArray_offset_get_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, offsetExists, ImmutableArray_offset_exists_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, offsetSet, ImmutableArray_offset_set_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, offsetUnset, ImmutableArray_offset_unset_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, lock, ImmutableArray_lock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(ImmutableArray, unlock, ImmutableArray_unlock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+
+void immutable_array_ce_init(void)
+{
+    zend_class_entry ce;
+    zend_object_handlers *zh = zend_get_std_object_handlers();
+
+    INIT_CLASS_ENTRY(ce, "pht\\ImmutableArray", ImmutableArray_methods);
+    ImmutableArray_ce = zend_register_internal_class(&ce);
+    ImmutableArray_ce->create_object = immutable_array_ctor;
+    ImmutableArray_ce->get_iterator = iao_get_iterator;
+    ImmutableArray_ce->ce_flags |= ZEND_ACC_FINAL;
+    ImmutableArray_ce->serialize = zend_class_serialize_deny;
+    ImmutableArray_ce->unserialize = zend_class_unserialize_deny;
+
+    zend_class_implements(ImmutableArray_ce, 4, Threaded_ce, zend_ce_traversable, zend_ce_countable, zend_ce_arrayaccess);
+    memcpy(&immutable_array_handlers, zh, sizeof(zend_object_handlers));
+
+    immutable_array_handlers.offset = XtOffsetOf(immutable_array_obj_t, obj);
+    immutable_array_handlers.free_obj = iao_free_obj;
+    immutable_array_handlers.clone_obj = NULL;
+    immutable_array_handlers.read_property = iao_read_property;
+    immutable_array_handlers.write_property = iao_write_property;
+    immutable_array_handlers.read_dimension = iao_read_dimension;
+    immutable_array_handlers.write_dimension = iao_write_dimension;
+    immutable_array_handlers.has_dimension = iao_has_dimension;
+    immutable_array_handlers.unset_dimension = iao_unset_dimension;
+    immutable_array_handlers.count_elements = iao_count_elements;
+    immutable_array_handlers.get_debug_info = iao_get_debug_info;
+}
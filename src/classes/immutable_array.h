@@ -0,0 +1,51 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_IMMUTABLE_ARRAY_CLASS_H
+#define PHT_IMMUTABLE_ARRAY_CLASS_H
+
+#include <main/php.h>
+#include <stdint.h>
+
+#include "src/pht_atomic.h"
+
+/*
+An immutable array is built once into a single allocation, where all nodes
+(arrays and strings) are addressed by their offset from the start of it. This
+allows it to be read from any thread without locking, and nested arrays to be
+handed out as views into the same allocation.
+*/
+typedef struct _immutable_array_obj_internal_t {
+    pht_atomic_t refcount;
+    uint32_t root; // offset of the top-level array node
+} immutable_array_obj_internal_t;
+
+typedef struct _immutable_array_obj_t {
+    immutable_array_obj_internal_t *iaoi;
+    uint32_t node; // offset of the array node being viewed
+    zend_object obj;
+} immutable_array_obj_t;
+
+void iaoi_addref(immutable_array_obj_internal_t *iaoi);
+void iaoi_release(immutable_array_obj_internal_t *iaoi);
+void immutable_array_view_create(zval *value, immutable_array_obj_internal_t *iaoi, uint32_t node);
+void immutable_array_ce_init(void);
+
+extern zend_class_entry *ImmutableArray_ce;
+
+#endif
@@ -0,0 +1,864 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <Zend/zend_API.h>
+#include <Zend/zend_exceptions.h>
+#include <Zend/zend_interfaces.h>
+
+#include "php_pht.h"
+#include "src/pht_debug.h"
+#include "src/classes/numeric_vector.h"
+
+extern zend_class_entry *Threaded_ce;
+
+zend_object_handlers numeric_vector_handlers;
+zend_class_entry *IntVector_ce;
+zend_class_entry *FloatVector_ce;
+
+#define NVO_FROM_OBJ(zo) ((numeric_vector_obj_t *)((char *)(zo) - (zo)->handlers->offset))
+#define NVO_THIS() NVO_FROM_OBJ(Z_OBJ(EX(This)))
+
+/*
+Aggregate kernels. These are kept as plain loops over the contiguous values
+(with no calls or branches on the element types), so that the compiler is able
+to vectorise them. Integer arithmetic is performed unsigned, so that overflows
+wrap around rather than being undefined. The floating point sums use several
+independent accumulators, since the compiler may not reorder a single running
+sum itself.
+*/
+static zend_long long_sum(const zend_long *values, zend_long n)
+{
+    zend_ulong sum = 0;
+
+    for (zend_long i = 0; i < n; ++i) {
+        sum += (zend_ulong) values[i];
+    }
+
+    return (zend_long) sum;
+}
+
+static double double_sum(const double *values, zend_long n)
+{
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    zend_long i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        s0 += values[i];
+        s1 += values[i + 1];
+        s2 += values[i + 2];
+        s3 += values[i + 3];
+    }
+
+    for (; i < n; ++i) {
+        s0 += values[i];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static zend_long long_min(const zend_long *values, zend_long n)
+{
+    zend_long min = values[0];
+
+    for (zend_long i = 1; i < n; ++i) {
+        min = values[i] < min ? values[i] : min;
+    }
+
+    return min;
+}
+
+static zend_long long_max(const zend_long *values, zend_long n)
+{
+    zend_long max = values[0];
+
+    for (zend_long i = 1; i < n; ++i) {
+        max = values[i] > max ? values[i] : max;
+    }
+
+    return max;
+}
+
+static double double_min(const double *values, zend_long n)
+{
+    double min = values[0];
+
+    for (zend_long i = 1; i < n; ++i) {
+        min = values[i] < min ? values[i] : min;
+    }
+
+    return min;
+}
+
+static double double_max(const double *values, zend_long n)
+{
+    double max = values[0];
+
+    for (zend_long i = 1; i < n; ++i) {
+        max = values[i] > max ? values[i] : max;
+    }
+
+    return max;
+}
+
+static zend_long long_dot(const zend_long *a, const zend_long *b, zend_long n)
+{
+    zend_ulong dot = 0;
+
+    for (zend_long i = 0; i < n; ++i) {
+        dot += (zend_ulong) a[i] * (zend_ulong) b[i];
+    }
+
+    return (zend_long) dot;
+}
+
+static double double_dot(const double *a, const double *b, zend_long n)
+{
+    double d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+    zend_long i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        d0 += a[i] * b[i];
+        d1 += a[i + 1] * b[i + 1];
+        d2 += a[i + 2] * b[i + 2];
+        d3 += a[i + 3] * b[i + 3];
+    }
+
+    for (; i < n; ++i) {
+        d0 += a[i] * b[i];
+    }
+
+    return (d0 + d1) + (d2 + d3);
+}
+
+static void long_scale(zend_long *values, zend_long n, zend_long factor)
+{
+    for (zend_long i = 0; i < n; ++i) {
+        values[i] = (zend_long) ((zend_ulong) values[i] * (zend_ulong) factor);
+    }
+}
+
+static void double_scale(double *values, zend_long n, double factor)
+{
+    for (zend_long i = 0; i < n; ++i) {
+        values[i] *= factor;
+    }
+}
+
+static numeric_vector_obj_internal_t *nvoi_create(zend_uchar type)
+{
+    numeric_vector_obj_internal_t *nvoi = calloc(1, sizeof(numeric_vector_obj_internal_t));
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&nvoi->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    nvoi->type = type;
+    nvoi->refcount = 1;
+
+    return nvoi;
+}
+
+void nvoi_addref(numeric_vector_obj_internal_t *nvoi)
+{
+    pthread_mutex_lock(&nvoi->lock);
+    ++nvoi->refcount;
+    pthread_mutex_unlock(&nvoi->lock);
+}
+
+void nvoi_release(numeric_vector_obj_internal_t *nvoi)
+{
+    pthread_mutex_lock(&nvoi->lock);
+    --nvoi->refcount;
+    pthread_mutex_unlock(&nvoi->lock);
+
+    if (!nvoi->refcount) {
+        pthread_mutex_destroy(&nvoi->lock);
+        free(nvoi->values.p);
+        free(nvoi);
+    }
+}
+
+static size_t nvoi_element_size(numeric_vector_obj_internal_t *nvoi)
+{
+    return nvoi->type == IS_LONG ? sizeof(zend_long) : sizeof(double);
+}
+
+/*
+Resizes the values of nvoi, setting any new elements to value. Returns 0 (with
+the vector left untouched) on failure.
+*/
+static int nvoi_resize(numeric_vector_obj_internal_t *nvoi, zend_long size, zval *value)
+{
+    size_t element_size = nvoi_element_size(nvoi);
+    void *values;
+
+    if ((size_t) size > SIZE_MAX / element_size) {
+        return 0;
+    }
+
+    if (!size) {
+        free(nvoi->values.p);
+        nvoi->values.p = NULL;
+        nvoi->size = 0;
+        return 1;
+    }
+
+    if (!(values = realloc(nvoi->values.p, size * element_size))) {
+        return 0;
+    }
+
+    nvoi->values.p = values;
+
+    if (nvoi->type == IS_LONG) {
+        zend_long l = value ? Z_LVAL_P(value) : 0;
+
+        for (zend_long i = nvoi->size; i < size; ++i) {
+            nvoi->values.l[i] = l;
+        }
+    } else {
+        double d = value ? zval_get_double(value) : 0;
+
+        for (zend_long i = nvoi->size; i < size; ++i) {
+            nvoi->values.d[i] = d;
+        }
+    }
+
+    nvoi->size = size;
+
+    return 1;
+}
+
+/*
+IntVectors only accept integers, whilst FloatVectors accept both integers and
+floats. An error is thrown for anything else.
+*/
+static int nvoi_check_value(numeric_vector_obj_internal_t *nvoi, zval *value)
+{
+    ZVAL_DEREF(value);
+
+    if (Z_TYPE_P(value) == IS_LONG || (Z_TYPE_P(value) == IS_DOUBLE && nvoi->type == IS_DOUBLE)) {
+        return 1;
+    }
+
+    if (nvoi->type == IS_LONG) {
+        zend_throw_error(NULL, "Invalid value type - only integers can be stored in an IntVector");
+    } else {
+        zend_throw_error(NULL, "Invalid value type - only integers and floats can be stored in a FloatVector");
+    }
+
+    return 0;
+}
+
+// the value must have been checked with nvoi_check_value() first
+static void nvoi_store(numeric_vector_obj_internal_t *nvoi, zend_long index, zval *value)
+{
+    ZVAL_DEREF(value);
+
+    if (nvoi->type == IS_LONG) {
+        nvoi->values.l[index] = Z_LVAL_P(value);
+    } else {
+        nvoi->values.d[index] = zval_get_double(value);
+    }
+}
+
+static void nvoi_fetch(numeric_vector_obj_internal_t *nvoi, zend_long index, zval *value)
+{
+    if (nvoi->type == IS_LONG) {
+        ZVAL_LONG(value, nvoi->values.l[index]);
+    } else {
+        ZVAL_DOUBLE(value, nvoi->values.d[index]);
+    }
+}
+
+static void nvoi_to_zend_array(numeric_vector_obj_internal_t *nvoi, zend_long offset, zend_long length, zval *zarr)
+{
+    array_init_size(zarr, length);
+    zend_hash_real_init(Z_ARRVAL_P(zarr), 1);
+
+    ZEND_HASH_FILL_PACKED(Z_ARRVAL_P(zarr)) {
+        for (zend_long i = offset; i < offset + length; ++i) {
+            zval value;
+
+            nvoi_fetch(nvoi, i, &value);
+            ZEND_HASH_FILL_ADD(&value);
+        }
+    } ZEND_HASH_FILL_END();
+}
+
+static zend_object *numeric_vector_ctor(zend_class_entry *entry)
+{
+    numeric_vector_obj_t *nvo = ecalloc(1, sizeof(numeric_vector_obj_t) + zend_object_properties_size(entry));
+
+    zend_object_std_init(&nvo->obj, entry);
+    object_properties_init(&nvo->obj, entry);
+
+    nvo->obj.handlers = &numeric_vector_handlers;
+    nvo->nvoi = NULL; // created by the constructor, or attached by numeric_vector_wrap()
+
+    return &nvo->obj;
+}
+
+void numeric_vector_wrap(zval *value, numeric_vector_obj_internal_t *nvoi)
+{
+    object_init_ex(value, nvoi->type == IS_LONG ? IntVector_ce : FloatVector_ce);
+
+    numeric_vector_obj_t *nvo = NVO_FROM_OBJ(Z_OBJ_P(value));
+
+    nvoi_addref(nvoi);
+    nvo->nvoi = nvoi;
+}
+
+void nvo_dtor_obj(zend_object *obj)
+{
+    zend_object_std_dtor(obj);
+}
+
+void nvo_free_obj(zend_object *obj)
+{
+    numeric_vector_obj_t *nvo = NVO_FROM_OBJ(obj);
+
+    if (nvo->nvoi) {
+        nvoi_release(nvo->nvoi);
+    }
+}
+
+static zend_long nvo_offset(numeric_vector_obj_t *nvo, zval *offset, int type)
+{
+    if (!offset) {
+        zend_throw_error(NULL, "Cannot append to a numeric vector - resize() it instead");
+        return -1;
+    }
+
+    if (Z_TYPE_P(offset) != IS_LONG) {
+        zend_throw_error(NULL, "Invalid offset type");
+        return -1;
+    }
+
+    if (Z_LVAL_P(offset) < 0 || Z_LVAL_P(offset) >= nvo->nvoi->size) {
+        if (type != BP_VAR_IS) {
+            zend_throw_error(NULL, "Invalid index - the index must be within the vector size");
+        }
+        return -1;
+    }
+
+    return Z_LVAL_P(offset);
+}
+
+zval *nvo_read_dimension(zval *zobj, zval *offset, int type, zval *rv)
+{
+    numeric_vector_obj_t *nvo = NVO_FROM_OBJ(Z_OBJ_P(zobj));
+    zend_long index = nvo_offset(nvo, offset, type);
+
+    if (index < 0) {
+        return NULL;
+    }
+
+    nvoi_fetch(nvo->nvoi, index, rv);
+
+    return rv;
+}
+
+void nvo_write_dimension(zval *zobj, zval *offset, zval *value)
+{
+    numeric_vector_obj_t *nvo = NVO_FROM_OBJ(Z_OBJ_P(zobj));
+    zend_long index = nvo_offset(nvo, offset, BP_VAR_W);
+
+    if (index < 0 || !nvoi_check_value(nvo->nvoi, value)) {
+        return;
+    }
+
+    nvoi_store(nvo->nvoi, index, value);
+}
+
+int nvo_has_dimension(zval *zobj, zval *offset, int check_empty)
+{
+    numeric_vector_obj_t *nvo = NVO_FROM_OBJ(Z_OBJ_P(zobj));
+    zend_long index = nvo_offset(nvo, offset, BP_VAR_IS);
+
+    if (index < 0) {
+        return 0;
+    }
+
+    if (!check_empty) {
+        return 1;
+    }
+
+    if (nvo->nvoi->type == IS_LONG) {
+        return nvo->nvoi->values.l[index] != 0;
+    }
+
+    return nvo->nvoi->values.d[index] != 0;
+}
+
+void nvo_unset_dimension(zval *zobj, zval *offset)
+{
+    zend_throw_error(NULL, "Elements of numeric vectors cannot be unset");
+}
+
+int nvo_count_elements(zval *zobj, zend_long *count)
+{
+    numeric_vector_obj_t *nvo = NVO_FROM_OBJ(Z_OBJ_P(zobj));
+
+    *count = nvo->nvoi ? nvo->nvoi->size : 0;
+
+    return SUCCESS;
+}
+
+HashTable *nvo_get_debug_info(zval *zobj, int *is_temp)
+{
+    numeric_vector_obj_t *nvo = NVO_FROM_OBJ(Z_OBJ_P(zobj));
+    zval zarr;
+
+    *is_temp = 1;
+
+    if (!nvo->nvoi) {
+        array_init(&zarr);
+    } else {
+        nvoi_to_zend_array(nvo->nvoi, 0, nvo->nvoi->size, &zarr);
+    }
+
+    return Z_ARRVAL(zarr);
+}
+
+zval *nvo_read_property(zval *object, zval *member, int type, void **cache, zval *rv)
+{
+    zend_throw_error(zend_ce_error, "Properties on numeric vector objects are not enabled", 0);
+
+    return &EG(uninitialized_zval);
+}
+
+void nvo_write_property(zval *object, zval *member, zval *value, void **cache_slot)
+{
+    zend_throw_error(zend_ce_error, "Properties on numeric vector objects are not enabled", 0);
+}
+
+static zend_uchar nvo_class_type(zend_class_entry *ce)
+{
+    return ce == IntVector_ce ? IS_LONG : IS_DOUBLE;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector___construct_arginfo, 0, 0, 0)
+    ZEND_ARG_INFO(0, size)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, __construct)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+    numeric_vector_obj_internal_t *nvoi;
+    zend_long size = 0;
+    zval *value = NULL;
+
+    ZEND_PARSE_PARAMETERS_START(0, 2)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(size)
+        Z_PARAM_ZVAL_DEREF(value)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (nvo->nvoi) {
+        zend_throw_error(NULL, "Numeric vectors cannot be constructed more than once");
+        return;
+    }
+
+    if (size < 0) {
+        zend_throw_error(NULL, "Invalid size given - size must be a non-negative integer");
+        return;
+    }
+
+    nvoi = nvoi_create(nvo_class_type(Z_OBJCE(EX(This))));
+
+    if (value && !nvoi_check_value(nvoi, value)) {
+        nvoi_release(nvoi);
+        return;
+    }
+
+    if (!nvoi_resize(nvoi, size, value)) {
+        nvoi_release(nvoi);
+        zend_throw_error(NULL, "Failed to create a vector of the specified size");
+        return;
+    }
+
+    nvo->nvoi = nvoi;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_fromArray_arginfo, 0, 0, 1)
+    ZEND_ARG_ARRAY_INFO(0, values, 0)
+ZEND_END_ARG_INFO()
+
+/*
+Creates a vector holding the values of the given array (in order, ignoring the
+keys).
+*/
+PHP_METHOD(NumericVector, fromArray)
+{
+    zend_class_entry *ce = EX(func)->common.scope;
+    numeric_vector_obj_internal_t *nvoi;
+    HashTable *ht;
+    zval *value;
+    zend_long i = 0;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ARRAY_HT(ht)
+    ZEND_PARSE_PARAMETERS_END();
+
+    nvoi = nvoi_create(nvo_class_type(ce));
+
+    ZEND_HASH_FOREACH_VAL(ht, value) {
+        if (!nvoi_check_value(nvoi, value)) {
+            nvoi_release(nvoi);
+            return;
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    if (!nvoi_resize(nvoi, zend_hash_num_elements(ht), NULL)) {
+        nvoi_release(nvoi);
+        zend_throw_error(NULL, "Failed to create a vector of the specified size");
+        return;
+    }
+
+    ZEND_HASH_FOREACH_VAL(ht, value) {
+        nvoi_store(nvoi, i++, value);
+    } ZEND_HASH_FOREACH_END();
+
+    numeric_vector_wrap(return_value, nvoi);
+    nvoi_release(nvoi); // the object holds the only reference now
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_toArray_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, toArray)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    nvoi_to_zend_array(nvo->nvoi, 0, nvo->nvoi->size, return_value);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_getRange_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, length)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, getRange)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+    zend_long offset, length;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_LONG(offset)
+        Z_PARAM_LONG(length)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (offset < 0 || length < 0 || offset > nvo->nvoi->size - length) {
+        zend_throw_error(NULL, "Invalid range - the range must be within the vector size");
+        return;
+    }
+
+    nvoi_to_zend_array(nvo->nvoi, offset, length, return_value);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_setRange_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_ARRAY_INFO(0, values, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, setRange)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+    zend_long offset;
+    HashTable *ht;
+    zval *value;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_LONG(offset)
+        Z_PARAM_ARRAY_HT(ht)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (offset < 0 || offset > nvo->nvoi->size - (zend_long) zend_hash_num_elements(ht)) {
+        zend_throw_error(NULL, "Invalid range - the range must be within the vector size");
+        return;
+    }
+
+    // all values are checked up front, so that the vector is left untouched on failure
+    ZEND_HASH_FOREACH_VAL(ht, value) {
+        if (!nvoi_check_value(nvo->nvoi, value)) {
+            return;
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    ZEND_HASH_FOREACH_VAL(ht, value) {
+        nvoi_store(nvo->nvoi, offset++, value);
+    } ZEND_HASH_FOREACH_END();
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_resize_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, size)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, resize)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+    zend_long size;
+    zval *value = NULL;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_LONG(size)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_ZVAL_DEREF(value)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (size < 0) {
+        zend_throw_error(NULL, "Invalid size given - size must be a non-negative integer");
+        return;
+    }
+
+    if (value && !nvoi_check_value(nvo->nvoi, value)) {
+        return;
+    }
+
+    if (!nvoi_resize(nvo->nvoi, size, value)) {
+        zend_throw_error(NULL, "Failed to resize the vector to the specified size");
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_size_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, size)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    RETVAL_LONG(nvo->nvoi->size);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_sum_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, sum)
+{
+    numeric_vector_obj_internal_t *nvoi = NVO_THIS()->nvoi;
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if (nvoi->type == IS_LONG) {
+        RETVAL_LONG(long_sum(nvoi->values.l, nvoi->size));
+    } else {
+        RETVAL_DOUBLE(double_sum(nvoi->values.d, nvoi->size));
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_min_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, min)
+{
+    numeric_vector_obj_internal_t *nvoi = NVO_THIS()->nvoi;
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if (!nvoi->size) {
+        zend_throw_error(NULL, "Attempted to find the minimum of an empty vector");
+        return;
+    }
+
+    if (nvoi->type == IS_LONG) {
+        RETVAL_LONG(long_min(nvoi->values.l, nvoi->size));
+    } else {
+        RETVAL_DOUBLE(double_min(nvoi->values.d, nvoi->size));
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_max_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, max)
+{
+    numeric_vector_obj_internal_t *nvoi = NVO_THIS()->nvoi;
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if (!nvoi->size) {
+        zend_throw_error(NULL, "Attempted to find the maximum of an empty vector");
+        return;
+    }
+
+    if (nvoi->type == IS_LONG) {
+        RETVAL_LONG(long_max(nvoi->values.l, nvoi->size));
+    } else {
+        RETVAL_DOUBLE(double_max(nvoi->values.d, nvoi->size));
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_dot_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, vector)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, dot)
+{
+    numeric_vector_obj_internal_t *nvoi = NVO_THIS()->nvoi, *other_nvoi;
+    zval *other;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_OBJECT_OF_CLASS(other, EX(func)->common.scope)
+    ZEND_PARSE_PARAMETERS_END();
+
+    other_nvoi = NVO_FROM_OBJ(Z_OBJ_P(other))->nvoi;
+
+    if (!other_nvoi || other_nvoi->size != nvoi->size) {
+        zend_throw_error(NULL, "Invalid vector - both vectors must be of the same size");
+        return;
+    }
+
+    if (nvoi->type == IS_LONG) {
+        RETVAL_LONG(long_dot(nvoi->values.l, other_nvoi->values.l, nvoi->size));
+    } else {
+        RETVAL_DOUBLE(double_dot(nvoi->values.d, other_nvoi->values.d, nvoi->size));
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_scale_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, factor)
+ZEND_END_ARG_INFO()
+
+// multiplies each element of the vector by the factor, in place
+PHP_METHOD(NumericVector, scale)
+{
+    numeric_vector_obj_internal_t *nvoi = NVO_THIS()->nvoi;
+    zval *factor;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL_DEREF(factor)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!nvoi_check_value(nvoi, factor)) {
+        return;
+    }
+
+    if (nvoi->type == IS_LONG) {
+        long_scale(nvoi->values.l, nvoi->size, Z_LVAL_P(factor));
+    } else {
+        double_scale(nvoi->values.d, nvoi->size, zval_get_double(factor));
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_lock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, lock)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if (pthread_mutex_lock(&nvo->nvoi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(NumericVector_unlock_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(NumericVector, unlock)
+{
+    numeric_vector_obj_t *nvo = NVO_THIS();
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    if (pthread_mutex_unlock(&nvo->nvoi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is either unheld, or is currently being held by another thread");
+    }
+}
+
+zend_function_entry NumericVector_methods[] = {
+    PHP_ME(NumericVector, __construct, NumericVector___construct_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, fromArray, NumericVector_fromArray_arginfo, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+    PHP_ME(NumericVector, toArray, NumericVector_toArray_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, getRange, NumericVector_getRange_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, setRange, NumericVector_setRange_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, resize, NumericVector_resize_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, size, NumericVector_size_arginfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(NumericVector, count, size, NumericVector_size_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, sum, NumericVector_sum_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, min, NumericVector_min_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, max, NumericVector_max_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, dot, NumericVector_dot_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, scale, NumericVector_scale_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, lock, NumericVector_lock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(NumericVector, unlock, NumericVector_unlock_arginfo, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+
+static zend_class_entry *numeric_vector_ce_register(const char *name, size_t name_len)
+{
+    zend_class_entry ce, *registered;
+
+    INIT_CLASS_ENTRY_EX(ce, name, name_len, NumericVector_methods);
+    registered = zend_register_internal_class(&ce);
+    registered->create_object = numeric_vector_ctor;
+    registered->ce_flags |= ZEND_ACC_FINAL;
+    registered->serialize = zend_class_serialize_deny;
+    registered->unserialize = zend_class_unserialize_deny;
+
+    zend_class_implements(registered, 2, Threaded_ce, zend_ce_countable);
+
+    return registered;
+}
+
+void numeric_vector_ce_init(void)
+{
+    zend_object_handlers *zh = zend_get_std_object_handlers();
+
+    IntVector_ce = numeric_vector_ce_register(ZEND_STRL("pht\\IntVector"));
+    FloatVector_ce = numeric_vector_ce_register(ZEND_STRL("pht\\FloatVector"));
+
+    memcpy(&numeric_vector_handlers, zh, sizeof(zend_object_handlers));
+
+    numeric_vector_handlers.offset = XtOffsetOf(numeric_vector_obj_t, obj);
+    numeric_vector_handlers.dtor_obj = nvo_dtor_obj;
+    numeric_vector_handlers.free_obj = nvo_free_obj;
+    numeric_vector_handlers.clone_obj = NULL;
+    numeric_vector_handlers.read_property = nvo_read_property;
+    numeric_vector_handlers.write_property = nvo_write_property;
+    numeric_vector_handlers.read_dimension = nvo_read_dimension;
+    numeric_vector_handlers.write_dimension = nvo_write_dimension;
+    numeric_vector_handlers.has_dimension = nvo_has_dimension;
+    numeric_vector_handlers.unset_dimension = nvo_unset_dimension;
+    numeric_vector_handlers.count_elements = nvo_count_elements;
+    numeric_vector_handlers.get_debug_info = nvo_get_debug_info;
+}
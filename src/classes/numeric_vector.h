@@ -0,0 +1,55 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_NUMERIC_VECTOR_CLASS_H
+#define PHT_NUMERIC_VECTOR_CLASS_H
+
+#include <main/php.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+The shared storage of IntVector and FloatVector objects: a single contiguous
+array of either zend_longs (type IS_LONG) or doubles (type IS_DOUBLE).
+*/
+typedef struct _numeric_vector_obj_internal_t {
+    union {
+        zend_long *l;
+        double *d;
+        void *p;
+    } values;
+    zend_long size;
+    zend_uchar type;
+    pthread_mutex_t lock;
+    uint32_t refcount;
+} numeric_vector_obj_internal_t;
+
+typedef struct _numeric_vector_obj_t {
+    numeric_vector_obj_internal_t *nvoi;
+    zend_object obj;
+} numeric_vector_obj_t;
+
+extern zend_class_entry *IntVector_ce;
+extern zend_class_entry *FloatVector_ce;
+
+void nvoi_addref(numeric_vector_obj_internal_t *nvoi);
+void nvoi_release(numeric_vector_obj_internal_t *nvoi);
+void numeric_vector_wrap(zval *value, numeric_vector_obj_internal_t *nvoi);
+void numeric_vector_ce_init(void);
+
+#endif
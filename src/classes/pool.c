@@ -0,0 +1,699 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <limits.h>
+#include <main/php.h>
+#include <Zend/zend_API.h>
+#include <Zend/zend_exceptions.h>
+
+#include "php_pht.h"
+#include "src/pht_debug.h"
+#include "src/classes/pool.h"
+
+extern zend_class_entry *Runnable_ce;
+
+zend_object_handlers pool_handlers;
+zend_class_entry *Pool_ce;
+
+static void pool_free_workers(pool_obj_t *pool)
+{
+    for (int i = 0; i < pool->size; ++i) {
+        pool_worker_t *worker = pool->workers + i;
+
+        pht_priority_queue_destroy(&worker->thread.tasks);
+        pthread_cond_destroy(&worker->thread.cond);
+        pthread_mutex_destroy(&worker->thread.lock);
+    }
+
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->size = 0;
+}
+
+void pool_join_destroy(zval *zpool)
+{
+    pool_obj_t *pool = Z_PTR_P(zpool);
+
+    if (pool->status == STARTED) {
+        pthread_mutex_lock(&pool->lock);
+        pool->status = JOINED;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int i = 0; i < pool->size; ++i) {
+            pthread_join(pool->workers[i].thread.thread, NULL);
+        }
+    }
+
+    if (pool->workers) {
+        pool_free_workers(pool);
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+
+    // as with threads, the pool object itself is freed by the object store
+}
+
+void pool_free_obj(zend_object *obj)
+{
+    if (EG(exit_status)) {
+        // See th_free_obj() for why the object is not removed from
+        // PHT_ZG(child_pools) here
+        return;
+    }
+
+    pool_obj_t *pool = (pool_obj_t *)((char *)obj - obj->handlers->offset);
+
+    zend_hash_index_del(&PHT_ZG(child_pools), (zend_ulong)pool);
+}
+
+static void pool_add_task(pool_obj_t *pool, task_t *task)
+{
+    pool_worker_t *worker = pool->workers + pool->next_worker;
+
+    pool->next_worker = (pool->next_worker + 1) % pool->size;
+
+    // The pool lock is held whilst pushing the task so that a worker cannot
+    // dequeue it (and decrement pool->queued) before it has been counted
+    pthread_mutex_lock(&pool->lock);
+
+    pthread_mutex_lock(&worker->thread.lock);
+    pht_priority_queue_push(&worker->thread.tasks, task, pool->task_priority);
+    pthread_mutex_unlock(&worker->thread.lock);
+
+    ++pool->queued;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void pool_add_tasks(pool_obj_t *pool, pht_queue_t *batch)
+{
+    int count = pht_queue_size(batch);
+    int chunk_size = (count + pool->size - 1) / pool->size;
+    int chunk_count = chunk_size ? (count + chunk_size - 1) / chunk_size : 0;
+    pht_queue_t *chunks = malloc(sizeof(pht_queue_t) * chunk_count); // VLAs not supported by VC15
+    int first_worker = pool->next_worker;
+
+    // split the batch into contiguous per-worker chunks before taking any locks
+    for (int i = 0; i < chunk_count; ++i) {
+        pht_queue_init(chunks + i, task_delete);
+        pht_queue_split(batch, chunks + i, chunk_size);
+    }
+
+    pool->next_worker = (first_worker + chunk_count) % pool->size;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (int i = 0; i < chunk_count; ++i) {
+        pool_worker_t *worker = pool->workers + (first_worker + i) % pool->size;
+
+        pthread_mutex_lock(&worker->thread.lock);
+        pht_priority_queue_splice(&worker->thread.tasks, chunks + i, pool->task_priority);
+        pthread_mutex_unlock(&worker->thread.lock);
+    }
+
+    pool->queued += count;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    free(chunks);
+}
+
+static task_t *pool_steal_task(pool_worker_t *thief)
+{
+    pool_obj_t *pool = thief->pool;
+    pool_worker_t *victim = NULL;
+    int victim_size = 0;
+
+    // steal from the worker with the longest backlog (sizes are read unlocked,
+    // so this is only a heuristic - the pop below is what is authoritative)
+    for (int i = 0; i < pool->size; ++i) {
+        pool_worker_t *worker = pool->workers + i;
+        int size = *(volatile int *)&worker->thread.tasks.size;
+
+        if (worker != thief && size > victim_size) {
+            victim = worker;
+            victim_size = size;
+        }
+    }
+
+    if (!victim) {
+        return NULL;
+    }
+
+    // taken from the back, so that the thief does not contend with the victim
+    // for the task that the victim is about to take from the front
+    pthread_mutex_lock(&victim->thread.lock);
+    task_t *task = pht_priority_queue_pop_back(&victim->thread.tasks);
+    pthread_mutex_unlock(&victim->thread.lock);
+
+    return task;
+}
+
+static task_t *pool_next_task(pool_worker_t *worker)
+{
+    pool_obj_t *pool = worker->pool;
+
+    while (1) {
+        pthread_mutex_lock(&worker->thread.lock);
+        task_t *task = pht_priority_queue_pop(&worker->thread.tasks);
+        task_cache_stats_publish(&worker->thread.cache_stats);
+        pthread_mutex_unlock(&worker->thread.lock);
+
+        if (!task) {
+            task = pool_steal_task(worker);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+
+        if (task) {
+            --pool->queued;
+            ++pool->in_flight;
+            pthread_mutex_unlock(&pool->lock);
+
+            return task;
+        }
+
+        if (!pool->queued) {
+            if (pool->status == JOINED) {
+                pthread_mutex_unlock(&pool->lock);
+
+                return NULL;
+            }
+
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+void *pool_worker_function(pool_worker_t *worker)
+{
+    pool_obj_t *pool = worker->pool;
+    task_t *task;
+
+    thread_context_startup(&worker->thread);
+
+    while ((task = pool_next_task(worker))) {
+        handle_task(task);
+        task_delete(task);
+
+        pthread_mutex_lock(&pool->lock);
+        --pool->in_flight;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    thread_context_shutdown();
+
+    pthread_exit(NULL);
+}
+
+static zend_object *pool_ctor(zend_class_entry *entry)
+{
+    pool_obj_t *pool = ecalloc(1, sizeof(pool_obj_t) + zend_object_properties_size(entry));
+
+    pool->workers = NULL;
+    pool->size = 0;
+    pool->next_worker = 0;
+    pool->task_priority = PHT_PRIORITY_NORMAL;
+    pool->status = NOT_STARTED;
+    pool->queued = 0;
+    pool->in_flight = 0;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    zend_object_std_init(&pool->obj, entry);
+    object_properties_init(&pool->obj, entry);
+
+    pool->obj.handlers = &pool_handlers;
+
+    zend_hash_index_add_ptr(&PHT_ZG(child_pools), (zend_ulong)pool, pool);
+
+    return &pool->obj;
+}
+
+static pool_obj_t *pool_fetch_initialised(zend_execute_data *execute_data)
+{
+    pool_obj_t *pool = (pool_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+
+    if (!pool->workers) {
+        zend_throw_error(NULL, "The pool has not been constructed");
+        return NULL;
+    }
+
+    return pool;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool___construct_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, size)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, __construct)
+{
+    pool_obj_t *pool = (pool_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    zend_long size;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(size)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (size < 1 || size > INT_MAX) {
+        zend_throw_error(NULL, "Invalid pool size given - it must be a positive integer");
+        return;
+    }
+
+    if (pool->workers) {
+        zend_throw_error(NULL, "The pool has already been constructed");
+        return;
+    }
+
+    if (!(pool->workers = calloc(size, sizeof(pool_worker_t)))) {
+        pool->size = 0;
+        zend_throw_error(NULL, "Failed to create a pool of the specified size");
+        return;
+    }
+
+    pool->size = size;
+
+    for (int i = 0; i < pool->size; ++i) {
+        thread_init(&pool->workers[i].thread);
+        pool->workers[i].pool = pool;
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_add_class_task_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, class_name)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, addClassTask)
+{
+    zend_class_entry *ce = Runnable_ce;
+    zval *args;
+    int argc = 0;
+
+    ZEND_PARSE_PARAMETERS_START(1, -1)
+        Z_PARAM_CLASS(ce)
+        Z_PARAM_VARIADIC('*', args, argc)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    task_t *task = class_task_create(ce, args, argc, "Pool::addClassTask");
+
+    if (!task) {
+        return;
+    }
+
+    if (USED_RET()) {
+        task_attach_future(task, return_value);
+    }
+
+    pool_add_task(pool, task);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_add_function_task_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, callable)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, addFunctionTask)
+{
+    zval *args, *zcallable;
+    int argc = 0;
+
+    ZEND_PARSE_PARAMETERS_START(1, -1)
+        Z_PARAM_ZVAL(zcallable)
+        Z_PARAM_VARIADIC('*', args, argc)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    task_t *task = function_task_create(zcallable, args, argc, "Pool::addFunctionTask");
+
+    if (!task) {
+        return;
+    }
+
+    if (USED_RET()) {
+        task_attach_future(task, return_value);
+    }
+
+    pool_add_task(pool, task);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_add_file_task_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, filename)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, addFileTask)
+{
+    zend_string *filename;
+    zval *args;
+    int argc = 0;
+
+    ZEND_PARSE_PARAMETERS_START(1, -1)
+        Z_PARAM_PATH_STR(filename)
+        Z_PARAM_VARIADIC('*', args, argc)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    task_t *task = file_task_create(filename, args, argc, "Pool::addFileTask");
+
+    if (!task) {
+        return;
+    }
+
+    pool_add_task(pool, task);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_add_class_tasks_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, class_name)
+    ZEND_ARG_INFO(0, ctor_arg_sets)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, addClassTasks)
+{
+    zend_class_entry *ce = Runnable_ce;
+    zval *arg_sets;
+    pht_queue_t batch;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_CLASS(ce)
+        Z_PARAM_ZVAL(arg_sets)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    task_t *template = class_task_create(ce, NULL, 0, "Pool::addClassTasks");
+
+    if (!template) {
+        return;
+    }
+
+    if (!task_batch_create(&batch, template, arg_sets, USED_RET() ? return_value : NULL, "Pool::addClassTasks")) {
+        return;
+    }
+
+    pool_add_tasks(pool, &batch);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_add_function_tasks_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, callable)
+    ZEND_ARG_INFO(0, arg_sets)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, addFunctionTasks)
+{
+    zval *zcallable, *arg_sets;
+    pht_queue_t batch;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_ZVAL(zcallable)
+        Z_PARAM_ZVAL(arg_sets)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    task_t *template = function_task_create(zcallable, NULL, 0, "Pool::addFunctionTasks");
+
+    if (!template) {
+        return;
+    }
+
+    if (!task_batch_create(&batch, template, arg_sets, USED_RET() ? return_value : NULL, "Pool::addFunctionTasks")) {
+        return;
+    }
+
+    pool_add_tasks(pool, &batch);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_add_file_tasks_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, filename)
+    ZEND_ARG_INFO(0, global_sets)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, addFileTasks)
+{
+    zend_string *filename;
+    zval *arg_sets;
+    pht_queue_t batch;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_PATH_STR(filename)
+        Z_PARAM_ZVAL(arg_sets)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    task_t *template = file_task_create(filename, NULL, 0, "Pool::addFileTasks");
+
+    if (!template) {
+        return;
+    }
+
+    if (!task_batch_create(&batch, template, arg_sets, NULL, "Pool::addFileTasks")) {
+        return;
+    }
+
+    pool_add_tasks(pool, &batch);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_set_task_priority_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, priority)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, setTaskPriority)
+{
+    pool_obj_t *pool = (pool_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    zend_long priority;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(priority)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!task_priority_valid(priority)) {
+        return;
+    }
+
+    pool->task_priority = priority;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_start_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, start)
+{
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    if (pool->status != NOT_STARTED) {
+        zend_throw_error(NULL, "The pool has already been started");
+        return;
+    }
+
+    pool->status = STARTED;
+
+    for (int i = 0; i < pool->size; ++i) {
+        pool_worker_t *worker = pool->workers + i;
+
+        worker->thread.status = STARTING_UP;
+        // every worker attaches to the same snapshot, which is built only once
+        worker->thread.snapshot = pht_snapshot_acquire();
+
+        pthread_create((pthread_t *)worker, NULL, (void *)pool_worker_function, worker);
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_join_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, join)
+{
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    pool_obj_t *pool = pool_fetch_initialised(execute_data);
+
+    if (!pool) {
+        return;
+    }
+
+    if (pool->status == NOT_STARTED) {
+        zend_throw_error(NULL, "The pool has not been started");
+        return;
+    }
+
+    if (pool->status == JOINED) {
+        zend_throw_error(NULL, "The pool has already been joined");
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->status = JOINED;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->size; ++i) {
+        pthread_join(pool->workers[i].thread.thread, NULL);
+    }
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_size_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, size)
+{
+    pool_obj_t *pool = (pool_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    RETVAL_LONG(pool->size);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_task_count_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, taskCount)
+{
+    pool_obj_t *pool = (pool_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    RETVAL_LONG(pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_in_flight_count_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, inFlightCount)
+{
+    pool_obj_t *pool = (pool_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    RETVAL_LONG(pool->in_flight);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Pool_cache_stats_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Pool, cacheStats)
+{
+    pool_obj_t *pool = (pool_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    pht_task_cache_stats_t stats = {0};
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    for (int i = 0; i < pool->size; ++i) {
+        thread_obj_t *thread = &pool->workers[i].thread;
+
+        pthread_mutex_lock(&thread->lock);
+        stats.class_hits += thread->cache_stats.class_hits;
+        stats.class_misses += thread->cache_stats.class_misses;
+        stats.function_hits += thread->cache_stats.function_hits;
+        stats.function_misses += thread->cache_stats.function_misses;
+        pthread_mutex_unlock(&thread->lock);
+    }
+
+    task_cache_stats_to_array(return_value, &stats);
+}
+
+zend_function_entry Pool_methods[] = {
+    PHP_ME(Pool, __construct, Pool___construct_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, addClassTask, Pool_add_class_task_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, addFunctionTask, Pool_add_function_task_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, addFileTask, Pool_add_file_task_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, addClassTasks, Pool_add_class_tasks_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, addFunctionTasks, Pool_add_function_tasks_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, addFileTasks, Pool_add_file_tasks_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, setTaskPriority, Pool_set_task_priority_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, start, Pool_start_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, join, Pool_join_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, size, Pool_size_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, taskCount, Pool_task_count_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, inFlightCount, Pool_in_flight_count_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Pool, cacheStats, Pool_cache_stats_arginfo, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+
+void pool_ce_init(void)
+{
+    zend_class_entry ce;
+    zend_object_handlers *zh = zend_get_std_object_handlers();
+
+    INIT_CLASS_ENTRY(ce, "pht\\Pool", Pool_methods);
+    Pool_ce = zend_register_internal_class(&ce);
+    Pool_ce->create_object = pool_ctor;
+    Pool_ce->ce_flags |= ZEND_ACC_FINAL;
+    Pool_ce->serialize = zend_class_serialize_deny;
+    Pool_ce->unserialize = zend_class_unserialize_deny;
+
+    task_priority_constants_declare(Pool_ce);
+
+    memcpy(&pool_handlers, zh, sizeof(zend_object_handlers));
+
+    pool_handlers.offset = XtOffsetOf(pool_obj_t, obj);
+    pool_handlers.free_obj = pool_free_obj;
+}
@@ -0,0 +1,52 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_POOL_CLASS_H
+#define PHT_POOL_CLASS_H
+
+#include <main/php.h>
+#include <pthread.h>
+
+#include "src/classes/thread.h"
+
+struct _pool_obj_t;
+
+typedef struct _pool_worker_t {
+    thread_obj_t thread; // must be first member
+    struct _pool_obj_t *pool;
+} pool_worker_t;
+
+typedef struct _pool_obj_t {
+    pool_worker_t *workers; // each worker owns a task queue (guarded by its own lock)
+    int size;
+    int next_worker; // round-robin index of the worker to give the next task to
+    int task_priority; // the priority given to newly added tasks
+    pthread_mutex_t lock; // guards the following members
+    pthread_cond_t cond; // signalled when a task is added or the pool is joined
+    status_t status;
+    int queued; // tasks sitting in the worker queues
+    int in_flight; // tasks currently being executed
+    zend_object obj;
+} pool_obj_t;
+
+void pool_join_destroy(zval *zpool);
+void pool_ce_init(void);
+
+extern zend_class_entry *Pool_ce;
+
+#endif
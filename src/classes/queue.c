@@ -16,6 +16,7 @@
   +----------------------------------------------------------------------+
 */
 
+#include <errno.h>
 #include <Zend/zend_API.h>
 #include <Zend/zend_exceptions.h>
 #include <Zend/zend_interfaces.h>
@@ -23,6 +24,7 @@
 #include "php_pht.h"
 #include "src/pht_entry.h"
 #include "src/pht_debug.h"
+#include "src/pht_time.h"
 #include "src/classes/queue.h"
 
 extern zend_class_entry *Threaded_ce;
@@ -32,6 +34,8 @@ zend_class_entry *Queue_ce;
 
 void qoi_free(queue_obj_internal_t *qoi)
 {
+    pthread_cond_destroy(&qoi->not_full);
+    pthread_cond_destroy(&qoi->not_empty);
     pthread_mutex_destroy(&qoi->lock);
     pht_queue_destroy(&qoi->queue);
     free(qoi);
@@ -55,6 +59,8 @@ static zend_object *queue_ctor(zend_class_entry *entry)
         pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
         pthread_mutex_init(&qoi->lock, &attr);
         pthread_mutexattr_destroy(&attr);
+        pthread_cond_init(&qoi->not_empty, NULL);
+        pthread_cond_init(&qoi->not_full, NULL);
 
         pht_queue_init(&qoi->queue, pht_entry_delete);
         qoi->refcount = 1;
@@ -107,6 +113,125 @@ HashTable *qo_get_properties(zval *zobj)
     return obj->properties;
 }
 
+static int qoi_is_empty(queue_obj_internal_t *qoi)
+{
+    return !pht_queue_size(&qoi->queue);
+}
+
+static int qoi_is_full(queue_obj_internal_t *qoi)
+{
+    return qoi->capacity && pht_queue_size(&qoi->queue) >= qoi->capacity;
+}
+
+/*
+Wakes as many waiters on cond as there are elements (or spaces) for them to
+take, since any more would only find the queue blocked again. The queue's lock
+must be held.
+*/
+static void qoi_wake(pthread_cond_t *cond, uint32_t waiters, int count)
+{
+    if (!waiters || count <= 0) {
+        return;
+    }
+
+    if ((uint32_t) count >= waiters) {
+        pthread_cond_broadcast(cond);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        pthread_cond_signal(cond);
+    }
+}
+
+static void qoi_push(queue_obj_internal_t *qoi, pht_entry_t *entry)
+{
+    pht_queue_push(&qoi->queue, entry);
+    ++qoi->vn;
+
+    qoi_wake(&qoi->not_empty, qoi->pop_waiters, 1);
+}
+
+static pht_entry_t *qoi_pop(queue_obj_internal_t *qoi)
+{
+    pht_entry_t *entry = pht_queue_pop(&qoi->queue);
+
+    if (entry) {
+        ++qoi->vn;
+
+        qoi_wake(&qoi->not_full, qoi->push_waiters, 1);
+    }
+
+    return entry;
+}
+
+/*
+Waits on cond (with the queue's lock held) whilst blocked() holds, for at most
+timeout seconds if the timeout is non-negative. Returns 0 if it timed out.
+*/
+static int qoi_wait(queue_obj_internal_t *qoi, pthread_cond_t *cond, uint32_t *waiters, int (*blocked)(queue_obj_internal_t *), double timeout)
+{
+    struct timespec deadline;
+    int timed_out = 0;
+
+    if (timeout >= 0) {
+        pht_timespec_from_timeout(&deadline, timeout);
+    }
+
+    ++*waiters;
+
+    while (blocked(qoi)) {
+        if (timeout < 0) {
+            pthread_cond_wait(cond, &qoi->lock);
+        } else if (pthread_cond_timedwait(cond, &qoi->lock, &deadline) == ETIMEDOUT) {
+            // the condition may have been signalled as the wait timed out
+            timed_out = blocked(qoi);
+            break;
+        }
+    }
+
+    --*waiters;
+
+    return !timed_out;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Queue___construct_arginfo, 0, 0, 0)
+    ZEND_ARG_INFO(0, capacity)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Queue, __construct)
+{
+    queue_obj_t *qo = (queue_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    zend_long capacity = 0;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(capacity)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (capacity < 0) {
+        zend_throw_error(NULL, "Invalid capacity given - capacity must be a non-negative integer");
+        return;
+    }
+
+    // the queue may already be in use by other threads, and so is checked under its lock
+    if (pthread_mutex_lock(&qo->qoi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+        return;
+    }
+
+    if (qo->qoi->constructed) {
+        pthread_mutex_unlock(&qo->qoi->lock);
+        zend_throw_error(NULL, "The queue has already been constructed");
+        return;
+    }
+
+    qo->qoi->constructed = 1;
+    qo->qoi->capacity = capacity;
+
+    pthread_mutex_unlock(&qo->qoi->lock);
+}
+
 ZEND_BEGIN_ARG_INFO_EX(Queue_push_arginfo, 0, 0, 1)
     ZEND_ARG_INFO(0, entry)
 ZEND_END_ARG_INFO()
@@ -120,6 +245,11 @@ PHP_METHOD(Queue, push)
         Z_PARAM_ZVAL(value)
     ZEND_PARSE_PARAMETERS_END();
 
+    if (qoi_is_full(qo->qoi)) {
+        zend_throw_error(NULL, "Attempted to push an element onto a full queue");
+        return;
+    }
+
     pht_entry_t *entry = pht_create_entry_from_zval(value);
 
     if (!entry) {
@@ -127,8 +257,69 @@ PHP_METHOD(Queue, push)
         return;
     }
 
-    pht_queue_push(&qo->qoi->queue, entry);
+    qoi_push(qo->qoi, entry);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Queue_pushMany_arginfo, 0, 0, 1)
+    ZEND_ARG_ARRAY_INFO(0, values, 0)
+ZEND_END_ARG_INFO()
+
+/*
+Pushes all of the values (in order, ignoring the keys) with a single
+acquisition of the queue's lock, which is acquired internally. The values are
+converted before the lock is acquired, and are then spliced onto the queue in
+constant time. Either all of the values are pushed, or (if a bounded queue does
+not have the space for them all) none are.
+*/
+PHP_METHOD(Queue, pushMany)
+{
+    queue_obj_t *qo = (queue_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    pht_queue_t batch;
+    HashTable *ht;
+    zval *value;
+    int count;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ARRAY_HT(ht)
+    ZEND_PARSE_PARAMETERS_END();
+
+    pht_queue_init(&batch, pht_entry_delete);
+
+    ZEND_HASH_FOREACH_VAL(ht, value) {
+        ZVAL_DEREF(value);
+
+        pht_entry_t *entry = pht_create_entry_from_zval(value);
+
+        if (!entry) {
+            pht_queue_destroy(&batch);
+            zend_throw_error(NULL, "Failed to serialise the value");
+            return;
+        }
+
+        pht_queue_push(&batch, entry);
+    } ZEND_HASH_FOREACH_END();
+
+    if (pthread_mutex_lock(&qo->qoi->lock)) {
+        pht_queue_destroy(&batch);
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+        return;
+    }
+
+    count = pht_queue_size(&batch);
+
+    if (qo->qoi->capacity && pht_queue_size(&qo->qoi->queue) + (zend_long) count > qo->qoi->capacity) {
+        pthread_mutex_unlock(&qo->qoi->lock);
+        pht_queue_destroy(&batch);
+        zend_throw_error(NULL, "Attempted to push more elements than the queue has space for");
+        return;
+    }
+
+    pht_queue_splice(&qo->qoi->queue, &batch);
     ++qo->qoi->vn;
+
+    qoi_wake(&qo->qoi->not_empty, qo->qoi->pop_waiters, count);
+
+    pthread_mutex_unlock(&qo->qoi->lock);
 }
 
 ZEND_BEGIN_ARG_INFO_EX(Queue_pop_arginfo, 0, 0, 0)
@@ -142,7 +333,7 @@ PHP_METHOD(Queue, pop)
         return;
     }
 
-    pht_entry_t *entry = pht_queue_pop(&qo->qoi->queue);
+    pht_entry_t *entry = qoi_pop(qo->qoi);
 
     if (!entry) {
         zend_throw_error(NULL, "Attempted to pop an element from an empty queue");
@@ -151,7 +342,163 @@ PHP_METHOD(Queue, pop)
 
     pht_convert_entry_to_zval(return_value, entry);
     pht_entry_delete(entry);
-    ++qo->qoi->vn;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Queue_waitPop_arginfo, 0, 0, 0)
+    ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+/*
+Blocks until an element can be popped (or until the timeout, in seconds, has
+elapsed). The queue's lock is acquired internally, and so must not already be
+held by the calling thread.
+*/
+PHP_METHOD(Queue, waitPop)
+{
+    queue_obj_t *qo = (queue_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    double timeout = -1;
+    pht_entry_t *entry;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_DOUBLE(timeout)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (pthread_mutex_lock(&qo->qoi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+        return;
+    }
+
+    if (!qoi_wait(qo->qoi, &qo->qoi->not_empty, &qo->qoi->pop_waiters, qoi_is_empty, timeout)) {
+        pthread_mutex_unlock(&qo->qoi->lock);
+        zend_throw_error(NULL, "Timed out whilst waiting for an element to pop");
+        return;
+    }
+
+    entry = qoi_pop(qo->qoi);
+
+    pthread_mutex_unlock(&qo->qoi->lock);
+
+    pht_convert_entry_to_zval(return_value, entry);
+    pht_entry_delete(entry);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Queue_waitPush_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, value)
+    ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+/*
+Blocks until there is space to push the value (or until the timeout, in
+seconds, has elapsed), which is only ever necessary for bounded queues. The
+value is converted before the lock is acquired, so that the lock is not held
+for the duration of the conversion.
+*/
+PHP_METHOD(Queue, waitPush)
+{
+    queue_obj_t *qo = (queue_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    double timeout = -1;
+    pht_entry_t *entry;
+    zval *value;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_ZVAL(value)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_DOUBLE(timeout)
+    ZEND_PARSE_PARAMETERS_END();
+
+    entry = pht_create_entry_from_zval(value);
+
+    if (!entry) {
+        zend_throw_error(NULL, "Failed to serialise the value");
+        return;
+    }
+
+    if (pthread_mutex_lock(&qo->qoi->lock)) {
+        pht_entry_delete(entry);
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+        return;
+    }
+
+    if (!qoi_wait(qo->qoi, &qo->qoi->not_full, &qo->qoi->push_waiters, qoi_is_full, timeout)) {
+        pthread_mutex_unlock(&qo->qoi->lock);
+        pht_entry_delete(entry);
+        zend_throw_error(NULL, "Timed out whilst waiting for space to push");
+        return;
+    }
+
+    qoi_push(qo->qoi, entry);
+
+    pthread_mutex_unlock(&qo->qoi->lock);
+}
+
+/*
+Splits up to max elements (or all of them, if max is negative) off of the front
+of the queue with a single acquisition of its lock, and then converts them into
+the returned array outside of the lock.
+*/
+static void queue_pop_batch(queue_obj_t *qo, zend_long max, zval *return_value)
+{
+    pht_queue_t batch;
+
+    if (pthread_mutex_lock(&qo->qoi->lock)) {
+        zend_throw_error(NULL, "This mutex lock is already being held by this thread");
+        return;
+    }
+
+    pht_queue_init(&batch, pht_entry_delete);
+
+    if (max < 0) {
+        pht_queue_splice(&batch, &qo->qoi->queue);
+    } else {
+        pht_queue_split(&qo->qoi->queue, &batch, max > INT_MAX ? INT_MAX : (int) max);
+    }
+
+    if (pht_queue_size(&batch)) {
+        ++qo->qoi->vn;
+
+        qoi_wake(&qo->qoi->not_full, qo->qoi->push_waiters, pht_queue_size(&batch));
+    }
+
+    pthread_mutex_unlock(&qo->qoi->lock);
+
+    pht_queue_move_to_zend_array(return_value, &batch);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Queue_popMany_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, max)
+ZEND_END_ARG_INFO()
+
+// returns an empty array (rather than blocking) if the queue is empty
+PHP_METHOD(Queue, popMany)
+{
+    queue_obj_t *qo = (queue_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    zend_long max;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(max)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (max <= 0) {
+        zend_throw_error(NULL, "Invalid maximum given - the maximum must be a positive integer");
+        return;
+    }
+
+    queue_pop_batch(qo, max, return_value);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Queue_drain_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Queue, drain)
+{
+    queue_obj_t *qo = (queue_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    queue_pop_batch(qo, -1, return_value);
 }
 
 ZEND_BEGIN_ARG_INFO_EX(Queue_front_arginfo, 0, 0, 0)
@@ -190,6 +537,20 @@ PHP_METHOD(Queue, size)
     RETVAL_LONG(pht_queue_size(&qo->qoi->queue));
 }
 
+ZEND_BEGIN_ARG_INFO_EX(Queue_capacity_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Queue, capacity)
+{
+    queue_obj_t *qo = (queue_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    RETVAL_LONG(qo->qoi->capacity);
+}
+
 ZEND_BEGIN_ARG_INFO_EX(Queue_lock_arginfo, 0, 0, 0)
 ZEND_END_ARG_INFO()
 
@@ -223,10 +584,17 @@ PHP_METHOD(Queue, unlock)
 }
 
 zend_function_entry Queue_methods[] = {
+    PHP_ME(Queue, __construct, Queue___construct_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Queue, push, Queue_push_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Queue, waitPush, Queue_waitPush_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Queue, pushMany, Queue_pushMany_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Queue, pop, Queue_pop_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Queue, waitPop, Queue_waitPop_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Queue, popMany, Queue_popMany_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Queue, drain, Queue_drain_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Queue, front, Queue_front_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Queue, size, Queue_size_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Queue, capacity, Queue_capacity_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Queue, lock, Queue_lock_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Queue, unlock, Queue_unlock_arginfo, ZEND_ACC_PUBLIC)
     PHP_FE_END
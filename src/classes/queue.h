@@ -28,6 +28,12 @@
 typedef struct _queue_obj_internal_t {
     pht_queue_t queue;
     pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint32_t pop_waiters;
+    uint32_t push_waiters;
+    zend_long capacity; // 0 for an unbounded queue
+    zend_bool constructed;
     uint32_t refcount;
     zend_ulong vn;
 } queue_obj_internal_t;
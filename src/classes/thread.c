@@ -24,8 +24,10 @@
 #include <Zend/zend_compile.h>
 #include <Zend/zend_exceptions.h>
 #include <Zend/zend_interfaces.h>
+#include <ext/spl/spl_iterators.h>
 
 #include "php_pht.h"
+#include "src/pht_alloc.h"
 #include "src/pht_copy.h"
 #include "src/pht_debug.h"
 #include "src/classes/thread.h"
@@ -89,16 +91,338 @@ void task_delete(void *task_void)
             file_task_delete(&task->t.file);
     }
 
+    if (task->future) {
+        // a no-op if the task has already been executed
+        foi_reject_with_message(task->future, "The task was discarded before it could be executed");
+        foi_release(task->future);
+    }
+
     free(task);
 }
 
+static int task_args_create(pht_entry_t **entries, zval *args, int argc, const char *caller)
+{
+    if (!argc) {
+        *entries = NULL;
+        return 1;
+    }
+
+    *entries = malloc(sizeof(pht_entry_t) * argc);
+
+    for (int i = 0; i < argc; ++i) {
+        if (!pht_convert_zval_to_entry(*entries + i, args + i)) {
+            zend_throw_error(NULL, "Failed to serialise argument %d of %s()", i + 1, caller);
+
+            for (int i2 = 0; i2 < i; ++i2) {
+                pht_entry_delete_value(*entries + i2);
+            }
+
+            free(*entries);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+task_t *class_task_create(zend_class_entry *ce, zval *args, int argc, const char *caller)
+{
+    // By loading the class entry at the call site, we ensure that it exists
+    // before asynchronously creating the underlying Runnable object. We can
+    // simply discard the ce here and use only the ce name now
+
+    task_t *task = malloc(sizeof(task_t));
+
+    task->type = CLASS_TASK;
+    task->future = NULL;
+    task->t.class.ctor_argc = argc;
+
+    if (!task_args_create(&task->t.class.ctor_args, args, argc, caller)) {
+        free(task);
+        return NULL;
+    }
+
+    pht_str_update(&task->t.class.name, ZSTR_VAL(ce->name), ZSTR_LEN(ce->name));
+
+    return task;
+}
+
+task_t *function_task_create(zval *zcallable, zval *args, int argc, const char *caller)
+{
+    if (!zend_is_callable(zcallable, 0, NULL)) {
+        zend_throw_error(NULL, "Invalid callable array given");
+        return NULL;
+    }
+
+    task_t *task = malloc(sizeof(task_t));
+
+    task->type = FUNCTION_TASK;
+    task->future = NULL;
+    task->t.function.argc = argc;
+
+    if (!task_args_create(&task->t.function.args, args, argc, caller)) {
+        free(task);
+        return NULL;
+    }
+
+    while (Z_ISREF_P(zcallable)) {
+        zcallable = Z_REFVAL_P(zcallable);
+    }
+
+    if (Z_TYPE_P(zcallable) != IS_ARRAY) {
+        pht_convert_zval_to_entry(&task->t.function.fn, zcallable);
+    } else {
+        zval *obj = zend_hash_index_find(Z_ARR_P(zcallable), 0);
+
+        ZVAL_DEREF(obj);
+
+        if (Z_TYPE_P(obj) == IS_STRING) {
+            pht_convert_zval_to_entry(&task->t.function.fn, zcallable);
+        } else {
+            zval new_array, ce_name, *method = zend_hash_index_find(Z_ARR_P(zcallable), 1);
+
+            ZVAL_DEREF(method);
+            ZVAL_NEW_ARR(&new_array);
+            zend_hash_init(Z_ARR(new_array), 2, NULL, ZVAL_PTR_DTOR, 0);
+            ZVAL_STR(&ce_name, Z_OBJCE_P(obj)->name);
+
+            zend_hash_next_index_insert_new(Z_ARR(new_array), &ce_name);
+            zend_hash_next_index_insert_new(Z_ARR(new_array), method);
+
+            pht_convert_zval_to_entry(&task->t.function.fn, &new_array);
+            zval_dtor(&new_array);
+        }
+    }
+
+    return task;
+}
+
+task_t *file_task_create(zend_string *filename, zval *args, int argc, const char *caller)
+{
+    zend_string *resolved_path = zend_resolve_path(ZSTR_VAL(filename), ZSTR_LEN(filename));
+    task_t *task = malloc(sizeof(task_t));
+
+    task->type = FILE_TASK;
+    task->future = NULL;
+
+    if (resolved_path) {
+        pht_str_update(&task->t.file.name, ZSTR_VAL(resolved_path), ZSTR_LEN(resolved_path));
+        zend_string_release(resolved_path);
+    } else {
+        pht_str_update(&task->t.file.name, ZSTR_VAL(filename), ZSTR_LEN(filename));
+    }
+
+    if (VCWD_ACCESS(PHT_STRV(task->t.file.name), F_OK) != 0) {
+        zend_throw_error(NULL, "The file '%s' does not exist", PHT_STRV(task->t.file.name));
+        pht_str_free(&task->t.file.name);
+        free(task);
+        return NULL;
+    }
+
+    if (VCWD_ACCESS(PHT_STRV(task->t.file.name), R_OK) != 0) {
+        zend_throw_error(NULL, "The file '%s' is not readable", PHT_STRV(task->t.file.name));
+        pht_str_free(&task->t.file.name);
+        free(task);
+        return NULL;
+    }
+
+    task->t.file.argc = argc;
+
+    if (!task_args_create(&task->t.file.args, args, argc, caller)) {
+        pht_str_free(&task->t.file.name);
+        free(task);
+        return NULL;
+    }
+
+    return task;
+}
+
+void task_attach_future(task_t *task, zval *zfuture)
+{
+    task->future = foi_create();
+
+    future_object_create(zfuture, task->future);
+}
+
+static task_t *task_create_from_template(task_t *template, zval *args, int argc, const char *caller)
+{
+    task_t *task = malloc(sizeof(task_t));
+    pht_entry_t *entries;
+
+    if (!task_args_create(&entries, args, argc, caller)) {
+        free(task);
+        return NULL;
+    }
+
+    task->type = template->type;
+    task->future = NULL;
+
+    // the template has already been validated, so only its entries need copying
+    switch (task->type) {
+        case CLASS_TASK:
+            pht_str_update(&task->t.class.name, PHT_STRV(template->t.class.name), PHT_STRL(template->t.class.name));
+            task->t.class.ctor_argc = argc;
+            task->t.class.ctor_args = entries;
+            break;
+        case FUNCTION_TASK:
+            pht_entry_clone(&task->t.function.fn, &template->t.function.fn);
+            task->t.function.argc = argc;
+            task->t.function.args = entries;
+            break;
+        case FILE_TASK:
+            pht_str_update(&task->t.file.name, PHT_STRV(template->t.file.name), PHT_STRL(template->t.file.name));
+            task->t.file.argc = argc;
+            task->t.file.args = entries;
+    }
+
+    return task;
+}
+
+typedef struct _task_batch_t {
+    pht_queue_t *tasks;
+    task_t *template;
+    zval *futures; // NULL if the futures have not been requested
+    const char *caller;
+} task_batch_t;
+
+static int task_batch_add(task_batch_t *batch, zval *arg_set)
+{
+    zval *args = NULL, *arg;
+    int argc = 0;
+    task_t *task;
+
+    ZVAL_DEREF(arg_set);
+
+    if (Z_TYPE_P(arg_set) != IS_ARRAY) {
+        zend_throw_error(NULL, "Argument set %d given to %s() must be an array", pht_queue_size(batch->tasks) + 1, batch->caller);
+        return 0;
+    }
+
+    if (zend_hash_num_elements(Z_ARRVAL_P(arg_set))) {
+        args = emalloc(sizeof(zval) * zend_hash_num_elements(Z_ARRVAL_P(arg_set)));
+
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(arg_set), arg) {
+            ZVAL_DEREF(arg);
+            ZVAL_COPY_VALUE(args + argc++, arg);
+        } ZEND_HASH_FOREACH_END();
+    }
+
+    task = task_create_from_template(batch->template, args, argc, batch->caller);
+
+    if (args) {
+        efree(args);
+    }
+
+    if (!task) {
+        return 0;
+    }
+
+    if (batch->futures) {
+        zval zfuture;
+
+        task_attach_future(task, &zfuture);
+        add_next_index_zval(batch->futures, &zfuture);
+    }
+
+    pht_queue_push(batch->tasks, task);
+
+    return 1;
+}
+
+static int task_batch_add_from_iterator(zend_object_iterator *iter, void *puser)
+{
+    zval *arg_set = iter->funcs->get_current_data(iter);
+
+    if (!arg_set || !task_batch_add(puser, arg_set)) {
+        return ZEND_HASH_APPLY_STOP;
+    }
+
+    return ZEND_HASH_APPLY_KEEP;
+}
+
+/*
+Builds a queue of tasks from the given template (which this function takes
+ownership of) and set of arguments, without touching any thread's lock. The
+resulting batch can then be spliced into a task queue in one go. If futures is
+given, it is populated with an array of the tasks' futures.
+*/
+int task_batch_create(pht_queue_t *batch, task_t *template, zval *arg_sets, zval *futures, const char *caller)
+{
+    task_batch_t state;
+    zval *arg_set;
+
+    pht_queue_init(batch, task_delete);
+
+    state.tasks = batch;
+    state.template = template;
+    state.futures = futures;
+    state.caller = caller;
+
+    if (futures) {
+        array_init(futures);
+    }
+
+    ZVAL_DEREF(arg_sets);
+
+    if (Z_TYPE_P(arg_sets) == IS_ARRAY) {
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(arg_sets), arg_set) {
+            if (!task_batch_add(&state, arg_set)) {
+                break;
+            }
+        } ZEND_HASH_FOREACH_END();
+    } else if (Z_TYPE_P(arg_sets) == IS_OBJECT && instanceof_function(Z_OBJCE_P(arg_sets), zend_ce_traversable)) {
+        spl_iterator_apply(arg_sets, task_batch_add_from_iterator, &state);
+    } else {
+        zend_throw_error(NULL, "The argument sets given to %s() must be iterable", caller);
+    }
+
+    task_delete(template);
+
+    if (EG(exception)) {
+        pht_queue_destroy(batch);
+
+        if (futures) {
+            zval_ptr_dtor(futures);
+            ZVAL_NULL(futures);
+        }
+
+        return 0;
+    }
+
+    return 1;
+}
+
+int task_priority_valid(zend_long priority)
+{
+    if (priority < PHT_PRIORITY_LOW || priority > PHT_PRIORITY_HIGH) {
+        zend_throw_error(NULL, "Invalid task priority given - it must be one of the PRIORITY_* constants");
+        return 0;
+    }
+
+    return 1;
+}
+
+void task_priority_constants_declare(zend_class_entry *ce)
+{
+    zend_declare_class_constant_long(ce, ZEND_STRL("PRIORITY_LOW"), PHT_PRIORITY_LOW);
+    zend_declare_class_constant_long(ce, ZEND_STRL("PRIORITY_NORMAL"), PHT_PRIORITY_NORMAL);
+    zend_declare_class_constant_long(ce, ZEND_STRL("PRIORITY_HIGH"), PHT_PRIORITY_HIGH);
+}
+
 void thread_init(thread_obj_t *thread)
 {
     thread->status = NOT_STARTED;
     thread->parent_thread_ls = TSRMLS_CACHE;
+    thread->spin_count = 0;
+    thread->spin_estimate = 0;
+    thread->snapshot = NULL;
+    memset(&thread->cache_stats, 0, sizeof(pht_task_cache_stats_t));
+
+    thread->task_priority = PHT_PRIORITY_NORMAL;
 
-    pht_queue_init(&thread->tasks, task_delete);
+    pht_priority_queue_init(&thread->tasks, task_delete);
     pthread_mutex_init(&thread->lock, NULL);
+    pthread_cond_init(&thread->cond, NULL);
 }
 
 void th_free_obj(zend_object *obj)
@@ -125,10 +449,12 @@ void thread_join_destroy(zval *zthread)
 
     pthread_mutex_lock(&thread->lock);
     thread->status = JOINED;
+    pthread_cond_broadcast(&thread->cond);
     pthread_mutex_unlock(&thread->lock);
 
     pthread_join(thread->thread, NULL);
 
+    pthread_cond_destroy(&thread->cond);
     pthread_mutex_destroy(&thread->lock);
 
     // technically, thread should leak here without an efree, but because this
@@ -136,19 +462,92 @@ void thread_join_destroy(zval *zthread)
     // here. This only occurs for when threads are not explicitly join()'ed
 }
 
-void handle_class_task(class_task_t *class_task)
+/*
+Each worker caches the class entries (along with their run methods) of the
+class tasks it executes, and the resolved callables of the function tasks it
+executes. Class entries and functions live until the end of the thread's
+request, so the cached pointers cannot be invalidated.
+*/
+typedef struct _class_task_cache_entry_t {
+    zend_class_entry *ce;
+    zend_function *run;
+} class_task_cache_entry_t;
+
+void task_cache_entry_free(zval *zv)
 {
+    efree(Z_PTR_P(zv));
+}
+
+/*
+Called with the lock guarding stats held, so that the owning thread can read
+this worker's counters without having to synchronise on every task.
+*/
+void task_cache_stats_publish(pht_task_cache_stats_t *stats)
+{
+    *stats = PHT_ZG(task_cache_stats);
+}
+
+void task_cache_stats_to_array(zval *zstats, pht_task_cache_stats_t *stats)
+{
+    zval classes, functions;
+
+    array_init(&classes);
+    add_assoc_long(&classes, "hits", stats->class_hits);
+    add_assoc_long(&classes, "misses", stats->class_misses);
+
+    array_init(&functions);
+    add_assoc_long(&functions, "hits", stats->function_hits);
+    add_assoc_long(&functions, "misses", stats->function_misses);
+
+    array_init(zstats);
+    add_assoc_zval(zstats, "classes", &classes);
+    add_assoc_zval(zstats, "functions", &functions);
+}
+
+static class_task_cache_entry_t *class_task_cache_fetch(class_task_t *class_task)
+{
+    class_task_cache_entry_t *ctce = zend_hash_str_find_ptr(&PHT_ZG(class_task_cache), PHT_STRV(class_task->name), PHT_STRL(class_task->name));
+
+    if (EXPECTED(ctce)) {
+        ++PHT_ZG(task_cache_stats).class_hits;
+        return ctce;
+    }
+
+    ++PHT_ZG(task_cache_stats).class_misses;
+
     zend_string *ce_name = zend_string_init(PHT_STRV(class_task->name), PHT_STRL(class_task->name), 0);
     zend_class_entry *ce = zend_fetch_class_by_name(ce_name, NULL, ZEND_FETCH_CLASS_DEFAULT | ZEND_FETCH_CLASS_EXCEPTION);
+
+    if (!ce) {
+        zend_string_free(ce_name);
+        return NULL;
+    }
+
+    ctce = emalloc(sizeof(class_task_cache_entry_t));
+    ctce->ce = ce;
+    ctce->run = zend_hash_find_ptr(&ce->function_table, common_strings.run);
+
+    zend_hash_add_new_ptr(&PHT_ZG(class_task_cache), ce_name, ctce);
+    zend_string_release(ce_name);
+
+    return ctce;
+}
+
+void handle_class_task(class_task_t *class_task, zval *task_retval)
+{
+    class_task_cache_entry_t *ctce = class_task_cache_fetch(class_task);
     zend_function *constructor;
     zval zobj;
 
-    if (object_init_ex(&zobj, ce) != SUCCESS) {
+    if (!ctce) {
+        return;
+    }
+
+    if (object_init_ex(&zobj, ctce->ce) != SUCCESS) {
         // @todo this will throw an exception in the new thread, rather than at
         // the call site. This doesn't even have an execution context - how
         // should it behave?
-        zend_throw_exception_ex(zend_ce_exception, 0, "Failed to create Runnable object from class '%s'\n", ZSTR_VAL(ce_name));
-        zend_string_free(ce_name);
+        zend_throw_exception_ex(zend_ce_exception, 0, "Failed to create Runnable object from class '%s'\n", ZSTR_VAL(ctce->ce->name));
         return;
     }
 
@@ -158,6 +557,7 @@ void handle_class_task(class_task_t *class_task)
         int result;
         zval retval, *zargs = emalloc(sizeof(zval) * class_task->ctor_argc); // VLAs not supported by VC15
         zend_fcall_info fci;
+        zend_fcall_info_cache fcc;
 
         fci.size = sizeof(fci);
         fci.object = Z_OBJ(zobj);
@@ -165,14 +565,21 @@ void handle_class_task(class_task_t *class_task)
         fci.param_count = class_task->ctor_argc;
         fci.params = zargs;
         fci.no_separation = 1;
-        // @todo doesn't have to be __construct (could be class name instead)
-        ZVAL_INTERNED_STR(&fci.function_name, common_strings.__construct);
+        ZVAL_UNDEF(&fci.function_name);
+
+#if PHP_VERSION_ID < 70300
+        fcc.initialized = 1;
+#endif
+        fcc.function_handler = constructor;
+        fcc.calling_scope = ctce->ce;
+        fcc.called_scope = ctce->ce;
+        fcc.object = Z_OBJ(zobj);
 
         for (int i = 0; i < class_task->ctor_argc; ++i) {
             pht_convert_entry_to_zval(zargs + i, class_task->ctor_args + i);
         }
 
-        result = zend_call_function(&fci, NULL);
+        result = zend_call_function(&fci, &fcc);
 
         for (int i = 0; i < class_task->ctor_argc; ++i) {
             zval_dtor(zargs + i);
@@ -180,20 +587,28 @@ void handle_class_task(class_task_t *class_task)
 
         efree(zargs);
 
-        // dtor retval too?
+        if (result == SUCCESS) {
+            zval_ptr_dtor(&retval);
+        }
 
         if (result == FAILURE) {
             if (!EG(exception)) {
                 // @todo same exception throwing problem and constructor name as above?
-                zend_error_noreturn(E_CORE_ERROR, "Couldn't execute method %s%s%s", ZSTR_VAL(ce_name), "::", "__construct");
+                zend_error_noreturn(E_CORE_ERROR, "Couldn't execute method %s%s%s", ZSTR_VAL(ctce->ce->name), "::", "__construct");
                 goto finish;
             }
         }
+
+        if (EG(exception)) {
+            // only reachable when the exception is to be handed to a future
+            goto finish;
+        }
     }
 
     int result;
     zval retval;
     zend_fcall_info fci;
+    zend_fcall_info_cache fcc;
 
     fci.size = sizeof(fci);
     fci.object = Z_OBJ(zobj);
@@ -203,26 +618,101 @@ void handle_class_task(class_task_t *class_task)
     fci.no_separation = 1;
     ZVAL_INTERNED_STR(&fci.function_name, common_strings.run);
 
-    result = zend_call_function(&fci, NULL);
+    if (EXPECTED(ctce->run)) {
+#if PHP_VERSION_ID < 70300
+        fcc.initialized = 1;
+#endif
+        fcc.function_handler = ctce->run;
+        fcc.calling_scope = ctce->ce;
+        fcc.called_scope = ctce->ce;
+        fcc.object = Z_OBJ(zobj);
+
+        result = zend_call_function(&fci, &fcc);
+    } else {
+        result = zend_call_function(&fci, NULL);
+    }
 
     if (result == FAILURE) {
         if (!EG(exception)) {
             // same as problem above?
-            zend_error_noreturn(E_CORE_ERROR, "Couldn't execute method %s%s%s", ZSTR_VAL(ce_name), "::", "run");
+            zend_error_noreturn(E_CORE_ERROR, "Couldn't execute method %s%s%s", ZSTR_VAL(ctce->ce->name), "::", "run");
         }
+    } else if (task_retval) {
+        ZVAL_COPY_VALUE(task_retval, &retval);
+    } else {
+        zval_ptr_dtor(&retval);
     }
 
 finish:
-    zend_string_free(ce_name);
     zval_ptr_dtor(&zobj);
 }
 
-void handle_function_task(function_task_t *function_task)
+/*
+Only callables given by name (as a function name or as a pair of class and
+method names) are cached. Trampolines (such as for __callStatic()) are
+temporary, and so they are never cached.
+*/
+static int function_task_cache_fetch(zval *fn, zend_fcall_info_cache *fcc)
+{
+    zend_string *key;
+    zend_fcall_info_cache *cached;
+
+    if (Z_TYPE_P(fn) == IS_STRING) {
+        key = zend_string_copy(Z_STR_P(fn));
+    } else if (Z_TYPE_P(fn) == IS_ARRAY && zend_hash_num_elements(Z_ARRVAL_P(fn)) == 2) {
+        zval *class_name = zend_hash_index_find(Z_ARRVAL_P(fn), 0);
+        zval *method_name = zend_hash_index_find(Z_ARRVAL_P(fn), 1);
+
+        if (!class_name || !method_name || Z_TYPE_P(class_name) != IS_STRING || Z_TYPE_P(method_name) != IS_STRING) {
+            return 0;
+        }
+
+        key = strpprintf(0, "%s::%s", Z_STRVAL_P(class_name), Z_STRVAL_P(method_name));
+    } else {
+        return 0;
+    }
+
+    if (EXPECTED((cached = zend_hash_find_ptr(&PHT_ZG(function_task_cache), key)) != NULL)) {
+        ++PHT_ZG(task_cache_stats).function_hits;
+        *fcc = *cached;
+        zend_string_release(key);
+        return 1;
+    }
+
+    ++PHT_ZG(task_cache_stats).function_misses;
+
+    if (!zend_is_callable_ex(fn, NULL, 0, NULL, fcc, NULL)
+        || fcc->object
+        || (fcc->function_handler->common.fn_flags & ZEND_ACC_CALL_VIA_TRAMPOLINE)) {
+        if (fcc->function_handler && (fcc->function_handler->common.fn_flags & ZEND_ACC_CALL_VIA_TRAMPOLINE)) {
+            zend_string_release(fcc->function_handler->common.function_name);
+            zend_free_trampoline(fcc->function_handler);
+        }
+
+        zend_string_release(key);
+        return 0;
+    }
+
+    cached = emalloc(sizeof(zend_fcall_info_cache));
+    *cached = *fcc;
+
+    zend_hash_add_new_ptr(&PHT_ZG(function_task_cache), key, cached);
+    zend_string_release(key);
+
+    return 1;
+}
+
+void handle_function_task(function_task_t *function_task, zval *task_retval)
 {
     zval fn, retval, *params = NULL;
 
     pht_convert_entry_to_zval(&fn, &function_task->fn);
 
+    if (Z_TYPE(fn) == IS_STRING) {
+        // function names given as strings bypass the lazy import hooks
+        pht_lazy_import_function(Z_STR(fn));
+    }
+
     if (function_task->argc) {
         params = emalloc(sizeof(zval) * function_task->argc);
 
@@ -231,15 +721,51 @@ void handle_function_task(function_task_t *function_task)
         }
     }
 
-    switch (Z_TYPE(fn)) {
+    zend_fcall_info_cache fcc;
+
+    if (function_task_cache_fetch(&fn, &fcc)) {
+        zend_fcall_info fci;
+
+        fci.size = sizeof(fci);
+        ZVAL_COPY_VALUE(&fci.function_name, &fn);
+        fci.object = NULL;
+        fci.retval = &retval;
+        fci.param_count = function_task->argc;
+        fci.params = params;
+        fci.no_separation = 1;
+
+        if (zend_call_function(&fci, &fcc) == SUCCESS) {
+            if (task_retval) {
+                ZVAL_COPY_VALUE(task_retval, &retval);
+            } else {
+                zval_ptr_dtor(&retval);
+            }
+        }
+    } else switch (Z_TYPE(fn)) {
         case IS_STRING:
         case IS_ARRAY:
         case IS_OBJECT:
-            call_user_function(CG(function_table), NULL, &fn, &retval, function_task->argc, params);
+            if (call_user_function(CG(function_table), NULL, &fn, &retval, function_task->argc, params) == SUCCESS) {
+                if (task_retval) {
+                    ZVAL_COPY_VALUE(task_retval, &retval);
+                } else {
+                    zval_ptr_dtor(&retval);
+                }
+            }
             break;
         default:
             ZEND_ASSERT(0);
     }
+
+    for (int i = 0; i < function_task->argc; ++i) {
+        zval_ptr_dtor(params + i);
+    }
+
+    if (params) {
+        efree(params);
+    }
+
+    zval_ptr_dtor(&fn);
 }
 
 void handle_file_task(file_task_t *file_task)
@@ -272,34 +798,128 @@ void handle_file_task(file_task_t *file_task)
     php_execute_script(&zfd);
 }
 
-void handle_thread_tasks(thread_obj_t *thread)
+static void thread_cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__ ("pause" ::: "memory");
+#elif defined(ZEND_WIN32)
+    YieldProcessor();
+#endif
+}
+
+/*
+ * Spin for a bounded period whilst waiting for a task to arrive, before falling
+ * back to parking the thread on its condition variable. The spin bound adapts:
+ * it doubles (up to spin_count) when work turns up whilst spinning, and halves
+ * when spinning was fruitless.
+ */
+static void thread_spin_for_task(thread_obj_t *thread)
 {
-    // @todo mutex lock?
-    while (thread->status != JOINED || thread->tasks.size) {
-        pthread_mutex_lock(&thread->lock);
-        task_t *task = pht_queue_pop(&thread->tasks);
-        pthread_mutex_unlock(&thread->lock);
+    zend_long limit = MAX(thread->spin_estimate, 1);
 
-        if (!task) {
-            continue;
+    for (zend_long i = 0; i < limit; ++i) {
+        if (*(volatile int *)&thread->tasks.size || *(volatile status_t *)&thread->status == JOINED) {
+            thread->spin_estimate = MIN(limit << 1, thread->spin_count);
+            return;
         }
 
-        switch (task->type) {
-            case CLASS_TASK:
-                handle_class_task(&task->t.class);
-                break;
-            case FUNCTION_TASK:
-                handle_function_task(&task->t.function);
-                break;
-            case FILE_TASK:
-                handle_file_task(&task->t.file);
+        thread_cpu_relax();
+    }
+
+    thread->spin_estimate = limit >> 1;
+}
+
+void thread_add_task(thread_obj_t *thread, task_t *task)
+{
+    pthread_mutex_lock(&thread->lock);
+    pht_priority_queue_push(&thread->tasks, task, thread->task_priority);
+    pthread_cond_signal(&thread->cond);
+    pthread_mutex_unlock(&thread->lock);
+}
+
+void thread_add_tasks(thread_obj_t *thread, pht_queue_t *batch)
+{
+    pthread_mutex_lock(&thread->lock);
+    pht_priority_queue_splice(&thread->tasks, batch, thread->task_priority);
+    pthread_cond_signal(&thread->cond);
+    pthread_mutex_unlock(&thread->lock);
+}
+
+static task_t *thread_next_task(thread_obj_t *thread)
+{
+    task_t *task;
+
+    if (thread->spin_count && !*(volatile int *)&thread->tasks.size) {
+        thread_spin_for_task(thread);
+    }
+
+    pthread_mutex_lock(&thread->lock);
+
+    while (!pht_priority_queue_size(&thread->tasks) && thread->status != JOINED) {
+        pthread_cond_wait(&thread->cond, &thread->lock);
+    }
+
+    task = pht_priority_queue_pop(&thread->tasks);
+    task_cache_stats_publish(&thread->cache_stats);
+
+    pthread_mutex_unlock(&thread->lock);
+
+    return task;
+}
+
+void handle_task(task_t *task)
+{
+    zend_execute_data dummy_execute_data, *prev_execute_data = EG(current_execute_data);
+    zval retval;
+
+    ZVAL_UNDEF(&retval);
+
+    if (task->future) {
+        // Without a calling frame, zend_call_function() turns an uncaught
+        // exception into a fatal error. A dummy frame leaves it in
+        // EG(exception) instead, so that it can be handed to the future
+        memset(&dummy_execute_data, 0, sizeof(zend_execute_data));
+        dummy_execute_data.prev_execute_data = prev_execute_data;
+        EG(current_execute_data) = &dummy_execute_data;
+    }
+
+    switch (task->type) {
+        case CLASS_TASK:
+            handle_class_task(&task->t.class, task->future ? &retval : NULL);
+            break;
+        case FUNCTION_TASK:
+            handle_function_task(&task->t.function, task->future ? &retval : NULL);
+            break;
+        case FILE_TASK:
+            handle_file_task(&task->t.file);
+    }
+
+    if (task->future) {
+        EG(current_execute_data) = prev_execute_data;
+
+        if (EG(exception)) {
+            foi_reject(task->future, EG(exception));
+            zend_clear_exception();
+        } else {
+            foi_resolve(task->future, &retval);
         }
 
+        zval_ptr_dtor(&retval);
+    }
+}
+
+void handle_thread_tasks(thread_obj_t *thread)
+{
+    task_t *task;
+
+    // a NULL task means that the thread has been joined and its queue drained
+    while ((task = thread_next_task(thread))) {
+        handle_task(task);
         task_delete(task);
     }
 }
 
-void *worker_function(thread_obj_t *thread)
+void thread_context_startup(thread_obj_t *thread)
 {
     thread->ls = ts_resource(0);
 
@@ -314,23 +934,37 @@ void *worker_function(thread_obj_t *thread)
 
     php_request_startup();
 
-    copy_execution_context();
+    copy_execution_context(thread->snapshot);
+    pht_snapshot_release(thread->snapshot);
+    thread->snapshot = NULL;
 
     pthread_mutex_lock(&thread->lock);
     if (thread->status == STARTING_UP) { // it could also be JOINED
         thread->status = STARTED;
     }
     pthread_mutex_unlock(&thread->lock);
+}
 
-    handle_thread_tasks(thread);
-    // @todo clean up all undone tasks
-
+void thread_context_shutdown(void)
+{
     PG(report_memleaks) = 0;
 
     php_request_shutdown(NULL);
 
     ts_free_thread();
 
+    pht_alloc_thread_shutdown();
+}
+
+void *worker_function(thread_obj_t *thread)
+{
+    thread_context_startup(thread);
+
+    handle_thread_tasks(thread);
+    // @todo clean up all undone tasks
+
+    thread_context_shutdown();
+
     pthread_exit(NULL);
 }
 
@@ -350,6 +984,29 @@ static zend_object *thread_ctor(zend_class_entry *entry)
     return &thread->obj;
 }
 
+ZEND_BEGIN_ARG_INFO_EX(Thread___construct_arginfo, 0, 0, 0)
+    ZEND_ARG_INFO(0, spin_count)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Thread, __construct)
+{
+    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    zend_long spin_count = 0;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(spin_count)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (spin_count < 0) {
+        zend_throw_error(NULL, "Invalid spin count given - it must be a non-negative integer");
+        return;
+    }
+
+    thread->spin_count = spin_count;
+    thread->spin_estimate = spin_count;
+}
+
 ZEND_BEGIN_ARG_INFO_EX(Thread_add_class_task_arginfo, 0, 0, 1)
     ZEND_ARG_INFO(0, class_name)
 ZEND_END_ARG_INFO()
@@ -365,39 +1022,18 @@ PHP_METHOD(Thread, addClassTask)
         Z_PARAM_VARIADIC('*', args, argc)
     ZEND_PARSE_PARAMETERS_END();
 
-    // By loading the class entry here, we ensure that it exists before
-    // asynchronously creating the underlying Runnable object. We can simply
-    // discard the ce here and use only the ce name now
-
     thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
-    task_t *task = malloc(sizeof(task_t));
-
-    task->type = CLASS_TASK;
-    pht_str_update(&task->t.class.name, ZSTR_VAL(ce->name), ZSTR_LEN(ce->name));
-    task->t.class.ctor_argc = argc;
-
-    if (argc) {
-        task->t.class.ctor_args = malloc(sizeof(pht_entry_t) * argc);
-
-        for (int i = 0; i < argc; ++i) {
-            if (!pht_convert_zval_to_entry(task->t.class.ctor_args + i, args + i)) {
-                zend_throw_error(NULL, "Failed to serialise argument %d of Thread::addClassTask()", i + 1);
+    task_t *task = class_task_create(ce, args, argc, "Thread::addClassTask");
 
-                for (int i2 = 0; i2 < i; ++i2) {
-                    pht_entry_delete_value(task->t.class.ctor_args + i2);
-                }
+    if (!task) {
+        return;
+    }
 
-                free(task->t.class.ctor_args);
-                return;
-            }
-        }
-    } else {
-        task->t.class.ctor_args = NULL;
+    if (USED_RET()) {
+        task_attach_future(task, return_value);
     }
 
-    pthread_mutex_lock(&thread->lock);
-    pht_queue_push(&thread->tasks, task);
-    pthread_mutex_unlock(&thread->lock);
+    thread_add_task(thread, task);
 }
 
 ZEND_BEGIN_ARG_INFO_EX(Thread_add_function_task_arginfo, 0, 0, 1)
@@ -414,138 +1050,153 @@ PHP_METHOD(Thread, addFunctionTask)
         Z_PARAM_VARIADIC('*', args, argc)
     ZEND_PARSE_PARAMETERS_END();
 
-    if (!zend_is_callable(zcallable, 0, NULL)) {
-        zend_throw_error(NULL, "Invalid callable array given");
+    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    task_t *task = function_task_create(zcallable, args, argc, "Thread::addFunctionTask");
+
+    if (!task) {
         return;
     }
 
-    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
-    task_t *task = malloc(sizeof(task_t));
-
-    while (Z_ISREF_P(zcallable)) {
-        zcallable = Z_REFVAL_P(zcallable);
+    if (USED_RET()) {
+        task_attach_future(task, return_value);
     }
 
-    if (Z_TYPE_P(zcallable) != IS_ARRAY) {
-        pht_convert_zval_to_entry(&task->t.function.fn, zcallable);
-    } else {
-        zval *obj = zend_hash_index_find(Z_ARR_P(zcallable), 0);
+    thread_add_task(thread, task);
+}
 
-        ZVAL_DEREF(obj);
+ZEND_BEGIN_ARG_INFO_EX(Thread_add_file_task_arginfo, 0, 0, 1)
+ZEND_ARG_INFO(0, filename)
+ZEND_END_ARG_INFO()
 
-        if (Z_TYPE_P(obj) == IS_STRING) {
-            pht_convert_zval_to_entry(&task->t.function.fn, zcallable);
-        } else {
-            zval new_array, ce_name, *method = zend_hash_index_find(Z_ARR_P(zcallable), 1);
+PHP_METHOD(Thread, addFileTask)
+{
+    zend_string *filename;
+    zval *args;
+    int argc = 0;
 
-            ZVAL_DEREF(method);
-            ZVAL_NEW_ARR(&new_array);
-            zend_hash_init(Z_ARR(new_array), 2, NULL, ZVAL_PTR_DTOR, 0);
-            ZVAL_STR(&ce_name, Z_OBJCE_P(obj)->name);
+    ZEND_PARSE_PARAMETERS_START(1, -1)
+        Z_PARAM_PATH_STR(filename)
+        Z_PARAM_VARIADIC('*', args, argc)
+    ZEND_PARSE_PARAMETERS_END();
 
-            zend_hash_next_index_insert_new(Z_ARR(new_array), &ce_name);
-            zend_hash_next_index_insert_new(Z_ARR(new_array), method);
+    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    task_t *task = file_task_create(filename, args, argc, "Thread::addFileTask");
 
-            pht_convert_zval_to_entry(&task->t.function.fn, &new_array);
-            zval_dtor(&new_array);
-        }
+    if (!task) {
+        return;
     }
 
-    task->type = FUNCTION_TASK;
-    task->t.function.argc = argc;
+    thread_add_task(thread, task);
+}
 
-    if (argc) {
-        task->t.function.args = malloc(sizeof(pht_entry_t) * argc);
+ZEND_BEGIN_ARG_INFO_EX(Thread_add_class_tasks_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, class_name)
+    ZEND_ARG_INFO(0, ctor_arg_sets)
+ZEND_END_ARG_INFO()
 
-        for (int i = 0; i < argc; ++i) {
-            if (!pht_convert_zval_to_entry(task->t.function.args + i, args + i)) {
-                zend_throw_error(NULL, "Failed to serialise argument %d of Thread::addClassTask()", i + 1);
+PHP_METHOD(Thread, addClassTasks)
+{
+    zend_class_entry *ce = Runnable_ce;
+    zval *arg_sets;
+    pht_queue_t batch;
 
-                for (int i2 = 0; i2 < i; ++i2) {
-                    pht_entry_delete_value(task->t.function.args + i2);
-                }
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_CLASS(ce)
+        Z_PARAM_ZVAL(arg_sets)
+    ZEND_PARSE_PARAMETERS_END();
 
-                free(task->t.function.args);
-                return;
-            }
-        }
-    } else {
-        task->t.function.args = NULL;
+    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    task_t *template = class_task_create(ce, NULL, 0, "Thread::addClassTasks");
+
+    if (!template) {
+        return;
     }
 
-    pthread_mutex_lock(&thread->lock);
-    pht_queue_push(&thread->tasks, task);
-    pthread_mutex_unlock(&thread->lock);
+    if (!task_batch_create(&batch, template, arg_sets, USED_RET() ? return_value : NULL, "Thread::addClassTasks")) {
+        return;
+    }
+
+    thread_add_tasks(thread, &batch);
 }
 
-ZEND_BEGIN_ARG_INFO_EX(Thread_add_file_task_arginfo, 0, 0, 1)
-ZEND_ARG_INFO(0, filename)
+ZEND_BEGIN_ARG_INFO_EX(Thread_add_function_tasks_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, callable)
+    ZEND_ARG_INFO(0, arg_sets)
 ZEND_END_ARG_INFO()
 
-PHP_METHOD(Thread, addFileTask)
+PHP_METHOD(Thread, addFunctionTasks)
 {
-    zend_string *filename, *resolved_path;
-    zval *args;
-    int argc = 0;
+    zval *zcallable, *arg_sets;
+    pht_queue_t batch;
 
-    ZEND_PARSE_PARAMETERS_START(1, -1)
-        Z_PARAM_PATH_STR(filename)
-        Z_PARAM_VARIADIC('*', args, argc)
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_ZVAL(zcallable)
+        Z_PARAM_ZVAL(arg_sets)
     ZEND_PARSE_PARAMETERS_END();
 
     thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
-    task_t *task = malloc(sizeof(task_t));
+    task_t *template = function_task_create(zcallable, NULL, 0, "Thread::addFunctionTasks");
 
-    task->type = FILE_TASK;
-
-    resolved_path = zend_resolve_path(ZSTR_VAL(filename), ZSTR_LEN(filename));
+    if (!template) {
+        return;
+    }
 
-    if (resolved_path) {
-        pht_str_update(&task->t.file.name, ZSTR_VAL(resolved_path), ZSTR_LEN(resolved_path));
-        zend_string_release(resolved_path);
-    } else {
-        pht_str_update(&task->t.file.name, ZSTR_VAL(filename), ZSTR_LEN(filename));
+    if (!task_batch_create(&batch, template, arg_sets, USED_RET() ? return_value : NULL, "Thread::addFunctionTasks")) {
+        return;
     }
 
-    if (VCWD_ACCESS(PHT_STRV(task->t.file.name), F_OK) != 0) {
-        zend_throw_error(NULL, "The file '%s' does not exist", PHT_STRV(task->t.file.name));
-        free(PHT_STRV(task->t.file.name));
-        free(task);
+    thread_add_tasks(thread, &batch);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Thread_add_file_tasks_arginfo, 0, 0, 2)
+    ZEND_ARG_INFO(0, filename)
+    ZEND_ARG_INFO(0, global_sets)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Thread, addFileTasks)
+{
+    zend_string *filename;
+    zval *arg_sets;
+    pht_queue_t batch;
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_PATH_STR(filename)
+        Z_PARAM_ZVAL(arg_sets)
+    ZEND_PARSE_PARAMETERS_END();
+
+    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    task_t *template = file_task_create(filename, NULL, 0, "Thread::addFileTasks");
+
+    if (!template) {
         return;
     }
 
-    if (VCWD_ACCESS(PHT_STRV(task->t.file.name), R_OK) != 0) {
-        zend_throw_error(NULL, "The file '%s' is not readable", PHT_STRV(task->t.file.name));
-        free(PHT_STRV(task->t.file.name));
-        free(task);
+    // file tasks have no result, and so no futures are handed back
+    if (!task_batch_create(&batch, template, arg_sets, NULL, "Thread::addFileTasks")) {
         return;
     }
 
-    task->t.file.argc = argc;
+    thread_add_tasks(thread, &batch);
+}
 
-    if (argc) {
-        task->t.file.args = malloc(sizeof(pht_entry_t) * argc);
+ZEND_BEGIN_ARG_INFO_EX(Thread_set_task_priority_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, priority)
+ZEND_END_ARG_INFO()
 
-        for (int i = 0; i < argc; ++i) {
-            if (!pht_convert_zval_to_entry(task->t.file.args + i, args + i)) {
-                zend_throw_error(NULL, "Failed to serialise argument %d of Thread::addClassTask()", i + 1);
+PHP_METHOD(Thread, setTaskPriority)
+{
+    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    zend_long priority;
 
-                for (int i2 = 0; i2 < i; ++i2) {
-                    pht_entry_delete_value(task->t.file.args + i2);
-                }
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(priority)
+    ZEND_PARSE_PARAMETERS_END();
 
-                free(task->t.file.args);
-                free(task);
-                return;
-            }
-        }
-    } else {
-        task->t.file.args = NULL;
+    if (!task_priority_valid(priority)) {
+        return;
     }
 
-    pthread_mutex_lock(&thread->lock);
-    pht_queue_push(&thread->tasks, task);
-    pthread_mutex_unlock(&thread->lock);
+    thread->task_priority = priority;
 }
 
 ZEND_BEGIN_ARG_INFO_EX(Thread_start_arginfo, 0, 0, 0)
@@ -560,6 +1211,7 @@ PHP_METHOD(Thread, start)
     }
 
     thread->status = STARTING_UP;
+    thread->snapshot = pht_snapshot_acquire();
 
     pthread_create((pthread_t *)thread, NULL, (void *)worker_function, thread);
 }
@@ -575,7 +1227,10 @@ PHP_METHOD(Thread, join)
         return;
     }
 
+    pthread_mutex_lock(&thread->lock);
     thread->status = JOINED;
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->lock);
 
     pthread_join(thread->thread, NULL);
 }
@@ -591,16 +1246,41 @@ PHP_METHOD(Thread, taskCount)
         return;
     }
 
-    RETVAL_LONG(thread->tasks.size);
+    RETVAL_LONG(pht_priority_queue_size(&thread->tasks));
+}
+
+ZEND_BEGIN_ARG_INFO_EX(Thread_cache_stats_arginfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+PHP_METHOD(Thread, cacheStats)
+{
+    thread_obj_t *thread = (thread_obj_t *)((char *)Z_OBJ(EX(This)) - Z_OBJ(EX(This))->handlers->offset);
+    pht_task_cache_stats_t stats;
+
+    if (zend_parse_parameters_none() != SUCCESS) {
+        return;
+    }
+
+    pthread_mutex_lock(&thread->lock);
+    stats = thread->cache_stats;
+    pthread_mutex_unlock(&thread->lock);
+
+    task_cache_stats_to_array(return_value, &stats);
 }
 
 zend_function_entry Thread_methods[] = {
+    PHP_ME(Thread, __construct, Thread___construct_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Thread, addClassTask, Thread_add_class_task_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Thread, addFunctionTask, Thread_add_function_task_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Thread, addFileTask, Thread_add_file_task_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Thread, addClassTasks, Thread_add_class_tasks_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Thread, addFunctionTasks, Thread_add_function_tasks_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Thread, addFileTasks, Thread_add_file_tasks_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Thread, setTaskPriority, Thread_set_task_priority_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Thread, start, Thread_start_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Thread, join, Thread_join_arginfo, ZEND_ACC_PUBLIC)
     PHP_ME(Thread, taskCount, Thread_task_count_arginfo, ZEND_ACC_PUBLIC)
+    PHP_ME(Thread, cacheStats, Thread_cache_stats_arginfo, ZEND_ACC_PUBLIC)
     PHP_FE_END
 };
 
@@ -615,6 +1295,8 @@ void thread_ce_init(void)
     Thread_ce->serialize = zend_class_serialize_deny;
     Thread_ce->unserialize = zend_class_unserialize_deny;
 
+    task_priority_constants_declare(Thread_ce);
+
     memcpy(&thread_handlers, zh, sizeof(zend_object_handlers));
 
     thread_handlers.offset = XtOffsetOf(thread_obj_t, obj);
@@ -22,8 +22,11 @@
 #include <main/php.h>
 #include <pthread.h>
 
+#include "src/pht_copy.h"
 #include "src/pht_entry.h"
 #include "src/ds/pht_queue.h"
+#include "src/ds/pht_priority_queue.h"
+#include "src/classes/future.h"
 
 typedef struct _class_task_t {
     pht_string_t name;
@@ -56,6 +59,7 @@ typedef struct _task_t {
         file_task_t file;
     } t;
     pht_task_type_t type;
+    future_obj_internal_t *future; // NULL when the caller discarded the result
 } task_t;
 
 typedef enum _status_t {
@@ -69,13 +73,36 @@ typedef struct _thread_obj_t {
     pthread_t thread; // must be first member
     zend_ulong id; // local storage ID used to fetch local storage data
     pthread_mutex_t lock;
+    pthread_cond_t cond; // signalled when a task is added or the thread is joined
     status_t status;
-    pht_queue_t tasks;
+    pht_priority_queue_t tasks;
+    int task_priority; // the priority given to newly added tasks
+    zend_long spin_count; // upper bound on idle spins before parking (0 = always park)
+    zend_long spin_estimate; // adaptive spin bound, tuned by the worker thread
+    pht_snapshot_t *snapshot; // the parent's context to copy from, held until startup completes
+    pht_task_cache_stats_t cache_stats; // published by the worker thread whenever it fetches a task
     void*** ls; // pointer to local storage in TSRM
     void*** parent_thread_ls;
     zend_object obj;
 } thread_obj_t;
 
+task_t *class_task_create(zend_class_entry *ce, zval *args, int argc, const char *caller);
+task_t *function_task_create(zval *zcallable, zval *args, int argc, const char *caller);
+task_t *file_task_create(zend_string *filename, zval *args, int argc, const char *caller);
+void task_attach_future(task_t *task, zval *zfuture);
+int task_batch_create(pht_queue_t *batch, task_t *template, zval *arg_sets, zval *futures, const char *caller);
+void task_delete(void *task_void);
+int task_priority_valid(zend_long priority);
+void task_priority_constants_declare(zend_class_entry *ce);
+void handle_task(task_t *task);
+void task_cache_entry_free(zval *zv);
+void task_cache_stats_publish(pht_task_cache_stats_t *stats);
+void task_cache_stats_to_array(zval *zstats, pht_task_cache_stats_t *stats);
+void thread_init(thread_obj_t *thread);
+void thread_add_task(thread_obj_t *thread, task_t *task);
+void thread_add_tasks(thread_obj_t *thread, pht_queue_t *batch);
+void thread_context_startup(thread_obj_t *thread);
+void thread_context_shutdown(void);
 void thread_join_destroy(zval *zthread);
 void thread_ce_init(void);
 
@@ -21,6 +21,7 @@
 #include <Zend/zend_interfaces.h>
 
 #include "php_pht.h"
+#include "src/pht_alloc.h"
 #include "src/pht_entry.h"
 #include "src/pht_debug.h"
 #include "src/classes/vector.h"
@@ -309,7 +310,7 @@ PHP_METHOD(Vector, resize)
         return;
     }
 
-    pht_entry_t **values = malloc(size * sizeof(pht_entry_t *)), *entry;
+    pht_entry_t **values = pht_alloc(size * sizeof(pht_entry_t *)), *entry;
 
     if (!values) {
         zend_throw_error(NULL, "Failed to resize the vector to the specified size");
@@ -334,7 +335,7 @@ PHP_METHOD(Vector, resize)
     vo->voi->vector.size = size;
 
     if (size > vo->voi->vector.used) {
-        free(vo->voi->vector.values);
+        pht_free(vo->voi->vector.values);
         vo->voi->vector.values = values;
 
         if (initial_value) {
@@ -357,7 +358,7 @@ PHP_METHOD(Vector, resize)
             pht_entry_delete(pht_vector_pop(&vo->voi->vector));
         }
 
-        free(vo->voi->vector.values);
+        pht_free(vo->voi->vector.values);
         vo->voi->vector.values = values;
     }
 
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "src/pht_alloc.h"
 #include "src/pht_entry.h"
 #include "src/ds/pht_hashtable.h"
 
@@ -33,7 +34,7 @@ static long get_hash(pht_string_t *key);
 
 void pht_hashtable_init(pht_hashtable_t *ht, int size, void (*dtor)(void *))
 {
-    ht->values = calloc(sizeof(pht_bucket_t), size);
+    ht->values = pht_calloc(size, sizeof(pht_bucket_t));
     ht->size = size;
     ht->used = 0;
     ht->dtor = dtor;
@@ -51,12 +52,12 @@ void pht_hashtable_destroy(pht_hashtable_t *ht)
         ht->dtor(b->value);
 
         if (b->key) {
-            free(PHT_STRV_P(b->key));
-            free(b->key);
+            pht_str_free(b->key);
+            pht_free(b->key);
         }
     }
 
-    free(ht->values);
+    pht_free(ht->values);
 }
 
 void pht_hashtable_insert_ind(pht_hashtable_t *ht, long hash, void *value)
@@ -130,11 +131,11 @@ static void pht_hashtable_resize(pht_hashtable_t *ht)
 
     ht->size <<= 1;
     ht->used = 0;
-    ht->values = calloc(sizeof(pht_bucket_t), ht->size);
+    ht->values = pht_calloc(ht->size, sizeof(pht_bucket_t));
 
     pht_hashtable_repopulate(ht, old_values, old_size);
 
-    free(old_values);
+    pht_free(old_values);
 }
 
 static void pht_hashtable_repopulate(pht_hashtable_t *ht, pht_bucket_t *old_values, int old_size)
@@ -268,8 +269,8 @@ void pht_hashtable_delete_direct(pht_hashtable_t *ht, pht_string_t *key, long ha
                 ht->dtor(b->value);
 
                 if (b->key) {
-                    free(PHT_STRV_P(b->key));
-                    free(b->key);
+                    pht_str_free(b->key);
+                    pht_free(b->key);
                 }
 
                 b->key = NULL;
@@ -0,0 +1,103 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <main/php.h>
+
+#include "src/ds/pht_priority_queue.h"
+
+void pht_priority_queue_init(pht_priority_queue_t *pqueue, void (*dtor)(void *))
+{
+    for (int i = 0; i < PHT_PRIORITY_LEVELS; ++i) {
+        pht_queue_init(pqueue->levels + i, dtor);
+        pqueue->passed_over[i] = 0;
+    }
+
+    pqueue->size = 0;
+}
+
+void pht_priority_queue_push(pht_priority_queue_t *pqueue, void *element, int priority)
+{
+    pht_queue_push(pqueue->levels + priority, element);
+    ++pqueue->size;
+}
+
+void pht_priority_queue_splice(pht_priority_queue_t *pqueue, pht_queue_t *src, int priority)
+{
+    pqueue->size += pht_queue_size(src);
+    pht_queue_splice(pqueue->levels + priority, src);
+}
+
+/*
+Pops from the highest non-empty priority level. To prevent starvation, each
+lower level that is passed over has a counter incremented, and once this hits
+PHT_PRIORITY_STARVATION_LIMIT, that level is served instead.
+*/
+void *pht_priority_queue_pop(pht_priority_queue_t *pqueue)
+{
+    int level = -1;
+
+    for (int i = PHT_PRIORITY_LEVELS - 1; i >= 0; --i) {
+        if (!pht_queue_size(pqueue->levels + i)) {
+            continue;
+        }
+
+        if (level == -1 || ++pqueue->passed_over[i] >= PHT_PRIORITY_STARVATION_LIMIT) {
+            level = i;
+        }
+    }
+
+    if (level == -1) {
+        return NULL;
+    }
+
+    pqueue->passed_over[level] = 0;
+    --pqueue->size;
+
+    return pht_queue_pop(pqueue->levels + level);
+}
+
+/*
+Removes the most recently queued element of the lowest non-empty priority
+level, which is the element that the queue's owner would otherwise get to last.
+*/
+void *pht_priority_queue_pop_back(pht_priority_queue_t *pqueue)
+{
+    for (int i = 0; i < PHT_PRIORITY_LEVELS; ++i) {
+        if (pht_queue_size(pqueue->levels + i)) {
+            --pqueue->size;
+
+            return pht_queue_pop_back(pqueue->levels + i);
+        }
+    }
+
+    return NULL;
+}
+
+int pht_priority_queue_size(pht_priority_queue_t *pqueue)
+{
+    return pqueue->size;
+}
+
+void pht_priority_queue_destroy(pht_priority_queue_t *pqueue)
+{
+    for (int i = 0; i < PHT_PRIORITY_LEVELS; ++i) {
+        pht_queue_destroy(pqueue->levels + i);
+    }
+
+    pqueue->size = 0;
+}
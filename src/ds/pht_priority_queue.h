@@ -0,0 +1,46 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_PRIORITY_QUEUE_H
+#define PHT_PRIORITY_QUEUE_H
+
+#include "src/ds/pht_queue.h"
+
+#define PHT_PRIORITY_LOW 0
+#define PHT_PRIORITY_NORMAL 1
+#define PHT_PRIORITY_HIGH 2
+#define PHT_PRIORITY_LEVELS 3
+
+// the number of times a non-empty level may be passed over before it is served
+#define PHT_PRIORITY_STARVATION_LIMIT 16
+
+typedef struct _pht_priority_queue_t {
+    pht_queue_t levels[PHT_PRIORITY_LEVELS]; // a FIFO per priority level
+    int passed_over[PHT_PRIORITY_LEVELS];
+    int size;
+} pht_priority_queue_t;
+
+void pht_priority_queue_init(pht_priority_queue_t *pqueue, void (*dtor)(void *));
+void pht_priority_queue_push(pht_priority_queue_t *pqueue, void *element, int priority);
+void pht_priority_queue_splice(pht_priority_queue_t *pqueue, pht_queue_t *src, int priority);
+void *pht_priority_queue_pop(pht_priority_queue_t *pqueue);
+void *pht_priority_queue_pop_back(pht_priority_queue_t *pqueue);
+int pht_priority_queue_size(pht_priority_queue_t *pqueue);
+void pht_priority_queue_destroy(pht_priority_queue_t *pqueue);
+
+#endif
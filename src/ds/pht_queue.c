@@ -17,51 +17,204 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 
+#include "src/pht_alloc.h"
 #include "src/pht_entry.h"
 #include "src/ds/pht_queue.h"
 
+static pht_queue_segment_t *segment_acquire(pht_queue_t *queue)
+{
+    pht_queue_segment_t *segment = queue->spare;
+
+    if (segment) {
+        queue->spare = NULL;
+    } else {
+        segment = pht_alloc(sizeof(pht_queue_segment_t));
+    }
+
+    segment->next = NULL;
+    segment->head = 0;
+    segment->tail = 0;
+
+    return segment;
+}
+
+static void segment_release(pht_queue_t *queue, pht_queue_segment_t *segment)
+{
+    if (queue->spare) {
+        pht_free(segment);
+    } else {
+        queue->spare = segment;
+    }
+}
+
 void pht_queue_init(pht_queue_t *queue, void (*dtor)(void *))
 {
-    queue->elements = NULL;
+    queue->first = NULL;
     queue->last = NULL;
+    queue->spare = NULL;
     queue->size = 0;
     queue->dtor = dtor;
 }
 
 void pht_queue_push(pht_queue_t *queue, void *element)
 {
-    linked_list_t *ll = malloc(sizeof(linked_list_t));
+    if (!queue->last) {
+        queue->first = queue->last = segment_acquire(queue);
+    } else if (queue->last->tail == PHT_QUEUE_SEGMENT_SIZE) {
+        queue->last->next = segment_acquire(queue);
+        queue->last = queue->last->next;
+    }
 
-    ll->element = element;
-    ll->next = NULL;
+    queue->last->elements[queue->last->tail++] = element;
+    ++queue->size;
+}
 
-    if (queue->elements) {
-        queue->last->next = ll;
+/*
+Moves all of the elements of src onto the end of dest in constant time, leaving
+src empty. Both queues must be using the same element destructor.
+*/
+void pht_queue_splice(pht_queue_t *dest, pht_queue_t *src)
+{
+    if (!src->size) {
+        return;
+    }
+
+    if (dest->size) {
+        dest->last->next = src->first;
     } else {
-        queue->elements = ll;
+        if (dest->first) {
+            segment_release(dest, dest->first);
+        }
+
+        dest->first = src->first;
     }
 
-    queue->last = ll;
-    ++queue->size;
+    dest->last = src->last;
+    dest->size += src->size;
+
+    src->first = NULL;
+    src->last = NULL;
+    src->size = 0;
+}
+
+/*
+Moves the first count elements of src onto the end of dest. Only the segment
+that count falls in the middle of has its elements copied - all other segments
+are moved over whole.
+*/
+void pht_queue_split(pht_queue_t *src, pht_queue_t *dest, int count)
+{
+    pht_queue_segment_t *segment = src->first, *prev = NULL;
+    pht_queue_t chunk;
+    int remaining = count;
+
+    if (count >= src->size) {
+        pht_queue_splice(dest, src);
+        return;
+    }
+
+    if (count <= 0) {
+        return;
+    }
+
+    pht_queue_init(&chunk, src->dtor);
+
+    while (remaining && remaining >= segment->tail - segment->head) {
+        remaining -= segment->tail - segment->head;
+        prev = segment;
+        segment = segment->next;
+    }
+
+    if (prev) {
+        chunk.first = src->first;
+        chunk.last = prev;
+        prev->next = NULL;
+    }
+
+    if (remaining) {
+        pht_queue_segment_t *part = segment_acquire(src);
+
+        memcpy(part->elements, segment->elements + segment->head, remaining * sizeof(void *));
+        part->tail = remaining;
+        segment->head += remaining;
+
+        if (chunk.last) {
+            chunk.last->next = part;
+        } else {
+            chunk.first = part;
+        }
+
+        chunk.last = part;
+    }
+
+    chunk.size = count;
+    src->first = segment;
+    src->size -= count;
+
+    pht_queue_splice(dest, &chunk);
 }
 
 void *pht_queue_pop(pht_queue_t *queue)
 {
-    linked_list_t *ll = NULL;
-    void *element = NULL;
+    pht_queue_segment_t *segment = queue->first;
+    void *element;
 
-    if (queue->elements) {
-        ll = queue->elements;
-        queue->elements = queue->elements->next;
+    if (!queue->size) {
+        return NULL;
+    }
 
-        if (!queue->elements) {
-            queue->last = NULL;
+    element = segment->elements[segment->head++];
+    --queue->size;
+
+    if (segment->head == segment->tail) {
+        if (segment == queue->last) {
+            // the queue is now empty, so keep hold of the segment for the next push
+            segment->head = 0;
+            segment->tail = 0;
+        } else {
+            queue->first = segment->next;
+            segment_release(queue, segment);
         }
+    }
+
+    return element;
+}
 
-        element = ll->element;
-        free(ll);
-        --queue->size;
+/*
+Removes the last element. The segments are only linked forwards, so emptying
+the last segment walks the list to find the one before it (this is only used
+for work stealing, which is rare next to pops).
+*/
+void *pht_queue_pop_back(pht_queue_t *queue)
+{
+    pht_queue_segment_t *segment = queue->last;
+    void *element;
+
+    if (!queue->size) {
+        return NULL;
+    }
+
+    element = segment->elements[--segment->tail];
+    --queue->size;
+
+    if (segment->head == segment->tail) {
+        if (segment == queue->first) {
+            // the queue is now empty, so keep hold of the segment for the next push
+            segment->head = 0;
+            segment->tail = 0;
+        } else {
+            pht_queue_segment_t *prev = queue->first;
+
+            while (prev->next != segment) {
+                prev = prev->next;
+            }
+
+            prev->next = NULL;
+            queue->last = prev;
+            segment_release(queue, segment);
+        }
     }
 
     return element;
@@ -69,11 +222,11 @@ void *pht_queue_pop(pht_queue_t *queue)
 
 void *pht_queue_front(pht_queue_t *queue)
 {
-    if (!queue->elements) {
+    if (!queue->size) {
         return NULL;
     }
 
-    return queue->elements->element;
+    return queue->first->elements[queue->first->head];
 }
 
 int pht_queue_size(pht_queue_t *queue)
@@ -81,21 +234,69 @@ int pht_queue_size(pht_queue_t *queue)
     return queue->size;
 }
 
+// destroys the elements and frees the segments, leaving the queue reusable
 void pht_queue_destroy(pht_queue_t *queue)
 {
-    while (queue->size) {
-        queue->dtor(pht_queue_pop(queue));
+    pht_queue_segment_t *segment = queue->first;
+
+    while (segment) {
+        pht_queue_segment_t *next = segment->next;
+
+        for (int i = segment->head; i < segment->tail; ++i) {
+            queue->dtor(segment->elements[i]);
+        }
+
+        pht_free(segment);
+        segment = next;
+    }
+
+    if (queue->spare) {
+        pht_free(queue->spare);
     }
+
+    queue->first = NULL;
+    queue->last = NULL;
+    queue->spare = NULL;
+    queue->size = 0;
 }
 
 void pht_queue_to_zend_hashtable(HashTable *zht, pht_queue_t *queue)
 {
-    linked_list_t *ll = queue->elements;
+    zend_ulong i = 0;
 
-    for (int i = 0; ll; ++i, ll = ll->next) {
-        zval value;
+    for (pht_queue_segment_t *segment = queue->first; segment; segment = segment->next) {
+        for (int j = segment->head; j < segment->tail; ++j, ++i) {
+            zval value;
 
-        pht_convert_entry_to_zval(&value, ll->element);
-        _zend_hash_index_add(zht, i, &value ZEND_FILE_LINE_CC);
+            pht_convert_entry_to_zval(&value, segment->elements[j]);
+            _zend_hash_index_add(zht, i, &value ZEND_FILE_LINE_CC);
+        }
     }
 }
+
+/*
+Converts the elements of the queue into a packed array (in order), destroying
+them in the same pass, and so leaving the queue empty.
+*/
+void pht_queue_move_to_zend_array(zval *zarr, pht_queue_t *queue)
+{
+    array_init_size(zarr, queue->size);
+    zend_hash_real_init(Z_ARRVAL_P(zarr), 1);
+
+    ZEND_HASH_FILL_PACKED(Z_ARRVAL_P(zarr)) {
+        for (pht_queue_segment_t *segment = queue->first; segment; segment = segment->next) {
+            for (int i = segment->head; i < segment->tail; ++i) {
+                zval value;
+
+                pht_convert_entry_to_zval(&value, segment->elements[i]);
+                ZEND_HASH_FILL_ADD(&value);
+
+                queue->dtor(segment->elements[i]);
+            }
+
+            segment->head = segment->tail;
+        }
+    } ZEND_HASH_FILL_END();
+
+    pht_queue_destroy(queue);
+}
@@ -19,24 +19,44 @@
 #ifndef PHT_QUEUE_H
 #define PHT_QUEUE_H
 
-typedef struct _linked_list_t {
-    void *element;
-    struct _linked_list_t *next;
-} linked_list_t;
+// sized so that a segment fits the largest size class of the pooled allocator
+#define PHT_QUEUE_SEGMENT_SIZE 30
+
+/*
+Elements are stored in a list of fixed-size segments, where each segment holds
+the range [head, tail) of its elements. Pushes fill the last segment, and pops
+empty the first one. A single emptied segment is kept aside for the next push
+that needs one, so that a queue with a steady flow of elements does not need
+to allocate at all.
+
+Every segment in the list holds at least one element, with the exception of an
+empty queue, which may keep hold of its (empty) last segment.
+*/
+typedef struct _pht_queue_segment_t {
+    struct _pht_queue_segment_t *next;
+    int head;
+    int tail;
+    void *elements[PHT_QUEUE_SEGMENT_SIZE];
+} pht_queue_segment_t;
 
 typedef struct _pht_queue_t {
-    linked_list_t *elements;
-    linked_list_t *last;
+    pht_queue_segment_t *first;
+    pht_queue_segment_t *last;
+    pht_queue_segment_t *spare;
     int size;
     void (*dtor)(void *);
 } pht_queue_t;
 
 void pht_queue_init(pht_queue_t *queue, void (*dtor)(void *));
 void pht_queue_push(pht_queue_t *queue, void *element);
+void pht_queue_splice(pht_queue_t *dest, pht_queue_t *src);
+void pht_queue_split(pht_queue_t *src, pht_queue_t *dest, int count);
 void *pht_queue_pop(pht_queue_t *queue);
+void *pht_queue_pop_back(pht_queue_t *queue);
 void *pht_queue_front(pht_queue_t *queue);
 int pht_queue_size(pht_queue_t *queue);
 void pht_queue_destroy(pht_queue_t *queue);
 void pht_queue_to_zend_hashtable(HashTable *zht, pht_queue_t *queue);
+void pht_queue_move_to_zend_array(zval *zarr, pht_queue_t *queue);
 
 #endif
@@ -0,0 +1,150 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "src/ds/pht_ring_buffer.h"
+
+/*
+Sets up the ring buffer with a capacity of at least the given capacity (rounded
+up to a power of two, so that positions can be masked into slot indexes).
+Returns 0 on allocation failure.
+*/
+int pht_ring_buffer_init(pht_ring_buffer_t *rb, size_t capacity, void (*dtor)(void *))
+{
+    size_t size = 2;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    rb->slots = malloc(size * sizeof(pht_ring_buffer_slot_t));
+
+    if (!rb->slots) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        pht_atomic_size_store(&rb->slots[i].sequence, i);
+        rb->slots[i].element = NULL;
+    }
+
+    rb->mask = size - 1;
+    rb->dtor = dtor;
+    pht_atomic_size_store(&rb->enqueue_pos, 0);
+    pht_atomic_size_store(&rb->dequeue_pos, 0);
+
+    return 1;
+}
+
+/*
+Returns 0 if the ring buffer is full, in which case ownership of the element
+remains with the caller.
+*/
+int pht_ring_buffer_push(pht_ring_buffer_t *rb, void *element)
+{
+    size_t pos = pht_atomic_size_load(&rb->enqueue_pos);
+    pht_ring_buffer_slot_t *slot;
+
+    while (1) {
+        slot = rb->slots + (pos & rb->mask);
+
+        intptr_t diff = (intptr_t) pht_atomic_size_load(&slot->sequence) - (intptr_t) pos;
+
+        if (diff == 0) {
+            if (pht_atomic_size_cas(&rb->enqueue_pos, pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the slot has not been consumed since the last lap
+            return 0;
+        }
+
+        pos = pht_atomic_size_load(&rb->enqueue_pos);
+    }
+
+    slot->element = element;
+    pht_atomic_size_store(&slot->sequence, pos + 1);
+
+    return 1;
+}
+
+// returns NULL if the ring buffer is empty
+void *pht_ring_buffer_pop(pht_ring_buffer_t *rb)
+{
+    size_t pos = pht_atomic_size_load(&rb->dequeue_pos);
+    pht_ring_buffer_slot_t *slot;
+    void *element;
+
+    while (1) {
+        slot = rb->slots + (pos & rb->mask);
+
+        intptr_t diff = (intptr_t) pht_atomic_size_load(&slot->sequence) - (intptr_t) (pos + 1);
+
+        if (diff == 0) {
+            if (pht_atomic_size_cas(&rb->dequeue_pos, pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the slot has not been produced into yet
+            return NULL;
+        }
+
+        pos = pht_atomic_size_load(&rb->dequeue_pos);
+    }
+
+    element = slot->element;
+    pht_atomic_size_store(&slot->sequence, pos + rb->mask + 1);
+
+    return element;
+}
+
+size_t pht_ring_buffer_capacity(pht_ring_buffer_t *rb)
+{
+    return rb->mask + 1;
+}
+
+/*
+The size is only approximate when other threads are pushing or popping, since
+the two positions cannot be read together atomically.
+*/
+size_t pht_ring_buffer_size(pht_ring_buffer_t *rb)
+{
+    size_t dequeue_pos = pht_atomic_size_load(&rb->dequeue_pos);
+    size_t enqueue_pos = pht_atomic_size_load(&rb->enqueue_pos);
+    intptr_t size = (intptr_t) (enqueue_pos - dequeue_pos);
+
+    if (size < 0) {
+        return 0;
+    }
+
+    return (size_t) size > rb->mask + 1 ? rb->mask + 1 : (size_t) size;
+}
+
+// must only be called once no other threads are using the ring buffer
+void pht_ring_buffer_destroy(pht_ring_buffer_t *rb)
+{
+    void *element;
+
+    while ((element = pht_ring_buffer_pop(rb))) {
+        rb->dtor(element);
+    }
+
+    free(rb->slots);
+}
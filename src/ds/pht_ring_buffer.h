@@ -0,0 +1,60 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_RING_BUFFER_H
+#define PHT_RING_BUFFER_H
+
+#include <stddef.h>
+
+#include "src/pht_atomic.h"
+
+#define PHT_RING_BUFFER_MAX_CAPACITY (1 << 30)
+
+// keeps the positions written by producers and consumers on separate cache lines
+#define PHT_CACHE_LINE_SIZE 64
+
+/*
+A bounded, lock-free, multi-producer multi-consumer queue of non-NULL elements,
+based upon Dmitry Vyukov's algorithm. Each slot holds a sequence number that
+tells producers and consumers whether the slot is ready for them at their
+position, so that claiming a slot is a single compare-and-swap on the position.
+*/
+typedef struct _pht_ring_buffer_slot_t {
+    pht_atomic_size_t sequence;
+    void *element;
+} pht_ring_buffer_slot_t;
+
+typedef struct _pht_ring_buffer_t {
+    pht_ring_buffer_slot_t *slots;
+    size_t mask;
+    void (*dtor)(void *);
+    char pad0[PHT_CACHE_LINE_SIZE];
+    pht_atomic_size_t enqueue_pos;
+    char pad1[PHT_CACHE_LINE_SIZE];
+    pht_atomic_size_t dequeue_pos;
+    char pad2[PHT_CACHE_LINE_SIZE];
+} pht_ring_buffer_t;
+
+int pht_ring_buffer_init(pht_ring_buffer_t *rb, size_t capacity, void (*dtor)(void *));
+int pht_ring_buffer_push(pht_ring_buffer_t *rb, void *element);
+void *pht_ring_buffer_pop(pht_ring_buffer_t *rb);
+size_t pht_ring_buffer_capacity(pht_ring_buffer_t *rb);
+size_t pht_ring_buffer_size(pht_ring_buffer_t *rb);
+void pht_ring_buffer_destroy(pht_ring_buffer_t *rb);
+
+#endif
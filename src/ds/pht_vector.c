@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 
+#include "src/pht_alloc.h"
 #include "src/pht_entry.h"
 #include "src/ds/pht_vector.h"
 
@@ -25,13 +26,13 @@ static void pht_vector_space_check(pht_vector_t *vector)
 {
     if (vector->used == vector->size) {
         vector->size = vector->size ? vector->size << 1 : 1;
-        vector->values = realloc(vector->values, vector->size * sizeof(pht_entry_t *)); // @todo success check
+        vector->values = pht_realloc(vector->values, vector->size * sizeof(pht_entry_t *)); // @todo success check
     }
 }
 
 void pht_vector_init(pht_vector_t *vector, int size, void (*dtor)(void *))
 {
-    vector->values = calloc(size, sizeof(pht_entry_t *));
+    vector->values = pht_calloc(size, sizeof(pht_entry_t *));
     vector->size = size;
     vector->used = 0;
     vector->dtor = dtor;
@@ -154,7 +155,7 @@ void pht_vector_destroy(pht_vector_t *vector)
         vector->dtor(vector->values[i]);
     }
 
-    free(vector->values);
+    pht_free(vector->values);
 }
 
 void pht_vector_to_zend_hashtable(HashTable *zht, pht_vector_t *vector)
@@ -0,0 +1,456 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <main/php.h>
+
+#include "src/pht_alloc.h"
+
+/*
+Requests of up to PHT_ALLOC_MAX bytes are rounded up to one of a handful of
+size classes, and served from the calling thread's free list for that class.
+Each block carries a small header recording its usable size, so that it can be
+returned to the right free list by whichever thread frees it.
+
+Free lists are refilled from (and overflow back into) a shared depot in
+batches, so the depot's lock is only taken once per PHT_ALLOC_BATCH operations.
+The depot carves new blocks out of slabs when it runs dry. Slabs are only
+returned to the system at module shutdown.
+
+Larger requests go straight to the system allocator (with the same header).
+When pooling is disabled (pht.pooled_allocator=0), all requests go straight to
+the system allocator without a header.
+*/
+
+#define PHT_ALLOC_CLASSES 8
+#define PHT_ALLOC_MAX 256
+#define PHT_ALLOC_BATCH 32
+#define PHT_ALLOC_SLAB_SIZE (64 * 1024)
+
+typedef union _pht_alloc_header_t {
+    size_t size; // the usable size of the block
+    double align;
+} pht_alloc_header_t;
+
+typedef struct _pht_alloc_block_t {
+    struct _pht_alloc_block_t *next;
+} pht_alloc_block_t;
+
+typedef union _pht_alloc_slab_t {
+    union _pht_alloc_slab_t *next;
+    double align;
+} pht_alloc_slab_t;
+
+typedef struct _pht_free_list_t {
+    pht_alloc_block_t *head;
+    int count;
+} pht_free_list_t;
+
+typedef struct _pht_alloc_cache_t {
+    pht_free_list_t lists[PHT_ALLOC_CLASSES];
+    size_t bytes_allocated;
+    size_t bytes_freed;
+    struct _pht_alloc_cache_t *prev;
+    struct _pht_alloc_cache_t *next;
+} pht_alloc_cache_t;
+
+typedef struct _pht_alloc_depot_t {
+    pthread_mutex_t lock;
+    int pooled;
+    pht_free_list_t lists[PHT_ALLOC_CLASSES];
+    pht_alloc_slab_t *slabs;
+    size_t bytes_reserved;
+    size_t bytes_allocated; // totals of the caches of threads that have exited
+    size_t bytes_freed;
+    pht_alloc_cache_t *caches;
+} pht_alloc_depot_t;
+
+static const size_t class_sizes[PHT_ALLOC_CLASSES] = {16, 32, 48, 64, 96, 128, 192, 256};
+
+// maps a size (rounded up to a multiple of 16, then divided by 16) to its class
+static const unsigned char class_lookup[(PHT_ALLOC_MAX >> 4) + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+};
+
+static pht_alloc_depot_t depot;
+static TSRM_TLS pht_alloc_cache_t *cache = NULL;
+
+#define PHT_ALLOC_HEADER(ptr) ((pht_alloc_header_t *)(ptr) - 1)
+#define PHT_ALLOC_CLASS(size) class_lookup[((size) + 15) >> 4]
+
+void pht_alloc_startup(int pooled)
+{
+    memset(&depot, 0, sizeof(pht_alloc_depot_t));
+    pthread_mutex_init(&depot.lock, NULL);
+    depot.pooled = pooled;
+}
+
+void pht_alloc_shutdown(void)
+{
+    pht_alloc_slab_t *slab = depot.slabs;
+    pht_alloc_cache_t *c = depot.caches;
+
+    while (slab) {
+        pht_alloc_slab_t *next = slab->next;
+
+        free(slab);
+        slab = next;
+    }
+
+    // the caches of threads that never shut down cleanly (including this one)
+    while (c) {
+        pht_alloc_cache_t *next = c->next;
+
+        free(c);
+        c = next;
+    }
+
+    cache = NULL;
+
+    pthread_mutex_destroy(&depot.lock);
+}
+
+int pht_alloc_pooled(void)
+{
+    return depot.pooled;
+}
+
+static pht_alloc_cache_t *cache_fetch(void)
+{
+    if (cache) {
+        return cache;
+    }
+
+    cache = calloc(1, sizeof(pht_alloc_cache_t));
+
+    if (!cache) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&depot.lock);
+    cache->next = depot.caches;
+
+    if (depot.caches) {
+        depot.caches->prev = cache;
+    }
+
+    depot.caches = cache;
+    pthread_mutex_unlock(&depot.lock);
+
+    return cache;
+}
+
+// must be called with the depot locked
+static int depot_carve_slab(int cls)
+{
+    size_t stride = sizeof(pht_alloc_header_t) + class_sizes[cls];
+    pht_alloc_slab_t *slab = malloc(PHT_ALLOC_SLAB_SIZE);
+    char *p, *end;
+
+    if (!slab) {
+        return 0;
+    }
+
+    slab->next = depot.slabs;
+    depot.slabs = slab;
+    depot.bytes_reserved += PHT_ALLOC_SLAB_SIZE;
+
+    p = (char *)(slab + 1);
+    end = (char *)slab + PHT_ALLOC_SLAB_SIZE;
+
+    for (; p + stride <= end; p += stride) {
+        pht_alloc_header_t *h = (pht_alloc_header_t *)p;
+        pht_alloc_block_t *block = (pht_alloc_block_t *)(h + 1);
+
+        h->size = class_sizes[cls];
+        block->next = depot.lists[cls].head;
+        depot.lists[cls].head = block;
+        ++depot.lists[cls].count;
+    }
+
+    return 1;
+}
+
+/*
+Moves up to count blocks from the front of src onto the front of dest.
+*/
+static void free_list_move(pht_free_list_t *dest, pht_free_list_t *src, int count)
+{
+    pht_alloc_block_t *first = src->head, *last = src->head;
+    int moved = 1;
+
+    if (!first || count <= 0) {
+        return;
+    }
+
+    while (moved < count && last->next) {
+        last = last->next;
+        ++moved;
+    }
+
+    src->head = last->next;
+    src->count -= moved;
+
+    last->next = dest->head;
+    dest->head = first;
+    dest->count += moved;
+}
+
+static int cache_refill(pht_alloc_cache_t *c, int cls)
+{
+    int refilled = 1;
+
+    pthread_mutex_lock(&depot.lock);
+
+    if (!depot.lists[cls].head) {
+        refilled = depot_carve_slab(cls);
+    }
+
+    if (refilled) {
+        free_list_move(c->lists + cls, depot.lists + cls, PHT_ALLOC_BATCH);
+    }
+
+    pthread_mutex_unlock(&depot.lock);
+
+    return refilled;
+}
+
+static void cache_flush(pht_alloc_cache_t *c, int cls, int count)
+{
+    pthread_mutex_lock(&depot.lock);
+    free_list_move(depot.lists + cls, c->lists + cls, count);
+    pthread_mutex_unlock(&depot.lock);
+}
+
+/*
+Returns the free lists of the calling thread to the depot. This must be called
+by each thread (other than the main thread) before it exits, after its last
+call to pht_free().
+*/
+void pht_alloc_thread_shutdown(void)
+{
+    if (!cache) {
+        return;
+    }
+
+    pthread_mutex_lock(&depot.lock);
+
+    for (int cls = 0; cls < PHT_ALLOC_CLASSES; ++cls) {
+        free_list_move(depot.lists + cls, cache->lists + cls, cache->lists[cls].count);
+    }
+
+    depot.bytes_allocated += cache->bytes_allocated;
+    depot.bytes_freed += cache->bytes_freed;
+
+    if (cache->prev) {
+        cache->prev->next = cache->next;
+    } else {
+        depot.caches = cache->next;
+    }
+
+    if (cache->next) {
+        cache->next->prev = cache->prev;
+    }
+
+    pthread_mutex_unlock(&depot.lock);
+
+    free(cache);
+    cache = NULL;
+}
+
+void *pht_alloc(size_t size)
+{
+    pht_alloc_cache_t *c;
+    pht_free_list_t *list;
+    pht_alloc_block_t *block;
+    int cls;
+
+    if (!depot.pooled) {
+        return malloc(size);
+    }
+
+    if (!(c = cache_fetch())) {
+        return NULL;
+    }
+
+    if (size > PHT_ALLOC_MAX) {
+        pht_alloc_header_t *h = malloc(sizeof(pht_alloc_header_t) + size);
+
+        if (!h) {
+            return NULL;
+        }
+
+        h->size = size;
+        c->bytes_allocated += size;
+
+        return h + 1;
+    }
+
+    cls = PHT_ALLOC_CLASS(size);
+    list = c->lists + cls;
+
+    if (!list->head && !cache_refill(c, cls)) {
+        return NULL;
+    }
+
+    block = list->head;
+    list->head = block->next;
+    --list->count;
+    c->bytes_allocated += class_sizes[cls];
+
+    return block;
+}
+
+void *pht_calloc(size_t count, size_t size)
+{
+    void *ptr;
+
+    if (size && count > (size_t) -1 / size) {
+        return NULL;
+    }
+
+    if ((ptr = pht_alloc(count * size))) {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+void *pht_realloc(void *ptr, size_t size)
+{
+    size_t old_size;
+    void *new_ptr;
+
+    if (!depot.pooled) {
+        return realloc(ptr, size);
+    }
+
+    if (!ptr) {
+        return pht_alloc(size);
+    }
+
+    old_size = PHT_ALLOC_HEADER(ptr)->size;
+
+    if (old_size > PHT_ALLOC_MAX && size > PHT_ALLOC_MAX) {
+        pht_alloc_cache_t *c = cache_fetch();
+        pht_alloc_header_t *h;
+
+        if (!c || !(h = realloc(PHT_ALLOC_HEADER(ptr), sizeof(pht_alloc_header_t) + size))) {
+            return NULL;
+        }
+
+        h->size = size;
+        c->bytes_allocated += size;
+        c->bytes_freed += old_size;
+
+        return h + 1;
+    }
+
+    if (old_size <= PHT_ALLOC_MAX && size <= old_size) {
+        return ptr;
+    }
+
+    if (!(new_ptr = pht_alloc(size))) {
+        return NULL;
+    }
+
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    pht_free(ptr);
+
+    return new_ptr;
+}
+
+void pht_free(void *ptr)
+{
+    pht_alloc_cache_t *c;
+    pht_free_list_t *list;
+    pht_alloc_block_t *block = ptr;
+    size_t size;
+    int cls;
+
+    if (!depot.pooled) {
+        free(ptr);
+        return;
+    }
+
+    if (!ptr || !(c = cache_fetch())) {
+        return;
+    }
+
+    size = PHT_ALLOC_HEADER(ptr)->size;
+    c->bytes_freed += size;
+
+    if (size > PHT_ALLOC_MAX) {
+        free(PHT_ALLOC_HEADER(ptr));
+        return;
+    }
+
+    cls = PHT_ALLOC_CLASS(size);
+    list = c->lists + cls;
+
+    block->next = list->head;
+    list->head = block;
+    ++list->count;
+
+    // threads that mostly consume values hand their surplus back to producers
+    if (list->count > PHT_ALLOC_BATCH * 2) {
+        cache_flush(c, cls, PHT_ALLOC_BATCH);
+    }
+}
+
+/*
+The counters of running threads are read without synchronising with them, and
+so the figures are approximate whilst other threads are allocating.
+*/
+void pht_alloc_stats(pht_alloc_stats_t *stats)
+{
+    size_t allocated, freed, pooled_free = 0;
+
+    memset(stats, 0, sizeof(pht_alloc_stats_t));
+
+    if (!depot.pooled) {
+        return;
+    }
+
+    pthread_mutex_lock(&depot.lock);
+
+    allocated = depot.bytes_allocated;
+    freed = depot.bytes_freed;
+
+    for (int cls = 0; cls < PHT_ALLOC_CLASSES; ++cls) {
+        pooled_free += depot.lists[cls].count * class_sizes[cls];
+    }
+
+    for (pht_alloc_cache_t *c = depot.caches; c; c = c->next) {
+        allocated += c->bytes_allocated;
+        freed += c->bytes_freed;
+
+        for (int cls = 0; cls < PHT_ALLOC_CLASSES; ++cls) {
+            pooled_free += c->lists[cls].count * class_sizes[cls];
+        }
+    }
+
+    stats->bytes_in_use = allocated > freed ? allocated - freed : 0;
+    stats->bytes_pooled_free = pooled_free;
+    stats->bytes_reserved = depot.bytes_reserved;
+
+    pthread_mutex_unlock(&depot.lock);
+}
@@ -0,0 +1,47 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_ALLOC_H
+#define PHT_ALLOC_H
+
+#include <stddef.h>
+
+/*
+The allocator used for entries, their payloads, and the nodes and keys of the
+internal data structures. Small blocks are served from per-thread free lists
+(backed by a shared pool of slabs), so that threads pushing and popping values
+do not contend on the system allocator. Blocks may be freed by any thread.
+*/
+
+typedef struct _pht_alloc_stats_t {
+    size_t bytes_in_use; // bytes handed out and not yet freed
+    size_t bytes_pooled_free; // bytes held on free lists, ready for reuse
+    size_t bytes_reserved; // bytes of slabs taken from the system
+} pht_alloc_stats_t;
+
+void pht_alloc_startup(int pooled);
+void pht_alloc_shutdown(void);
+void pht_alloc_thread_shutdown(void);
+int pht_alloc_pooled(void);
+void *pht_alloc(size_t size);
+void *pht_calloc(size_t count, size_t size);
+void *pht_realloc(void *ptr, size_t size);
+void pht_free(void *ptr);
+void pht_alloc_stats(pht_alloc_stats_t *stats);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_ATOMIC_H
+#define PHT_ATOMIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Atomic counter operations, for values that are read far more often than they
+are modified, where taking a mutex would cost more than the operation itself.
+Decrements return the new value, with acquire-release ordering, so that the
+thread dropping the last reference sees all prior writes to the object.
+*/
+
+#ifdef PHP_WIN32
+# include <windows.h>
+typedef volatile LONG pht_atomic_t;
+# define pht_atomic_init(p, v) (*(p) = (v))
+# define pht_atomic_load(p) InterlockedCompareExchange((p), 0, 0)
+# define pht_atomic_inc(p) InterlockedIncrement(p)
+# define pht_atomic_dec(p) InterlockedDecrement(p)
+#else
+typedef volatile int32_t pht_atomic_t;
+# define pht_atomic_init(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+# define pht_atomic_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define pht_atomic_inc(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+# define pht_atomic_dec(p) __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+#endif
+
+/*
+Position counters for lock-free structures. Loads have acquire semantics, and
+stores have release semantics. The compare-and-swap evaluates to whether p held
+expected (and so was replaced with desired).
+*/
+
+#ifdef PHP_WIN32
+typedef volatile LONG_PTR pht_atomic_size_t;
+# define pht_atomic_size_load(p) ((size_t) InterlockedCompareExchangePointer((PVOID volatile *)(p), NULL, NULL))
+# define pht_atomic_size_store(p, v) InterlockedExchangePointer((PVOID volatile *)(p), (PVOID)(v))
+# define pht_atomic_size_cas(p, expected, desired) \
+    (InterlockedCompareExchangePointer((PVOID volatile *)(p), (PVOID)(desired), (PVOID)(expected)) == (PVOID)(expected))
+#else
+typedef volatile size_t pht_atomic_size_t;
+# define pht_atomic_size_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define pht_atomic_size_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+# define pht_atomic_size_cas(p, expected, desired) __sync_bool_compare_and_swap((p), (expected), (desired))
+#endif
+
+#endif
@@ -16,30 +16,34 @@
   +----------------------------------------------------------------------+
 */
 
+#include <Zend/zend_closures.h>
+#include <Zend/zend_execute.h>
+
 #include "php_pht.h"
 #include "src/pht_copy.h"
 #include "src/pht_zend.h"
 #include "src/classes/thread.h"
 
-static void copy_executor_globals(void);
+static void copy_executor_globals(pht_snapshot_t *snapshot);
 static zend_function *copy_function(zend_function *old_func, zend_class_entry *new_ce);
 static zend_function *copy_internal_function(zend_function *old_func);
 static zend_arg_info *copy_function_arg_info(zend_arg_info *old_arg_info, uint32_t fn_flags, uint32_t num_args);
 static zend_op *copy_zend_op(zend_op_array *new_op_array, zend_op_array *old_op_array);
 static zend_live_range *copy_zend_live_range(zend_live_range *old_live_range, uint32_t count);
 static zend_try_catch_element *copy_zend_try_catch_element(zend_try_catch_element *old_try_catch, uint32_t count);
-static HashTable *copy_static_variables(HashTable *old_static_variables);
-static void copy_zend_op_array(zend_op_array *new_op_array, zend_op_array *old_op_array, zend_class_entry *new_ce);
-static void copy_ini_directives(HashTable *new_ini_directives, HashTable *old_ini_directives);
-static void copy_included_files(HashTable *new_included_files, HashTable *old_included_files);
-static void copy_global_constants(HashTable *new_constants, HashTable *old_constants);
+static void copy_zend_op_array(zend_op_array *new_op_array, zend_op_array *old_op_array, zend_class_entry *new_ce, int share);
+static void copy_zend_literals(zend_op_array *new_op_array, zend_op_array *old_op_array);
+static void copy_ini_directives(HashTable *new_ini_directives, pht_snapshot_table_t *old_ini_directives);
+static void copy_included_files(HashTable *new_included_files, pht_snapshot_table_t *old_included_files);
+static void copy_global_constants(HashTable *new_constants, pht_snapshot_table_t *old_constants);
 static void copy_class_constants(HashTable *new_constants_table, HashTable *old_constants_table, zend_class_entry *new_ce);
 static void copy_class_constant(zend_class_constant *new_constant, zend_class_constant *old_constant, zend_class_entry *new_ce);
 static void copy_constant(zend_constant *new_constant, zend_constant *old_constant);
-static void copy_ces(HashTable *new_ces, HashTable *old_ces);
+static void copy_ces(pht_snapshot_table_t *old_ces);
 static zend_class_entry *copy_ce(zend_class_entry *old_ce);
 static zend_class_entry *create_new_ce(zend_class_entry *old_ce);
 static void copy_functions(HashTable *new_func_table, HashTable *old_func_table, zend_class_entry *new_ce);
+static void copy_user_functions(HashTable *new_func_table, pht_snapshot_table_t *old_funcs);
 static zend_trait_method_reference *copy_trait_method_reference(zend_trait_method_reference *method_reference);
 static zend_trait_precedence **copy_trait_precedences(zend_trait_precedence **old_tps);
 static zend_trait_alias **copy_trait_aliases(zend_trait_alias **old_tas);
@@ -51,12 +55,426 @@ static void copy_iterator_functions(zend_class_iterator_funcs *new_if, zend_clas
 static void copy_doc_comment(zend_string **new_doc_comment, zend_string *old_doc_comment);
 static void copy_properties_info(HashTable *new_properties_info, HashTable *old_properties_info, zend_class_entry *new_ce);
 
-void copy_execution_context(void)
+static Bucket *snapshot_source_last(HashTable *source)
+{
+    if (!source->nNumUsed || Z_TYPE(source->arData[source->nNumUsed - 1].val) == IS_UNDEF) {
+        return NULL;
+    }
+
+    return source->arData + source->nNumUsed - 1;
+}
+
+static void snapshot_table_init(pht_snapshot_table_t *table, HashTable *source)
+{
+    table->source_data = NULL;
+    table->source_used = 0;
+    table->source_size = 0;
+    table->source_next_index = 0;
+    table->source_last_key = NULL;
+    table->source_last_ptr = NULL;
+
+    if (source) {
+        Bucket *last = snapshot_source_last(source);
+
+        table->source_data = source->arData;
+        table->source_used = source->nNumUsed;
+        table->source_size = source->nNumOfElements;
+        table->source_next_index = source->nNextFreeElement;
+
+        if (last) {
+            table->source_last_key = last->key;
+            table->source_last_ptr = Z_TYPE(last->val) == IS_PTR ? Z_PTR(last->val) : NULL;
+        }
+    }
+
+    table->entries = malloc(sizeof(pht_snapshot_entry_t) * MAX(table->source_size, 1));
+    table->count = 0;
+}
+
+static void snapshot_table_add(pht_snapshot_table_t *table, zend_string *key, void *ptr)
+{
+    table->entries[table->count].key = key;
+    table->entries[table->count].ptr = ptr;
+    ++table->count;
+}
+
+/*
+Any insertion into a table either bumps its used bucket count or (when a full
+table with deleted buckets is compacted) rewrites its last bucket, and any
+deletion drops its element count. Comparing all of these (rather than just the
+element count) catches a deletion followed by an insertion, such as an
+ini_restore() followed by an ini_set().
+*/
+static int snapshot_table_stale(pht_snapshot_table_t *table, HashTable *source)
+{
+    if (!source) {
+        return table->source_data != NULL;
+    }
+
+    if (table->source_data != source->arData
+        || table->source_used != source->nNumUsed
+        || table->source_size != source->nNumOfElements
+        || table->source_next_index != source->nNextFreeElement) {
+        return 1;
+    }
+
+    Bucket *last = snapshot_source_last(source);
+
+    if (!last) {
+        return table->source_last_key != NULL || table->source_last_ptr != NULL;
+    }
+
+    return table->source_last_key != last->key
+        || table->source_last_ptr != (Z_TYPE(last->val) == IS_PTR ? Z_PTR(last->val) : NULL);
+}
+
+static HashTable *snapshot_lookup_create(pht_snapshot_table_t *table)
+{
+    HashTable *lookup = malloc(sizeof(HashTable));
+
+    zend_hash_init(lookup, table->count, NULL, NULL, 1);
+
+    for (uint32_t i = 0; i < table->count; ++i) {
+        zend_hash_str_add_ptr(lookup, ZSTR_VAL(table->entries[i].key), ZSTR_LEN(table->entries[i].key), table->entries[i].ptr);
+    }
+
+    return lookup;
+}
+
+static void snapshot_lookup_free(HashTable *lookup)
+{
+    if (lookup) {
+        zend_hash_destroy(lookup);
+        free(lookup);
+    }
+}
+
+static pht_snapshot_t *snapshot_create(void)
+{
+    pht_snapshot_t *snapshot = malloc(sizeof(pht_snapshot_t));
+    zend_string *key;
+    zend_function *func;
+    zend_class_entry *ce;
+    zend_constant *constant;
+    zend_ini_entry *ini_entry;
+
+    pthread_mutex_init(&snapshot->lock, NULL);
+    snapshot->refcount = 1;
+
+    // internal functions, classes, and constants are already registered in
+    // new threads on request startup, and so they are filtered out here
+    snapshot_table_init(&snapshot->functions, EG(function_table));
+
+    ZEND_HASH_FOREACH_STR_KEY_PTR(EG(function_table), key, func) {
+        if (func->type == ZEND_USER_FUNCTION) {
+            snapshot_table_add(&snapshot->functions, key, func);
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    snapshot_table_init(&snapshot->classes, CG(class_table));
+
+    ZEND_HASH_FOREACH_STR_KEY_PTR(CG(class_table), key, ce) {
+        if (ce->type == ZEND_USER_CLASS) {
+            snapshot_table_add(&snapshot->classes, key, ce);
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    snapshot_table_init(&snapshot->constants, EG(zend_constants));
+
+    ZEND_HASH_FOREACH_STR_KEY_PTR(EG(zend_constants), key, constant) {
+        if (constant->module_number == PHP_USER_CONSTANT) {
+            snapshot_table_add(&snapshot->constants, key, constant);
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    // only the directives changed at runtime can differ from a new thread's
+    snapshot_table_init(&snapshot->ini_directives, EG(modified_ini_directives));
+
+    if (EG(modified_ini_directives)) {
+        ZEND_HASH_FOREACH_STR_KEY_PTR(EG(modified_ini_directives), key, ini_entry) {
+            snapshot_table_add(&snapshot->ini_directives, key, ini_entry);
+        } ZEND_HASH_FOREACH_END();
+    }
+
+    snapshot_table_init(&snapshot->included_files, &EG(included_files));
+
+    ZEND_HASH_FOREACH_STR_KEY(&EG(included_files), key) {
+        snapshot_table_add(&snapshot->included_files, key, NULL);
+    } ZEND_HASH_FOREACH_END();
+
+    snapshot->function_lookup = NULL;
+    snapshot->class_lookup = NULL;
+
+    if (PHT_ZG(lazy_import)) {
+        // persistent, so that the keys are owned by the snapshot itself and
+        // may be freed by whichever thread releases it last
+        snapshot->function_lookup = snapshot_lookup_create(&snapshot->functions);
+        snapshot->class_lookup = snapshot_lookup_create(&snapshot->classes);
+    }
+
+    return snapshot;
+}
+
+static int snapshot_stale(pht_snapshot_t *snapshot)
+{
+    return snapshot_table_stale(&snapshot->functions, EG(function_table))
+        || snapshot_table_stale(&snapshot->classes, CG(class_table))
+        || snapshot_table_stale(&snapshot->constants, EG(zend_constants))
+        || snapshot_table_stale(&snapshot->ini_directives, EG(modified_ini_directives))
+        || snapshot_table_stale(&snapshot->included_files, &EG(included_files));
+}
+
+/*
+Fetches the current thread's snapshot, only rebuilding it if the current
+thread has since declared new functions, classes, constants, and so on.
+*/
+pht_snapshot_t *pht_snapshot_acquire(void)
+{
+    pht_snapshot_t *snapshot = PHT_ZG(snapshot);
+
+    if (snapshot && snapshot_stale(snapshot)) {
+        pht_snapshot_release(snapshot);
+        snapshot = NULL;
+    }
+
+    if (!snapshot) {
+        snapshot = PHT_ZG(snapshot) = snapshot_create();
+    }
+
+    pthread_mutex_lock(&snapshot->lock);
+    ++snapshot->refcount;
+    pthread_mutex_unlock(&snapshot->lock);
+
+    return snapshot;
+}
+
+void pht_snapshot_release(pht_snapshot_t *snapshot)
+{
+    int refcount;
+
+    pthread_mutex_lock(&snapshot->lock);
+    refcount = --snapshot->refcount;
+    pthread_mutex_unlock(&snapshot->lock);
+
+    if (refcount) {
+        return;
+    }
+
+    free(snapshot->functions.entries);
+    free(snapshot->classes.entries);
+    free(snapshot->constants.entries);
+    free(snapshot->ini_directives.entries);
+    free(snapshot->included_files.entries);
+    snapshot_lookup_free(snapshot->function_lookup);
+    snapshot_lookup_free(snapshot->class_lookup);
+    pthread_mutex_destroy(&snapshot->lock);
+    free(snapshot);
+}
+
+/*
+Lazy import mode (pht.lazy_import=1): rather than copying every user function
+and class into a new thread on startup, each is copied the first time it is
+referenced. Classes are imported through an autoloader that is prepended to the
+thread's SPL autoloader stack, and functions are imported through user opcode
+handlers for the function call initialisation opcodes.
+*/
+
+#if PHP_VERSION_ID >= 70300
+# define PHT_OP2_CONSTANT(opline) RT_CONSTANT(opline, (opline)->op2)
+# define PHT_FCALL_CACHED(opline, fname) CACHED_PTR((opline)->result.num)
+#else
+# define PHT_OP2_CONSTANT(opline) EX_CONSTANT((opline)->op2)
+# define PHT_FCALL_CACHED(opline, fname) CACHED_PTR(Z_CACHE_SLOT_P(fname))
+#endif
+
+static const zend_uchar lazy_import_opcodes[] = {ZEND_INIT_FCALL, ZEND_INIT_FCALL_BY_NAME, ZEND_INIT_NS_FCALL_BY_NAME};
+static user_opcode_handler_t lazy_import_prev_handlers[sizeof(lazy_import_opcodes)];
+static zend_internal_function lazy_import_autoloader;
+
+static int lazy_import_function_by_lcname(zend_string *lcname)
+{
+    zend_function *old_func;
+
+    if (zend_hash_exists(EG(function_table), lcname)) {
+        return 1;
+    }
+
+    old_func = zend_hash_str_find_ptr(PHT_ZG(import_snapshot)->function_lookup, ZSTR_VAL(lcname), ZSTR_LEN(lcname));
+
+    if (!old_func) {
+        return 0;
+    }
+
+    zend_string *new_func_name = zend_string_dup(lcname, 0);
+
+    zend_hash_add_ptr(EG(function_table), new_func_name, copy_function(old_func, NULL));
+    zend_string_release(new_func_name);
+
+    return 1;
+}
+
+void pht_lazy_import_function(zend_string *name)
+{
+    if (!PHT_ZG(import_snapshot)) {
+        return;
+    }
+
+    zend_string *lcname;
+
+    if (ZSTR_VAL(name)[0] == '\\') {
+        lcname = zend_string_alloc(ZSTR_LEN(name) - 1, 0);
+        zend_str_tolower_copy(ZSTR_VAL(lcname), ZSTR_VAL(name) + 1, ZSTR_LEN(name) - 1);
+    } else {
+        lcname = zend_string_tolower(name);
+    }
+
+    lazy_import_function_by_lcname(lcname);
+
+    zend_string_release(lcname);
+}
+
+static int lazy_import_fcall_handler(zend_execute_data *execute_data)
+{
+    const zend_op *opline = EX(opline);
+    int i = 0;
+
+    if (PHT_ZG(import_snapshot)) {
+        zval *fname = PHT_OP2_CONSTANT(opline);
+
+        // once resolved, the function is held in the run-time cache slot
+        if (!PHT_FCALL_CACHED(opline, fname)) {
+            switch (opline->opcode) {
+                case ZEND_INIT_FCALL:
+                    lazy_import_function_by_lcname(Z_STR_P(fname));
+                    break;
+                case ZEND_INIT_FCALL_BY_NAME:
+                    lazy_import_function_by_lcname(Z_STR_P(fname + 1));
+                    break;
+                case ZEND_INIT_NS_FCALL_BY_NAME:
+                    // the namespaced name, then the global fallback
+                    if (!lazy_import_function_by_lcname(Z_STR_P(fname + 1))) {
+                        lazy_import_function_by_lcname(Z_STR_P(fname + 2));
+                    }
+            }
+        }
+    }
+
+    while (lazy_import_opcodes[i] != opline->opcode) {
+        ++i;
+    }
+
+    if (lazy_import_prev_handlers[i]) {
+        return lazy_import_prev_handlers[i](execute_data);
+    }
+
+    return ZEND_USER_OPCODE_DISPATCH;
+}
+
+static ZEND_NAMED_FUNCTION(lazy_import_autoload)
+{
+    zend_string *name;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(name)
+    ZEND_PARSE_PARAMETERS_END();
+
+    zend_string *lcname = zend_string_tolower(name);
+    zend_class_entry *old_ce = zend_hash_str_find_ptr(PHT_ZG(import_snapshot)->class_lookup, ZSTR_VAL(lcname), ZSTR_LEN(lcname));
+
+    if (old_ce) {
+        copy_ce(old_ce); // registers the class (and its dependencies)
+    }
+
+    zend_string_release(lcname);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(lazy_import_autoload_arginfo, 0, 0, 1)
+    ZEND_ARG_INFO(0, class_name)
+ZEND_END_ARG_INFO()
+
+void pht_lazy_import_init(void)
+{
+    if (!PHT_ZG(lazy_import)) {
+        return;
+    }
+
+    // user opcode handlers are process-wide, and so must be set at MINIT
+    for (int i = 0; i < sizeof(lazy_import_opcodes); ++i) {
+        lazy_import_prev_handlers[i] = zend_get_user_opcode_handler(lazy_import_opcodes[i]);
+        zend_set_user_opcode_handler(lazy_import_opcodes[i], lazy_import_fcall_handler);
+    }
+
+    memset(&lazy_import_autoloader, 0, sizeof(zend_internal_function));
+
+    lazy_import_autoloader.type = ZEND_INTERNAL_FUNCTION;
+    lazy_import_autoloader.function_name = zend_string_init(ZEND_STRL("pht\\lazy_import_autoload"), 1);
+    lazy_import_autoloader.num_args = 1;
+    lazy_import_autoloader.required_num_args = 1;
+    lazy_import_autoloader.arg_info = (zend_internal_arg_info *) lazy_import_autoload_arginfo + 1;
+    lazy_import_autoloader.handler = lazy_import_autoload;
+}
+
+void pht_lazy_import_shutdown(void)
+{
+    if (!PHT_ZG(lazy_import)) {
+        return;
+    }
+
+    for (int i = 0; i < sizeof(lazy_import_opcodes); ++i) {
+        zend_set_user_opcode_handler(lazy_import_opcodes[i], lazy_import_prev_handlers[i]);
+    }
+
+    zend_string_free(lazy_import_autoloader.function_name);
+}
+
+static void lazy_import_startup(pht_snapshot_t *snapshot)
+{
+    zval autoloader, fname, retval, params[3];
+
+    // held until the thread's request shutdown, since symbols may be imported
+    // at any point up until then (including from destructors)
+    pthread_mutex_lock(&snapshot->lock);
+    ++snapshot->refcount;
+    pthread_mutex_unlock(&snapshot->lock);
+
+    PHT_ZG(import_snapshot) = snapshot;
+
+    // closures and conditionally declared functions are looked up by their
+    // runtime definition keys ("\0" prefixed) rather than through a function
+    // call, and so they are copied in eagerly
+    for (uint32_t i = 0; i < snapshot->functions.count; ++i) {
+        zend_string *key = snapshot->functions.entries[i].key;
+
+        if (ZSTR_LEN(key) && ZSTR_VAL(key)[0] == '\0' && !zend_hash_exists(EG(function_table), key)) {
+            zend_string *new_func_name = zend_string_dup(key, 0);
+
+            zend_hash_add_ptr(EG(function_table), new_func_name, copy_function(snapshot->functions.entries[i].ptr, NULL));
+            zend_string_release(new_func_name);
+        }
+    }
+
+    // prepended to the SPL stack so that userland autoloaders registered in
+    // the thread do not displace it
+    zend_create_closure(&autoloader, (zend_function *) &lazy_import_autoloader, NULL, NULL, NULL);
+    ZVAL_STRINGL(&fname, "spl_autoload_register", sizeof("spl_autoload_register") - 1);
+    ZVAL_COPY_VALUE(params, &autoloader);
+    ZVAL_TRUE(params + 1);
+    ZVAL_TRUE(params + 2);
+
+    if (call_user_function(EG(function_table), NULL, &fname, &retval, 3, params) == SUCCESS) {
+        zval_ptr_dtor(&retval);
+    }
+
+    zval_ptr_dtor(&fname);
+    zval_ptr_dtor(&autoloader);
+}
+
+void copy_execution_context(pht_snapshot_t *snapshot)
 {
-    copy_executor_globals();
+    copy_executor_globals(snapshot);
 }
 
-static void copy_executor_globals(void)
+static void copy_executor_globals(pht_snapshot_t *snapshot)
 {
     // unitialized_zval
     // error_zval
@@ -66,16 +484,21 @@ static void copy_executor_globals(void)
     // symtable_cache_ptr
 
     // symbol_table
-    copy_included_files(&EG(included_files), &PHT_EG(PHT_ZG(parent_thread_ls), included_files));
+    copy_included_files(&EG(included_files), &snapshot->included_files);
 
     // bailout
 
     // error_reporting
     // exit_status
 
-    copy_functions(EG(function_table), PHT_EG(PHT_ZG(parent_thread_ls), function_table), NULL);
-    copy_ces(EG(class_table), PHT_CG(PHT_ZG(parent_thread_ls), class_table));
-    copy_global_constants(EG(zend_constants), PHT_EG(PHT_ZG(parent_thread_ls), zend_constants));
+    if (PHT_ZG(lazy_import)) {
+        lazy_import_startup(snapshot);
+    } else {
+        copy_user_functions(EG(function_table), &snapshot->functions);
+        copy_ces(&snapshot->classes);
+    }
+
+    copy_global_constants(EG(zend_constants), &snapshot->constants);
 
     // vm_stack_top
     // vm_stack_end
@@ -119,7 +542,7 @@ static void copy_executor_globals(void)
 
     // lambda_count
 
-    copy_ini_directives(EG(ini_directives), PHT_EG(PHT_ZG(parent_thread_ls), ini_directives));
+    copy_ini_directives(EG(ini_directives), &snapshot->ini_directives);
     // modified_ini_directives
     // error_reporting_ini_entry
 
@@ -161,12 +584,55 @@ static zend_function *copy_function(zend_function *old_func, zend_class_entry *n
     if (old_func->type == ZEND_INTERNAL_FUNCTION) {
         new_func = copy_internal_function(old_func);
     } else {
-        new_func = copy_user_function(old_func, new_ce);
+        // functions copied from the parent thread's context may share its
+        // opcodes, since the parent thread outlives its child threads
+        new_func = zend_arena_alloc(&CG(arena), sizeof(zend_function));
+
+        copy_zend_op_array(&new_func->op_array, &old_func->op_array, new_ce, PHT_ZG(share_opcodes));
     }
 
     return new_func;
 }
 
+/*
+Immutable op array data may only be shared when it holds no refcounted values,
+since their refcounts would otherwise be modified from multiple threads.
+*/
+static int arg_info_shareable(zend_arg_info *arg_info, uint32_t fn_flags, uint32_t num_args)
+{
+    if (fn_flags & ZEND_ACC_HAS_RETURN_TYPE) {
+        --arg_info;
+        ++num_args;
+    }
+
+    if (fn_flags & ZEND_ACC_VARIADIC) {
+        ++num_args;
+    }
+
+    for (uint32_t i = 0; i < num_args; ++i) {
+        if (arg_info[i].name && !ZSTR_IS_INTERNED(arg_info[i].name)) {
+            return 0;
+        }
+
+        if (ZEND_TYPE_IS_CLASS(arg_info[i].type) && !ZSTR_IS_INTERNED(ZEND_TYPE_NAME(arg_info[i].type))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int literals_shareable(zend_op_array *op_array)
+{
+    for (int i = 0; i < op_array->last_literal; ++i) {
+        if (Z_REFCOUNTED(op_array->literals[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 static zend_arg_info *copy_function_arg_info(zend_arg_info *old_arg_info, uint32_t fn_flags, uint32_t num_args)
 {
     if (fn_flags & ZEND_ACC_HAS_RETURN_TYPE) {
@@ -237,7 +703,7 @@ static zend_try_catch_element *copy_zend_try_catch_element(zend_try_catch_elemen
     return new_try_catch;
 }
 
-static HashTable *copy_static_variables(HashTable *old_static_variables)
+HashTable *pht_copy_static_variables(HashTable *old_static_variables)
 {
     if (!old_static_variables) {
         return NULL;
@@ -292,8 +758,112 @@ static HashTable *copy_static_variables(HashTable *old_static_variables)
     return new_static_variables;
 }
 
-static void copy_zend_op_array(zend_op_array *new_op_array, zend_op_array *old_op_array, zend_class_entry *new_ce)
+/*
+A shared op array has no refcount, and so destroy_op_array() leaves behind the
+parts of it that were still copied for the thread. These are recorded when the
+op array is copied, and freed once the thread's function and class tables have
+been destroyed.
+*/
+typedef struct _shared_op_array_parts_t {
+    zend_string *function_name;
+    zend_string *doc_comment;
+    zval *literals; // NULL if shared
+    int last_literal;
+    zend_arg_info *arg_info; // NULL if shared (else the start of the allocation)
+    uint32_t num_arg_info;
+    zend_op *opcodes; // NULL if shared
+} shared_op_array_parts_t;
+
+static void shared_op_array_parts_free(void *data)
+{
+    shared_op_array_parts_t *parts = data;
+
+    zend_string_release(parts->function_name);
+
+    if (parts->doc_comment) {
+        zend_string_release(parts->doc_comment);
+    }
+
+    if (parts->literals) {
+        for (int i = 0; i < parts->last_literal; ++i) {
+            zval_ptr_dtor_nogc(parts->literals + i);
+        }
+
+        efree(parts->literals);
+    }
+
+    if (parts->arg_info) {
+        for (uint32_t i = 0; i < parts->num_arg_info; ++i) {
+            if (parts->arg_info[i].name) {
+                zend_string_release(parts->arg_info[i].name);
+            }
+
+            if (ZEND_TYPE_IS_CLASS(parts->arg_info[i].type)) {
+                zend_string_release(ZEND_TYPE_NAME(parts->arg_info[i].type));
+            }
+        }
+
+        efree(parts->arg_info);
+    }
+
+    if (parts->opcodes) {
+        efree(parts->opcodes);
+    }
+}
+
+void pht_shared_op_arrays_init(void)
+{
+    zend_llist_init(&PHT_ZG(shared_op_arrays), sizeof(shared_op_array_parts_t), shared_op_array_parts_free, 0);
+}
+
+void pht_shared_op_arrays_free(void)
+{
+    zend_llist_destroy(&PHT_ZG(shared_op_arrays));
+}
+
+static void shared_op_array_track(zend_op_array *op_array, int shared_literals, int shared_arg_info, int shared_opcodes)
 {
+    shared_op_array_parts_t parts;
+
+    parts.function_name = op_array->function_name;
+    parts.doc_comment = op_array->doc_comment;
+    parts.literals = shared_literals ? NULL : op_array->literals;
+    parts.last_literal = op_array->last_literal;
+    parts.arg_info = NULL;
+    parts.num_arg_info = 0;
+    parts.opcodes = shared_opcodes ? NULL : op_array->opcodes;
+
+    if (!shared_arg_info && op_array->arg_info) {
+        parts.arg_info = op_array->arg_info;
+        parts.num_arg_info = op_array->num_args;
+
+        if (op_array->fn_flags & ZEND_ACC_HAS_RETURN_TYPE) {
+            --parts.arg_info;
+            ++parts.num_arg_info;
+        }
+
+        if (op_array->fn_flags & ZEND_ACC_VARIADIC) {
+            ++parts.num_arg_info;
+        }
+    }
+
+    zend_llist_add_element(&PHT_ZG(shared_op_arrays), &parts);
+}
+
+/*
+When share is set, the read-only parts of the op array (opcodes, variable names,
+live ranges, try/catch elements, and, where possible, literals and arg info) are
+referenced rather than duplicated. The refcount is then left as NULL, so that
+destroy_op_array() will only free the per-thread mutable parts (the static
+variables and run-time cache), in the same way as for opcache's op arrays. The
+remaining per-thread parts are freed separately (see shared_op_array_track()).
+*/
+static void copy_zend_op_array(zend_op_array *new_op_array, zend_op_array *old_op_array, zend_class_entry *new_ce, int share)
+{
+    int share_literals = share && literals_shareable(old_op_array);
+    int share_arg_info = share && arg_info_shareable(old_op_array->arg_info, old_op_array->fn_flags, old_op_array->num_args);
+    int share_opcodes;
+
     new_op_array->type = old_op_array->type;
     memcpy(new_op_array->arg_flags, old_op_array->arg_flags, sizeof(zend_uchar) * 3);
     new_op_array->fn_flags = old_op_array->fn_flags;
@@ -302,20 +872,39 @@ static void copy_zend_op_array(zend_op_array *new_op_array, zend_op_array *old_o
     new_op_array->prototype = NULL;
     new_op_array->num_args = old_op_array->num_args;
     new_op_array->required_num_args = old_op_array->required_num_args;
-    new_op_array->arg_info = copy_function_arg_info(old_op_array->arg_info, old_op_array->fn_flags, old_op_array->num_args);
-    new_op_array->refcount = emalloc(sizeof(uint32_t));
-    *new_op_array->refcount = 1;
+
+    if (share_arg_info) {
+        new_op_array->arg_info = old_op_array->arg_info;
+    } else {
+        new_op_array->arg_info = copy_function_arg_info(old_op_array->arg_info, old_op_array->fn_flags, old_op_array->num_args);
+    }
+
+    if (share) {
+        new_op_array->refcount = NULL;
+    } else {
+        new_op_array->refcount = emalloc(sizeof(uint32_t));
+        *new_op_array->refcount = 1;
+    }
+
     new_op_array->last = old_op_array->last;
 
     new_op_array->last_var = old_op_array->last_var;
     new_op_array->T = old_op_array->T;
-    new_op_array->vars = emalloc(sizeof(zend_string *) * old_op_array->last_var);
-    memcpy(new_op_array->vars, old_op_array->vars, sizeof(zend_string *) * old_op_array->last_var);
     new_op_array->last_live_range = old_op_array->last_live_range;
     new_op_array->last_try_catch = old_op_array->last_try_catch;
-    new_op_array->live_range = copy_zend_live_range(old_op_array->live_range, old_op_array->last_live_range);
-    new_op_array->try_catch_array = copy_zend_try_catch_element(old_op_array->try_catch_array, old_op_array->last_try_catch);
-    new_op_array->static_variables = copy_static_variables(old_op_array->static_variables);
+
+    if (share) {
+        new_op_array->vars = old_op_array->vars;
+        new_op_array->live_range = old_op_array->live_range;
+        new_op_array->try_catch_array = old_op_array->try_catch_array;
+    } else {
+        new_op_array->vars = emalloc(sizeof(zend_string *) * old_op_array->last_var);
+        memcpy(new_op_array->vars, old_op_array->vars, sizeof(zend_string *) * old_op_array->last_var);
+        new_op_array->live_range = copy_zend_live_range(old_op_array->live_range, old_op_array->last_live_range);
+        new_op_array->try_catch_array = copy_zend_try_catch_element(old_op_array->try_catch_array, old_op_array->last_try_catch);
+    }
+
+    new_op_array->static_variables = pht_copy_static_variables(old_op_array->static_variables);
 
     if (!(new_op_array->filename = zend_hash_find_ptr(&PHT_ZG(op_array_file_names), old_op_array->filename))) {
         zend_string *filename = zend_string_dup(old_op_array->filename, 0);
@@ -329,6 +918,38 @@ static void copy_zend_op_array(zend_op_array *new_op_array, zend_op_array *old_o
     new_op_array->doc_comment = old_op_array->doc_comment ? zend_string_dup(old_op_array->doc_comment, 0) : NULL;
     new_op_array->early_binding = old_op_array->early_binding;
     new_op_array->last_literal = old_op_array->last_literal;
+
+    if (share_literals) {
+        new_op_array->literals = old_op_array->literals;
+    } else {
+        copy_zend_literals(new_op_array, old_op_array);
+    }
+
+#if PHP_VERSION_ID >= 70300 || ZEND_USE_ABS_CONST_ADDR
+    // literals are addressed relative to the opcodes from PHP 7.3 onwards
+    // (and absolutely on 32-bit builds), so opcodes must be copied with them
+    share_opcodes = share_literals;
+#else
+    share_opcodes = share;
+#endif
+
+    if (share_opcodes) {
+        new_op_array->opcodes = old_op_array->opcodes;
+    } else {
+        new_op_array->opcodes = copy_zend_op(new_op_array, old_op_array);
+    }
+
+    new_op_array->cache_size = old_op_array->cache_size;
+    new_op_array->run_time_cache = NULL;
+    memcpy(new_op_array->reserved, old_op_array->reserved, sizeof(void *) * ZEND_MAX_RESERVED_RESOURCES);
+
+    if (share) {
+        shared_op_array_track(new_op_array, share_literals, share_arg_info, share_opcodes);
+    }
+}
+
+static void copy_zend_literals(zend_op_array *new_op_array, zend_op_array *old_op_array)
+{
     new_op_array->literals = emalloc(sizeof(zval) * old_op_array->last_literal);
     memcpy(new_op_array->literals, old_op_array->literals, sizeof(zval) * old_op_array->last_literal);
 
@@ -345,19 +966,17 @@ static void copy_zend_op_array(zend_op_array *new_op_array, zend_op_array *old_o
                 ZVAL_NEW_AST(new_op_array->literals + i, pht_zend_ast_copy(Z_ASTVAL(new_op_array->literals[i])));
         }
     }
-
-    new_op_array->opcodes = copy_zend_op(new_op_array, old_op_array);
-
-    new_op_array->cache_size = old_op_array->cache_size;
-    new_op_array->run_time_cache = NULL;
-    memcpy(new_op_array->reserved, old_op_array->reserved, sizeof(void *) * ZEND_MAX_RESERVED_RESOURCES);
 }
 
+/*
+Used for closures passed between threads, which are always deep copied, since
+the thread they originated from may finish before the closure is used.
+*/
 zend_function *copy_user_function(zend_function *old_func, zend_class_entry *new_ce)
 {
     zend_function *new_func = zend_arena_alloc(&CG(arena), sizeof(zend_function));
 
-    copy_zend_op_array(&new_func->op_array, &old_func->op_array, new_ce);
+    copy_zend_op_array(&new_func->op_array, &old_func->op_array, new_ce, 0);
 
     return new_func;
 }
@@ -371,12 +990,11 @@ static zend_function *copy_internal_function(zend_function *old_func)
     return new_func;
 }
 
-static void copy_ini_directives(HashTable *new_ini_directives, HashTable *old_ini_directives)
+static void copy_ini_directives(HashTable *new_ini_directives, pht_snapshot_table_t *old_ini_directives)
 {
-    zend_ini_entry *old_ini_entry;
-    zend_string *ini_name;
-
-    ZEND_HASH_FOREACH_STR_KEY_PTR(old_ini_directives, ini_name, old_ini_entry) {
+    for (uint32_t i = 0; i < old_ini_directives->count; ++i) {
+        zend_string *ini_name = old_ini_directives->entries[i].key;
+        zend_ini_entry *old_ini_entry = old_ini_directives->entries[i].ptr;
         zend_ini_entry *new_ini_entry = zend_hash_find_ptr(new_ini_directives, ini_name);
 
         if (!new_ini_entry || !old_ini_entry->value || !new_ini_entry->value) {
@@ -413,28 +1031,25 @@ static void copy_ini_directives(HashTable *new_ini_directives, HashTable *old_in
         new_ini_entry->modifiable = modifiable;
 
         zend_string_release(new_ini_name);
-    } ZEND_HASH_FOREACH_END();
+    }
 }
 
-static void copy_included_files(HashTable *new_included_files, HashTable *old_included_files)
+static void copy_included_files(HashTable *new_included_files, pht_snapshot_table_t *old_included_files)
 {
-    zend_string *filename;
-
-    ZEND_HASH_FOREACH_STR_KEY(old_included_files, filename) {
-        zend_string *new_filename = zend_string_dup(filename, 0);
+    for (uint32_t i = 0; i < old_included_files->count; ++i) {
+        zend_string *new_filename = zend_string_dup(old_included_files->entries[i].key, 0);
 
         zend_hash_add_empty_element(new_included_files, new_filename);
 
         zend_string_release(new_filename);
-    } ZEND_HASH_FOREACH_END();
+    }
 }
 
-static void copy_global_constants(HashTable *new_constants, HashTable *old_constants)
+static void copy_global_constants(HashTable *new_constants, pht_snapshot_table_t *old_constants)
 {
-    zend_constant *old_constant;
-    zend_string *name;
-
-    ZEND_HASH_FOREACH_STR_KEY_PTR(old_constants, name, old_constant) {
+    for (uint32_t i = 0; i < old_constants->count; ++i) {
+        zend_string *name = old_constants->entries[i].key;
+        zend_constant *old_constant = old_constants->entries[i].ptr;
         zend_constant new_constant;
 
         // @todo constant && !STDIN, !STDOUT, !STDERR ?
@@ -455,7 +1070,7 @@ static void copy_global_constants(HashTable *new_constants, HashTable *old_const
         copy_constant(&new_constant, old_constant);
 
         zend_register_constant(&new_constant);
-    } ZEND_HASH_FOREACH_END();
+    }
 }
 
 static void copy_class_constants(HashTable *new_constants_table, HashTable *old_constants_table, zend_class_entry *new_ce)
@@ -492,23 +1107,11 @@ static void copy_constant(zend_constant *new_constant, zend_constant *old_consta
     new_constant->module_number = old_constant->module_number;
 }
 
-static void copy_ces(HashTable *new_ces, HashTable *old_ces)
+static void copy_ces(pht_snapshot_table_t *old_ces)
 {
-    zend_class_entry *old_ce;
-
-    ZEND_HASH_FOREACH_PTR(old_ces, old_ce) {
-        if (old_ce->type == ZEND_USER_CLASS) {
-            zend_class_entry *new_ce = copy_ce(old_ce);
-
-            if (new_ce) { // skip past anonymous classes
-                zend_string *new_ce_name = zend_string_tolower(old_ce->name); // ce names are interned
-
-                zend_hash_add_ptr(new_ces, new_ce_name, new_ce);
-
-                zend_string_release(new_ce_name);
-            }
-        }
-    } ZEND_HASH_FOREACH_END();
+    for (uint32_t i = 0; i < old_ces->count; ++i) {
+        copy_ce(old_ces->entries[i].ptr); // anonymous classes are skipped
+    }
 }
 
 static zend_class_entry *copy_ce(zend_class_entry *old_ce)
@@ -530,6 +1133,10 @@ static zend_class_entry *copy_ce(zend_class_entry *old_ce)
 
     if (!new_ce) {
         new_ce = create_new_ce(old_ce);
+
+        // registered straight away, so that classes sharing a parent,
+        // interface, or trait do not create duplicates of it
+        zend_hash_add_ptr(EG(class_table), new_ce_name, new_ce);
     }
 
     zend_string_release(new_ce_name);
@@ -608,28 +1215,29 @@ static void copy_functions(HashTable *new_func_table, HashTable *old_func_table,
     zend_function *old_func;
 
     ZEND_HASH_FOREACH_STR_KEY_PTR(old_func_table, old_func_name, old_func) {
-        if (new_ce) { // new_ce || old_func-type == ZEND_USER_FUNCTION ?
-            zend_string *new_func_name = zend_string_dup(old_func_name, 0);
-            zend_function *new_func = copy_function(old_func, new_ce);
+        zend_string *new_func_name = zend_string_dup(old_func_name, 0);
+        zend_function *new_func = copy_function(old_func, new_ce);
 
-            zend_hash_add_ptr(new_func_table, new_func_name, new_func);
-            zend_string_release(new_func_name);
-        } else {
-            // internal functions are already copied on php request startup into EG(function_table)
-            if (old_func->type == ZEND_USER_FUNCTION) {
-                zend_string *new_func_name = zend_string_dup(old_func_name, 0);
-                zend_function *new_func = copy_function(old_func, new_ce);
-
-                if (new_func) {
-                    if (!zend_hash_add_ptr(new_func_table, new_func_name, new_func)) {
-                        destroy_op_array((zend_op_array *) new_func);
-                    }
-                }
+        zend_hash_add_ptr(new_func_table, new_func_name, new_func);
+        zend_string_release(new_func_name);
+    } ZEND_HASH_FOREACH_END();
+}
 
-                zend_string_release(new_func_name);
+static void copy_user_functions(HashTable *new_func_table, pht_snapshot_table_t *old_funcs)
+{
+    // internal functions are already copied on php request startup into EG(function_table)
+    for (uint32_t i = 0; i < old_funcs->count; ++i) {
+        zend_string *new_func_name = zend_string_dup(old_funcs->entries[i].key, 0);
+        zend_function *new_func = copy_function(old_funcs->entries[i].ptr, NULL);
+
+        if (new_func) {
+            if (!zend_hash_add_ptr(new_func_table, new_func_name, new_func)) {
+                destroy_op_array((zend_op_array *) new_func);
             }
         }
-    } ZEND_HASH_FOREACH_END();
+
+        zend_string_release(new_func_name);
+    }
 }
 
 static void copy_properties_info(HashTable *new_properties_info, HashTable *old_properties_info, zend_class_entry *new_ce)
@@ -20,8 +20,53 @@
 #define PHT_COPY_H
 
 #include <main/php.h>
+#include <pthread.h>
 
-void copy_execution_context(void);
+typedef struct _pht_snapshot_entry_t {
+    zend_string *key;
+    void *ptr;
+} pht_snapshot_entry_t;
+
+typedef struct _pht_snapshot_table_t {
+    pht_snapshot_entry_t *entries;
+    uint32_t count;
+    // the state of the originating table, used to detect changes to it
+    Bucket *source_data;
+    uint32_t source_used;
+    uint32_t source_size;
+    zend_long source_next_index;
+    zend_string *source_last_key;
+    void *source_last_ptr;
+} pht_snapshot_table_t;
+
+/*
+An immutable record of the parts of a thread's execution context that need to
+be copied into new threads (only the user-defined parts). It is built once in
+the parent thread and shared by all threads started from it until the parent's
+tables change. The entries point into the parent thread's tables, which outlive
+any threads started from it.
+*/
+typedef struct _pht_snapshot_t {
+    pthread_mutex_t lock;
+    uint32_t refcount;
+    pht_snapshot_table_t functions;
+    pht_snapshot_table_t classes;
+    pht_snapshot_table_t constants;
+    pht_snapshot_table_t ini_directives;
+    pht_snapshot_table_t included_files;
+    HashTable *function_lookup; // lowercased name => function (lazy import mode only)
+    HashTable *class_lookup; // lowercased name => class entry (lazy import mode only)
+} pht_snapshot_t;
+
+pht_snapshot_t *pht_snapshot_acquire(void);
+void pht_snapshot_release(pht_snapshot_t *snapshot);
+void copy_execution_context(pht_snapshot_t *snapshot);
+HashTable *pht_copy_static_variables(HashTable *old_static_variables);
+void pht_shared_op_arrays_init(void);
+void pht_shared_op_arrays_free(void);
+void pht_lazy_import_init(void);
+void pht_lazy_import_shutdown(void);
+void pht_lazy_import_function(zend_string *name);
 zend_function *copy_user_function(zend_function *old_func, zend_class_entry *new_ce);
 
 #endif
@@ -0,0 +1,440 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <main/php.h>
+
+#include "src/pht_alloc.h"
+#include "src/pht_entry.h"
+#include "src/pht_encoding.h"
+
+/*
+A compact binary encoding for arrays of scalar values, used in place of the
+serialiser for passing arrays between threads. Each value is a one byte tag,
+followed by its payload:
+ - longs and doubles are stored as-is
+ - strings are stored as their length (a size_t) followed by their bytes
+ - packed lists are stored as their element count, followed by their values
+ - hash tables are stored as their element count, followed by each key (as a
+   long or string value) and its value
+ - Threaded objects are stored as the (raw) entry referencing them
+
+The whole array is written into a single allocation, sized up front.
+Arrays holding other objects or shared references cannot be encoded, and so
+the serialiser must be used for them instead.
+
+An encoding holding Threaded objects owns a reference to each of them, and so
+it must be released (or have its references duplicated when copied) with the
+functions below.
+*/
+
+#define PHT_ENC_NULL 0
+#define PHT_ENC_FALSE 1
+#define PHT_ENC_TRUE 2
+#define PHT_ENC_LONG 3
+#define PHT_ENC_DOUBLE 4
+#define PHT_ENC_STRING 5
+#define PHT_ENC_LIST 6
+#define PHT_ENC_HASH 7
+#define PHT_ENC_THREADED 8
+
+/*
+Threaded objects are converted into entries whilst the size of the encoding is
+being computed, so that any failure to convert them happens before anything
+has been written. The entries are then copied into the encoding in that order.
+*/
+typedef struct _threaded_entries_t {
+    pht_entry_t *entries;
+    uint32_t used;
+    uint32_t size;
+    uint32_t next;
+} threaded_entries_t;
+
+extern zend_class_entry *Threaded_ce;
+
+static int encoded_array_size(HashTable *ht, size_t *size, threaded_entries_t *te);
+static char *encode_array(char *p, HashTable *ht, threaded_entries_t *te);
+static const char *decode_value(zval *value, const char *p);
+
+static zend_always_inline int array_is_list(HashTable *ht)
+{
+    return HT_IS_PACKED(ht) && ht->nNumUsed == ht->nNumOfElements;
+}
+
+static int encoded_value_size(zval *value, size_t *size, threaded_entries_t *te)
+{
+    if (Z_TYPE_P(value) == IS_REFERENCE) {
+        // shared references would be split apart
+        if (Z_REFCOUNT_P(value) > 1) {
+            return 0;
+        }
+
+        value = Z_REFVAL_P(value);
+    }
+
+    switch (Z_TYPE_P(value)) {
+        case IS_NULL:
+        case IS_FALSE:
+        case IS_TRUE:
+            *size += 1;
+            return 1;
+        case IS_LONG:
+            *size += 1 + sizeof(zend_long);
+            return 1;
+        case IS_DOUBLE:
+            *size += 1 + sizeof(double);
+            return 1;
+        case IS_STRING:
+            *size += 1 + sizeof(size_t) + Z_STRLEN_P(value);
+            return 1;
+        case IS_ARRAY:
+            return encoded_array_size(Z_ARRVAL_P(value), size, te);
+        case IS_OBJECT:
+            if (!instanceof_function(Z_OBJCE_P(value), Threaded_ce)) {
+                return 0;
+            }
+
+            if (te->used == te->size) {
+                te->size = te->size ? te->size << 1 : 4;
+                te->entries = erealloc(te->entries, te->size * sizeof(pht_entry_t));
+            }
+
+            if (!pht_convert_zval_to_entry(te->entries + te->used, value)) {
+                return 0;
+            }
+
+            ++te->used;
+            *size += 1 + sizeof(pht_entry_t);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int encoded_array_size(HashTable *ht, size_t *size, threaded_entries_t *te)
+{
+    int is_list = array_is_list(ht);
+    zend_string *key;
+    zval *value;
+
+    *size += 1 + sizeof(uint32_t);
+
+    ZEND_HASH_FOREACH_STR_KEY_VAL(ht, key, value) {
+        if (!is_list) {
+            *size += key ? 1 + sizeof(size_t) + ZSTR_LEN(key) : 1 + sizeof(zend_long);
+        }
+
+        if (!encoded_value_size(value, size, te)) {
+            return 0;
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    return 1;
+}
+
+static zend_always_inline char *encode_long(char *p, zend_long l)
+{
+    *p++ = PHT_ENC_LONG;
+    memcpy(p, &l, sizeof(zend_long));
+
+    return p + sizeof(zend_long);
+}
+
+static zend_always_inline char *encode_string(char *p, const char *s, size_t len)
+{
+    *p++ = PHT_ENC_STRING;
+    memcpy(p, &len, sizeof(size_t));
+    memcpy(p + sizeof(size_t), s, len);
+
+    return p + sizeof(size_t) + len;
+}
+
+static char *encode_value(char *p, zval *value, threaded_entries_t *te)
+{
+    ZVAL_DEREF(value);
+
+    switch (Z_TYPE_P(value)) {
+        case IS_NULL:
+            *p++ = PHT_ENC_NULL;
+            break;
+        case IS_FALSE:
+            *p++ = PHT_ENC_FALSE;
+            break;
+        case IS_TRUE:
+            *p++ = PHT_ENC_TRUE;
+            break;
+        case IS_LONG:
+            p = encode_long(p, Z_LVAL_P(value));
+            break;
+        case IS_DOUBLE:
+            *p++ = PHT_ENC_DOUBLE;
+            memcpy(p, &Z_DVAL_P(value), sizeof(double));
+            p += sizeof(double);
+            break;
+        case IS_STRING:
+            p = encode_string(p, Z_STRVAL_P(value), Z_STRLEN_P(value));
+            break;
+        case IS_ARRAY:
+            p = encode_array(p, Z_ARRVAL_P(value), te);
+            break;
+        case IS_OBJECT:
+            *p++ = PHT_ENC_THREADED;
+            memcpy(p, te->entries + te->next++, sizeof(pht_entry_t));
+            p += sizeof(pht_entry_t);
+            break;
+        EMPTY_SWITCH_DEFAULT_CASE();
+    }
+
+    return p;
+}
+
+static char *encode_array(char *p, HashTable *ht, threaded_entries_t *te)
+{
+    int is_list = array_is_list(ht);
+    uint32_t count = zend_hash_num_elements(ht);
+    zend_ulong h;
+    zend_string *key;
+    zval *value;
+
+    *p++ = is_list ? PHT_ENC_LIST : PHT_ENC_HASH;
+    memcpy(p, &count, sizeof(uint32_t));
+    p += sizeof(uint32_t);
+
+    ZEND_HASH_FOREACH_KEY_VAL(ht, h, key, value) {
+        if (!is_list) {
+            p = key ? encode_string(p, ZSTR_VAL(key), ZSTR_LEN(key)) : encode_long(p, (zend_long) h);
+        }
+
+        p = encode_value(p, value, te);
+    } ZEND_HASH_FOREACH_END();
+
+    return p;
+}
+
+/*
+Returns the entry type for the encoded array: PHT_THREADED_ARRAY if it holds
+Threaded objects, and PHT_ARRAY otherwise. Returns 0 if the array holds values
+that cannot be encoded, leaving encoded untouched.
+*/
+int pht_encode_array(pht_string_t *encoded, HashTable *ht)
+{
+    threaded_entries_t te = {NULL, 0, 0, 0};
+    size_t size = 0;
+
+    if (!encoded_array_size(ht, &size, &te) || size > INT_MAX) {
+        for (uint32_t i = 0; i < te.used; ++i) {
+            pht_entry_delete_value(te.entries + i);
+        }
+
+        if (te.entries) {
+            efree(te.entries);
+        }
+
+        return 0;
+    }
+
+    PHT_STRL_P(encoded) = (int) size;
+    PHT_STRV_P(encoded) = pht_alloc(size);
+
+    encode_array(PHT_STRV_P(encoded), ht, &te);
+
+    if (te.entries) {
+        efree(te.entries);
+    }
+
+    return te.used ? PHT_THREADED_ARRAY : PHT_ARRAY;
+}
+
+static const char *decode_array(zval *value, const char *p, int is_list)
+{
+    uint32_t count;
+    zval element;
+
+    memcpy(&count, p, sizeof(uint32_t));
+    p += sizeof(uint32_t);
+
+    array_init_size(value, count);
+
+    if (is_list) {
+        zend_hash_real_init(Z_ARRVAL_P(value), 1);
+
+        ZEND_HASH_FILL_PACKED(Z_ARRVAL_P(value)) {
+            for (uint32_t i = 0; i < count; ++i) {
+                p = decode_value(&element, p);
+                ZEND_HASH_FILL_ADD(&element);
+            }
+        } ZEND_HASH_FILL_END();
+
+        return p;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        zend_long h;
+        size_t len;
+
+        if (*p++ == PHT_ENC_LONG) {
+            memcpy(&h, p, sizeof(zend_long));
+            p = decode_value(&element, p + sizeof(zend_long));
+            zend_hash_index_add_new(Z_ARRVAL_P(value), h, &element);
+        } else {
+            const char *key;
+
+            memcpy(&len, p, sizeof(size_t));
+            key = p + sizeof(size_t);
+            p = decode_value(&element, key + len);
+            zend_hash_str_add_new(Z_ARRVAL_P(value), key, len, &element);
+        }
+    }
+
+    return p;
+}
+
+static const char *decode_value(zval *value, const char *p)
+{
+    switch (*p++) {
+        case PHT_ENC_NULL:
+            ZVAL_NULL(value);
+            break;
+        case PHT_ENC_FALSE:
+            ZVAL_FALSE(value);
+            break;
+        case PHT_ENC_TRUE:
+            ZVAL_TRUE(value);
+            break;
+        case PHT_ENC_LONG:
+            {
+                zend_long l;
+
+                memcpy(&l, p, sizeof(zend_long));
+                ZVAL_LONG(value, l);
+                p += sizeof(zend_long);
+            }
+            break;
+        case PHT_ENC_DOUBLE:
+            {
+                double d;
+
+                memcpy(&d, p, sizeof(double));
+                ZVAL_DOUBLE(value, d);
+                p += sizeof(double);
+            }
+            break;
+        case PHT_ENC_STRING:
+            {
+                size_t len;
+
+                memcpy(&len, p, sizeof(size_t));
+                ZVAL_STRINGL(value, p + sizeof(size_t), len);
+                p += sizeof(size_t) + len;
+            }
+            break;
+        case PHT_ENC_LIST:
+            p = decode_array(value, p, 1);
+            break;
+        case PHT_ENC_HASH:
+            p = decode_array(value, p, 0);
+            break;
+        case PHT_ENC_THREADED:
+            {
+                pht_entry_t entry;
+
+                memcpy(&entry, p, sizeof(pht_entry_t));
+                pht_convert_entry_to_zval(value, &entry);
+                p += sizeof(pht_entry_t);
+            }
+            break;
+        EMPTY_SWITCH_DEFAULT_CASE();
+    }
+
+    return p;
+}
+
+void pht_decode_array(zval *value, pht_string_t *encoded)
+{
+    decode_value(value, PHT_STRV_P(encoded));
+}
+
+/*
+Calls visit with the position of each Threaded entry in the encoded value at p,
+returning the position after the value.
+*/
+static char *walk_value(char *p, void (*visit)(char *))
+{
+    uint32_t count;
+    size_t len;
+
+    switch (*p++) {
+        case PHT_ENC_LONG:
+            return p + sizeof(zend_long);
+        case PHT_ENC_DOUBLE:
+            return p + sizeof(double);
+        case PHT_ENC_STRING:
+            memcpy(&len, p, sizeof(size_t));
+            return p + sizeof(size_t) + len;
+        case PHT_ENC_LIST:
+        case PHT_ENC_HASH:
+            {
+                int is_list = p[-1] == PHT_ENC_LIST;
+
+                memcpy(&count, p, sizeof(uint32_t));
+                p += sizeof(uint32_t);
+
+                for (uint32_t i = 0; i < count; ++i) {
+                    if (!is_list) {
+                        p = walk_value(p, visit); // the key
+                    }
+
+                    p = walk_value(p, visit);
+                }
+            }
+            return p;
+        case PHT_ENC_THREADED:
+            visit(p);
+            return p + sizeof(pht_entry_t);
+        default:
+            return p;
+    }
+}
+
+static void threaded_entry_release(char *p)
+{
+    pht_entry_t entry;
+
+    memcpy(&entry, p, sizeof(pht_entry_t));
+    pht_entry_delete_value(&entry);
+}
+
+static void threaded_entry_addref(char *p)
+{
+    pht_entry_t src, dest;
+
+    memcpy(&src, p, sizeof(pht_entry_t));
+    pht_entry_clone(&dest, &src);
+    memcpy(p, &dest, sizeof(pht_entry_t));
+}
+
+// releases the references held by an encoding of type PHT_THREADED_ARRAY
+void pht_encoded_array_release(pht_string_t *encoded)
+{
+    walk_value(PHT_STRV_P(encoded), threaded_entry_release);
+}
+
+// takes new references for a copy of an encoding of type PHT_THREADED_ARRAY
+void pht_encoded_array_addref(pht_string_t *encoded)
+{
+    walk_value(PHT_STRV_P(encoded), threaded_entry_addref);
+}
@@ -0,0 +1,31 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_ENCODING_H
+#define PHT_ENCODING_H
+
+#include "Zend/zend.h"
+
+#include "src/pht_string.h"
+
+int pht_encode_array(pht_string_t *encoded, HashTable *ht);
+void pht_decode_array(zval *value, pht_string_t *encoded);
+void pht_encoded_array_release(pht_string_t *encoded);
+void pht_encoded_array_addref(pht_string_t *encoded);
+
+#endif
@@ -27,30 +27,147 @@
 #include <ext/standard/php_var.h>
 
 #include "php_pht.h"
+#include "src/pht_alloc.h"
 #include "src/pht_entry.h"
 #include "src/pht_copy.h"
 #include "src/pht_debug.h"
+#include "src/pht_encoding.h"
 
 extern zend_class_entry *Threaded_ce;
 
+void pht_closure_cache_entry_free(zval *zv)
+{
+    pht_closure_cache_entry_t *cce = Z_PTR_P(zv);
+
+    zend_string_release(cce->name);
+    efree(cce);
+}
+
+/*
+Closures created from the same declaration share their opcodes, but not their
+static variables (which hold the values bound with use). A cached function
+therefore has its static variables replaced with those of the closure being
+converted, since zend_create_closure() takes its own copy of them.
+*/
+static void closure_cache_refresh_statics(zend_function *func, zend_function *source)
+{
+    HashTable *static_variables = func->op_array.static_variables;
+
+    func->op_array.static_variables = pht_copy_static_variables(source->op_array.static_variables);
+
+    if (static_variables && !(GC_FLAGS(static_variables) & IS_ARRAY_IMMUTABLE)) {
+        if (--GC_REFCOUNT(static_variables) == 0) {
+            zend_array_destroy(static_variables);
+        }
+    }
+}
+
+/*
+Returns this thread's copy of the given closure's function, copying it only on
+the first request. The source op array's opcodes pointer is used as the key,
+and a few of its properties are checked to ensure that the address has not
+since been reused by a different function.
+
+The copied function is registered in the function table (so that it is freed
+upon shutdown). Evicting it from there only releases the function table's
+reference, so closures created from it remain valid.
+*/
+static zend_function *closure_cache_fetch(zend_function *source)
+{
+    zend_ulong key = (zend_ulong) source->op_array.opcodes;
+    pht_closure_cache_entry_t *cce = zend_hash_index_find_ptr(&PHT_ZG(closure_cache), key);
+
+    if (cce) {
+        if (EXPECTED(cce->source_filename == source->op_array.filename
+            && cce->source_last == source->op_array.last
+            && cce->source_line_start == source->op_array.line_start)) {
+            if (source->op_array.static_variables || cce->func->op_array.static_variables) {
+                closure_cache_refresh_statics(cce->func, source);
+            }
+
+            return cce->func;
+        }
+
+        zend_hash_del(EG(function_table), cce->name);
+        zend_hash_index_del(&PHT_ZG(closure_cache), key);
+    }
+
+    if (zend_hash_num_elements(&PHT_ZG(closure_cache)) >= PHT_CLOSURE_CACHE_SIZE) {
+        zend_ulong oldest_key;
+        pht_closure_cache_entry_t *oldest;
+
+        ZEND_HASH_FOREACH_NUM_KEY_PTR(&PHT_ZG(closure_cache), oldest_key, oldest) {
+            zend_hash_del(EG(function_table), oldest->name);
+            zend_hash_index_del(&PHT_ZG(closure_cache), oldest_key);
+            break;
+        } ZEND_HASH_FOREACH_END();
+    }
+
+    cce = emalloc(sizeof(pht_closure_cache_entry_t));
+    cce->func = copy_user_function(source, NULL);
+    cce->name = strpprintf(0, "Closure@%p", cce->func);
+    cce->source_filename = source->op_array.filename;
+    cce->source_last = source->op_array.last;
+    cce->source_line_start = source->op_array.line_start;
+
+    if (!zend_hash_update_ptr(EG(function_table), cce->name, cce->func)) {
+        zend_string_release(cce->name);
+        efree(cce);
+        return NULL;
+    }
+
+    zend_hash_index_add_new_ptr(&PHT_ZG(closure_cache), key, cce);
+
+    return cce->func;
+}
+
 void pht_entry_delete(void *entry_void)
 {
     pht_entry_t *entry = entry_void;
 
-    pht_entry_delete_value(entry);
+    if (!PHT_ENTRY_IS_NUMERIC(entry)) {
+        pht_entry_delete_value(entry);
+    }
 
-    free(entry);
+    pht_free(entry);
 }
 
 void pht_entry_delete_value(pht_entry_t *entry)
 {
     switch (PHT_ENTRY_TYPE(entry)) {
         case PHT_STORE_FUNC:
-            free(PHT_ENTRY_FUNC(entry));
+            pht_free(PHT_ENTRY_FUNC(entry));
             break;
-        case IS_ARRAY:
         case IS_STRING:
-            free(PHT_STRV(PHT_ENTRY_STRING(entry)));
+            // the payload of entries from pht_create_entry_from_zval() may share their allocation
+            if (PHT_STRV(PHT_ENTRY_STRING(entry)) == (char *)(entry + 1)) {
+                break;
+            }
+            // fallthrough
+        case PHT_ARRAY:
+        case IS_ARRAY:
+        case IS_OBJECT:
+            pht_free(PHT_STRV(PHT_ENTRY_STRING(entry)));
+            break;
+        case PHT_THREADED_ARRAY:
+            pht_encoded_array_release(&PHT_ENTRY_STRING(entry));
+            pht_free(PHT_STRV(PHT_ENTRY_STRING(entry)));
+            break;
+        case PHT_SHARED_STRING:
+            pht_shared_string_release(PHT_ENTRY_SS(entry));
+            break;
+        case PHT_IMMUTABLE_ARRAY:
+            iaoi_release(PHT_ENTRY_IA(entry).iaoi);
+            break;
+        case PHT_NUMERIC_VECTOR:
+            nvoi_release(PHT_ENTRY_NV(entry));
+            break;
+        case PHT_BUFFER:
+            boi_release(PHT_ENTRY_BUF(entry).boi);
+            pht_free(PHT_ENTRY_BUF(entry).slice);
+            break;
+        case PHT_CONCURRENT_QUEUE:
+            cqoi_release(PHT_ENTRY_CQ(entry));
             break;
         case PHT_QUEUE:
             pthread_mutex_lock(&PHT_ENTRY_Q(entry)->lock);
@@ -90,18 +207,86 @@ void pht_entry_delete_value(pht_entry_t *entry)
     }
 }
 
+/*
+Creates an independent copy of src in dest, so that each may be deleted
+separately. This is cheaper than converting the originating zval again.
+*/
+void pht_entry_clone(pht_entry_t *dest, pht_entry_t *src)
+{
+    *dest = *src;
+
+    switch (PHT_ENTRY_TYPE(src)) {
+        case PHT_STORE_FUNC:
+            PHT_ENTRY_FUNC(dest) = pht_alloc(sizeof(zend_op_array));
+            memcpy(PHT_ENTRY_FUNC(dest), PHT_ENTRY_FUNC(src), sizeof(zend_op_array));
+            break;
+        case PHT_ARRAY:
+        case IS_ARRAY:
+        case IS_OBJECT:
+        case IS_STRING:
+            PHT_STRV(PHT_ENTRY_STRING(dest)) = pht_alloc(PHT_STRL(PHT_ENTRY_STRING(src)));
+            memcpy(PHT_STRV(PHT_ENTRY_STRING(dest)), PHT_STRV(PHT_ENTRY_STRING(src)), PHT_STRL(PHT_ENTRY_STRING(src)));
+            break;
+        case PHT_THREADED_ARRAY:
+            PHT_STRV(PHT_ENTRY_STRING(dest)) = pht_alloc(PHT_STRL(PHT_ENTRY_STRING(src)));
+            memcpy(PHT_STRV(PHT_ENTRY_STRING(dest)), PHT_STRV(PHT_ENTRY_STRING(src)), PHT_STRL(PHT_ENTRY_STRING(src)));
+            pht_encoded_array_addref(&PHT_ENTRY_STRING(dest));
+            break;
+        case PHT_SHARED_STRING:
+            pht_shared_string_addref(PHT_ENTRY_SS(src));
+            break;
+        case PHT_IMMUTABLE_ARRAY:
+            iaoi_addref(PHT_ENTRY_IA(src).iaoi);
+            break;
+        case PHT_NUMERIC_VECTOR:
+            nvoi_addref(PHT_ENTRY_NV(src));
+            break;
+        case PHT_BUFFER:
+            boi_addref(PHT_ENTRY_BUF(src).boi);
+            PHT_ENTRY_BUF(dest).slice = buffer_slice_copy(PHT_ENTRY_BUF(src).slice);
+            break;
+        case PHT_CONCURRENT_QUEUE:
+            cqoi_addref(PHT_ENTRY_CQ(src));
+            break;
+        case PHT_QUEUE:
+            pthread_mutex_lock(&PHT_ENTRY_Q(src)->lock);
+            ++PHT_ENTRY_Q(src)->refcount;
+            pthread_mutex_unlock(&PHT_ENTRY_Q(src)->lock);
+            break;
+        case PHT_HASH_TABLE:
+            pthread_mutex_lock(&PHT_ENTRY_HT(src)->lock);
+            ++PHT_ENTRY_HT(src)->refcount;
+            pthread_mutex_unlock(&PHT_ENTRY_HT(src)->lock);
+            break;
+        case PHT_VECTOR:
+            pthread_mutex_lock(&PHT_ENTRY_V(src)->lock);
+            ++PHT_ENTRY_V(src)->refcount;
+            pthread_mutex_unlock(&PHT_ENTRY_V(src)->lock);
+            break;
+        case PHT_ATOMIC_INTEGER:
+            pthread_mutex_lock(&PHT_ENTRY_AI(src)->lock);
+            ++PHT_ENTRY_AI(src)->refcount;
+            pthread_mutex_unlock(&PHT_ENTRY_AI(src)->lock);
+    }
+}
+
 void pht_convert_entry_to_zval(zval *value, pht_entry_t *e)
 {
+    // counters and IDs are the most common values, so they skip the switch
+    if (EXPECTED(PHT_ENTRY_TYPE(e) == IS_LONG)) {
+        ZVAL_LONG(value, PHT_ENTRY_LONG(e));
+        return;
+    }
+
+    if (EXPECTED(PHT_ENTRY_TYPE(e) == IS_DOUBLE)) {
+        ZVAL_DOUBLE(value, PHT_ENTRY_DOUBLE(e));
+        return;
+    }
+
     switch (PHT_ENTRY_TYPE(e)) {
         case IS_STRING:
             ZVAL_STR(value, zend_string_init(PHT_STRV(PHT_ENTRY_STRING(e)), PHT_STRL(PHT_ENTRY_STRING(e)), 0));
             break;
-        case IS_LONG:
-            ZVAL_LONG(value, PHT_ENTRY_LONG(e));
-            break;
-        case IS_DOUBLE:
-            ZVAL_DOUBLE(value, PHT_ENTRY_DOUBLE(e));
-            break;
         case _IS_BOOL:
             ZVAL_BOOL(value, PHT_ENTRY_BOOL(e));
             break;
@@ -114,6 +299,28 @@ void pht_convert_entry_to_zval(zval *value, pht_entry_t *e)
         case IS_NULL:
             ZVAL_NULL(value);
             break;
+        case PHT_ARRAY:
+        case PHT_THREADED_ARRAY:
+            pht_decode_array(value, &PHT_ENTRY_STRING(e));
+            break;
+        case PHT_INLINE_STRING:
+            ZVAL_STRINGL(value, PHT_ENTRY_INLINE_STRING(e).val, PHT_ENTRY_INLINE_STRING(e).len);
+            break;
+        case PHT_SHARED_STRING:
+            ZVAL_STR(value, pht_shared_string_copy(&PHT_ENTRY_SS(e)->str));
+            break;
+        case PHT_IMMUTABLE_ARRAY:
+            immutable_array_view_create(value, PHT_ENTRY_IA(e).iaoi, PHT_ENTRY_IA(e).node);
+            break;
+        case PHT_NUMERIC_VECTOR:
+            numeric_vector_wrap(value, PHT_ENTRY_NV(e));
+            break;
+        case PHT_BUFFER:
+            buffer_wrap(value, PHT_ENTRY_BUF(e).boi, PHT_ENTRY_BUF(e).slice);
+            break;
+        case PHT_CONCURRENT_QUEUE:
+            concurrent_queue_wrap(value, PHT_ENTRY_CQ(e));
+            break;
         case IS_ARRAY:
             {
                 size_t buf_len = PHT_STRL(PHT_ENTRY_STRING(e));
@@ -131,18 +338,14 @@ void pht_convert_entry_to_zval(zval *value, pht_entry_t *e)
             break;
         case PHT_STORE_FUNC:
             {
-                zend_function *closure = copy_user_function(PHT_ENTRY_FUNC(e), NULL);
-                char *name;
-                size_t name_len;
-
-                zend_create_closure(value, closure, zend_get_executed_scope(), closure->common.scope, NULL);
-                name_len = spprintf(&name, 0, "Closure@%p", zend_get_closure_method_def(value));
+                zend_function *closure = closure_cache_fetch(PHT_ENTRY_FUNC(e));
 
-                if (!zend_hash_str_update_ptr(EG(function_table), name, name_len, closure)) {
+                if (!closure) {
                     zend_throw_exception(zend_ce_exception, "Failed to deserialise the closure", 0);
+                    break;
                 }
 
-                efree(name);
+                zend_create_closure(value, closure, zend_get_executed_scope(), closure->common.scope, NULL);
             }
             break;
         case PHT_QUEUE:
@@ -272,8 +475,21 @@ int pht_convert_zval_to_entry(pht_entry_t *e, zval *value)
 
     switch (Z_TYPE_P(value)) {
         case IS_STRING:
+            if (ZSTR_LEN(Z_STR_P(value)) >= PHT_SHARED_STRING_MIN_LEN) {
+                PHT_ENTRY_TYPE(e) = PHT_SHARED_STRING;
+                PHT_ENTRY_SS(e) = pht_shared_string_create(Z_STR_P(value));
+                break;
+            }
+
+            if (ZSTR_LEN(Z_STR_P(value)) <= PHT_ENTRY_INLINE_MAX) {
+                PHT_ENTRY_TYPE(e) = PHT_INLINE_STRING;
+                PHT_ENTRY_INLINE_STRING(e).len = (unsigned char) ZSTR_LEN(Z_STR_P(value));
+                memcpy(PHT_ENTRY_INLINE_STRING(e).val, ZSTR_VAL(Z_STR_P(value)), ZSTR_LEN(Z_STR_P(value)));
+                break;
+            }
+
             PHT_STRL(PHT_ENTRY_STRING(e)) = ZSTR_LEN(Z_STR_P(value));
-            PHT_STRV(PHT_ENTRY_STRING(e)) = malloc(PHT_STRL(PHT_ENTRY_STRING(e)));
+            PHT_STRV(PHT_ENTRY_STRING(e)) = pht_alloc(PHT_STRL(PHT_ENTRY_STRING(e)));
             memcpy(PHT_STRV(PHT_ENTRY_STRING(e)), ZSTR_VAL(Z_STR_P(value)), sizeof(char) * PHT_STRL(PHT_ENTRY_STRING(e)));
             break;
         case IS_LONG:
@@ -294,6 +510,16 @@ int pht_convert_zval_to_entry(pht_entry_t *e, zval *value)
         case IS_NULL:
             break;
         case IS_ARRAY:
+            {
+                int type = pht_encode_array(&PHT_ENTRY_STRING(e), Z_ARRVAL_P(value));
+
+                if (type) {
+                    PHT_ENTRY_TYPE(e) = type;
+                    break;
+                }
+            }
+
+            // arrays holding other objects or shared references fall back to the serialiser
             {
                 smart_str smart = {0};
                 php_serialize_data_t vars;
@@ -310,7 +536,7 @@ int pht_convert_zval_to_entry(pht_entry_t *e, zval *value)
                 zend_string *sval = smart_str_extract(&smart);
 
                 PHT_STRL(PHT_ENTRY_STRING(e)) = ZSTR_LEN(sval);
-                PHT_STRV(PHT_ENTRY_STRING(e)) = malloc(ZSTR_LEN(sval));
+                PHT_STRV(PHT_ENTRY_STRING(e)) = pht_alloc(ZSTR_LEN(sval));
                 memcpy(PHT_STRV(PHT_ENTRY_STRING(e)), ZSTR_VAL(sval), ZSTR_LEN(sval));
 
                 zend_string_free(sval);
@@ -320,7 +546,7 @@ int pht_convert_zval_to_entry(pht_entry_t *e, zval *value)
             {
                 if (instanceof_function(Z_OBJCE_P(value), zend_ce_closure)) {
                     PHT_ENTRY_TYPE(e) = PHT_STORE_FUNC;
-                    PHT_ENTRY_FUNC(e) = malloc(sizeof(zend_op_array));
+                    PHT_ENTRY_FUNC(e) = pht_alloc(sizeof(zend_op_array));
                     memcpy(PHT_ENTRY_FUNC(e), zend_get_closure_method_def(value), sizeof(zend_op_array));
                 } else if (instanceof_function(Z_OBJCE_P(value), Threaded_ce)) {
                     if (instanceof_function(Z_OBJCE_P(value), Queue_ce)) {
@@ -359,6 +585,53 @@ int pht_convert_zval_to_entry(pht_entry_t *e, zval *value)
                         pthread_mutex_lock(&aio->aioi->lock);
                         ++aio->aioi->refcount;
                         pthread_mutex_unlock(&aio->aioi->lock);
+                    } else if (instanceof_function(Z_OBJCE_P(value), ImmutableArray_ce)) {
+                        immutable_array_obj_t *iao = (immutable_array_obj_t *)((char *)Z_OBJ_P(value) - Z_OBJ_P(value)->handlers->offset);
+
+                        if (!iao->iaoi) {
+                            return 0;
+                        }
+
+                        PHT_ENTRY_TYPE(e) = PHT_IMMUTABLE_ARRAY;
+                        PHT_ENTRY_IA(e).iaoi = iao->iaoi;
+                        PHT_ENTRY_IA(e).node = iao->node;
+
+                        iaoi_addref(iao->iaoi);
+                    } else if (instanceof_function(Z_OBJCE_P(value), IntVector_ce)
+                        || instanceof_function(Z_OBJCE_P(value), FloatVector_ce)) {
+                        numeric_vector_obj_t *nvo = (numeric_vector_obj_t *)((char *)Z_OBJ_P(value) - Z_OBJ_P(value)->handlers->offset);
+
+                        if (!nvo->nvoi) {
+                            return 0;
+                        }
+
+                        PHT_ENTRY_TYPE(e) = PHT_NUMERIC_VECTOR;
+                        PHT_ENTRY_NV(e) = nvo->nvoi;
+
+                        nvoi_addref(nvo->nvoi);
+                    } else if (instanceof_function(Z_OBJCE_P(value), Buffer_ce)) {
+                        buffer_obj_t *bo = (buffer_obj_t *)((char *)Z_OBJ_P(value) - Z_OBJ_P(value)->handlers->offset);
+
+                        if (!bo->boi) {
+                            return 0;
+                        }
+
+                        PHT_ENTRY_TYPE(e) = PHT_BUFFER;
+                        PHT_ENTRY_BUF(e).boi = bo->boi;
+                        PHT_ENTRY_BUF(e).slice = buffer_slice_copy(bo->slice);
+
+                        boi_addref(bo->boi);
+                    } else if (instanceof_function(Z_OBJCE_P(value), ConcurrentQueue_ce)) {
+                        concurrent_queue_obj_t *cqo = (concurrent_queue_obj_t *)((char *)Z_OBJ_P(value) - Z_OBJ_P(value)->handlers->offset);
+
+                        if (!cqo->cqoi) {
+                            return 0;
+                        }
+
+                        PHT_ENTRY_TYPE(e) = PHT_CONCURRENT_QUEUE;
+                        PHT_ENTRY_CQ(e) = cqo->cqoi;
+
+                        cqoi_addref(cqo->cqoi);
                     } else {
                         assert(0);
                     }
@@ -379,7 +652,7 @@ int pht_convert_zval_to_entry(pht_entry_t *e, zval *value)
                     zend_string *sval = smart_str_extract(&smart);
 
                     PHT_STRL(PHT_ENTRY_STRING(e)) = ZSTR_LEN(sval);
-                    PHT_STRV(PHT_ENTRY_STRING(e)) = malloc(ZSTR_LEN(sval));
+                    PHT_STRV(PHT_ENTRY_STRING(e)) = pht_alloc(ZSTR_LEN(sval));
                     memcpy(PHT_STRV(PHT_ENTRY_STRING(e)), ZSTR_VAL(sval), ZSTR_LEN(sval));
 
                     zend_string_free(sval);
@@ -395,13 +668,45 @@ int pht_convert_zval_to_entry(pht_entry_t *e, zval *value)
 
 pht_entry_t *pht_create_entry_from_zval(zval *value)
 {
-    pht_entry_t *e = malloc(sizeof(pht_entry_t));
+    pht_entry_t *e;
+
+    if (EXPECTED(Z_TYPE_P(value) == IS_LONG)) {
+        e = pht_alloc(sizeof(pht_entry_t));
+        PHT_ENTRY_TYPE(e) = IS_LONG;
+        PHT_ENTRY_LONG(e) = Z_LVAL_P(value);
+
+        return e;
+    }
+
+    if (EXPECTED(Z_TYPE_P(value) == IS_DOUBLE)) {
+        e = pht_alloc(sizeof(pht_entry_t));
+        PHT_ENTRY_TYPE(e) = IS_DOUBLE;
+        PHT_ENTRY_DOUBLE(e) = Z_DVAL_P(value);
+
+        return e;
+    }
+
+    // medium-sized strings are given a single allocation for the entry and its payload
+    if (Z_TYPE_P(value) == IS_STRING
+        && Z_STRLEN_P(value) > PHT_ENTRY_INLINE_MAX
+        && Z_STRLEN_P(value) < PHT_SHARED_STRING_MIN_LEN) {
+        e = pht_alloc(sizeof(pht_entry_t) + Z_STRLEN_P(value));
+
+        PHT_ENTRY_TYPE(e) = IS_STRING;
+        PHT_STRL(PHT_ENTRY_STRING(e)) = Z_STRLEN_P(value);
+        PHT_STRV(PHT_ENTRY_STRING(e)) = (char *)(e + 1);
+        memcpy(PHT_STRV(PHT_ENTRY_STRING(e)), Z_STRVAL_P(value), Z_STRLEN_P(value));
+
+        return e;
+    }
+
+    e = pht_alloc(sizeof(pht_entry_t));
 
     if (pht_convert_zval_to_entry(e, value)) {
         return e;
     }
 
-    free(e);
+    pht_free(e);
 
     return NULL;
 }
@@ -22,49 +22,105 @@
 #include "Zend/zend.h"
 
 #include "src/pht_string.h"
+#include "src/pht_shared_string.h"
 #include "src/classes/queue.h"
 #include "src/classes/hashtable.h"
 #include "src/classes/vector.h"
 #include "src/classes/atomic_integer.h"
+#include "src/classes/immutable_array.h"
+#include "src/classes/numeric_vector.h"
+#include "src/classes/buffer.h"
+#include "src/classes/concurrent_queue.h"
+
+// strings up to this length are stored inline, without a separate allocation
+#define PHT_ENTRY_INLINE_MAX (sizeof(pht_string_t) - 1)
 
 typedef struct _pht_entry_t {
     int type;
     union {
         int boolean;
-        int integer;
+        zend_long integer;
         double floating;
         pht_string_t string;
+        struct {
+            unsigned char len;
+            char val[PHT_ENTRY_INLINE_MAX];
+        } inline_string;
+        pht_shared_string_t *shared_string;
         zend_function *func;
         queue_obj_internal_t *queue;
         hashtable_obj_internal_t *hash_table;
         vector_obj_internal_t *vector;
         atomic_integer_obj_internal_t *atomic_integer;
+        struct {
+            immutable_array_obj_internal_t *iaoi;
+            uint32_t node;
+        } immutable_array;
+        numeric_vector_obj_internal_t *numeric_vector;
+        struct {
+            buffer_obj_internal_t *boi;
+            buffer_slice_t *slice;
+        } buffer;
+        concurrent_queue_obj_internal_t *concurrent_queue;
         // array
         // object
     } val;
 } pht_entry_t;
 
+/*
+Closures materialised in a thread are cached by the opcodes of the op array
+they were copied from, so that the same closure is only copied once per thread.
+*/
+typedef struct _pht_closure_cache_entry_t {
+    zend_function *func;
+    zend_string *name;
+    const zend_string *source_filename;
+    uint32_t source_last;
+    uint32_t source_line_start;
+} pht_closure_cache_entry_t;
+
+#define PHT_CLOSURE_CACHE_SIZE 64
+
 #define PHT_STORE_FUNC 100
 #define PHT_QUEUE 101
 #define PHT_HASH_TABLE 102
 #define PHT_VECTOR 103
 #define PHT_ATOMIC_INTEGER 104
+#define PHT_ARRAY 105 // an array in the binary encoding of pht_encoding.c
+#define PHT_SHARED_STRING 106
+#define PHT_IMMUTABLE_ARRAY 107
+#define PHT_INLINE_STRING 108
+#define PHT_NUMERIC_VECTOR 109
+#define PHT_BUFFER 110
+#define PHT_THREADED_ARRAY 111 // a PHT_ARRAY holding references to Threaded objects
+#define PHT_CONCURRENT_QUEUE 112
 
 #define PHT_ENTRY_TYPE(s) (s)->type
 #define PHT_ENTRY_STRING(s) (s)->val.string
+#define PHT_ENTRY_INLINE_STRING(s) (s)->val.inline_string
 #define PHT_ENTRY_LONG(s) (s)->val.integer
 #define PHT_ENTRY_DOUBLE(s) (s)->val.floating
 #define PHT_ENTRY_BOOL(s) (s)->val.boolean
+#define PHT_ENTRY_SS(s) (s)->val.shared_string
 #define PHT_ENTRY_FUNC(s) (s)->val.func
 #define PHT_ENTRY_Q(s) (s)->val.queue
 #define PHT_ENTRY_HT(s) (s)->val.hash_table
 #define PHT_ENTRY_V(s) (s)->val.vector
 #define PHT_ENTRY_AI(s) (s)->val.atomic_integer
+#define PHT_ENTRY_IA(s) (s)->val.immutable_array
+#define PHT_ENTRY_NV(s) (s)->val.numeric_vector
+#define PHT_ENTRY_BUF(s) (s)->val.buffer
+#define PHT_ENTRY_CQ(s) (s)->val.concurrent_queue
+
+// whether the entry holds a long or a double (which own no resources)
+#define PHT_ENTRY_IS_NUMERIC(s) (PHT_ENTRY_TYPE(s) == IS_LONG || PHT_ENTRY_TYPE(s) == IS_DOUBLE)
 
 void pht_convert_entry_to_zval(zval *value, pht_entry_t *s);
 int pht_convert_zval_to_entry(pht_entry_t *e, zval *value);
+void pht_entry_clone(pht_entry_t *dest, pht_entry_t *src);
 void pht_entry_delete(void *entry_void);
 void pht_entry_delete_value(pht_entry_t *entry);
 pht_entry_t *pht_create_entry_from_zval(zval *value);
+void pht_closure_cache_entry_free(zval *zv);
 
 #endif
@@ -0,0 +1,86 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <main/php.h>
+
+#include "php_pht.h"
+#include "src/pht_shared_string.h"
+
+/*
+A shared string is a persistent zend_string that is stored once for any number
+of data structure entries, with its lifetime governed by the atomic refcount in
+the header before it. It is never handed to the engine directly: reading it
+gives the thread its own copy (see pht_shared_string_copy()), so that the
+string can be freed as soon as the last entry referencing it drops it.
+*/
+pht_shared_string_t *pht_shared_string_create(zend_string *s)
+{
+    pht_shared_string_t *ss = malloc(XtOffsetOf(pht_shared_string_t, str) + _ZSTR_STRUCT_SIZE(ZSTR_LEN(s)));
+
+    pht_atomic_init(&ss->refcount, 1);
+    pht_shared_string_init(&ss->str, s);
+
+    return ss;
+}
+
+/*
+Initialises str (with enough space allocated for s) as a read-only copy of s
+that can be viewed from any thread.
+*/
+void pht_shared_string_init(zend_string *str, zend_string *s)
+{
+#if PHP_VERSION_ID >= 70300
+    GC_SET_REFCOUNT(str, 1);
+    GC_TYPE_INFO(str) = IS_STRING | ((IS_STR_INTERNED | IS_STR_PERSISTENT) << GC_FLAGS_SHIFT);
+#else
+    GC_REFCOUNT(str) = 1;
+    GC_TYPE_INFO(str) = IS_STRING | ((IS_STR_INTERNED | IS_STR_PERSISTENT) << 8);
+#endif
+    ZSTR_LEN(str) = ZSTR_LEN(s);
+    memcpy(ZSTR_VAL(str), ZSTR_VAL(s), ZSTR_LEN(s));
+    ZSTR_VAL(str)[ZSTR_LEN(s)] = '\0';
+
+    // computed up front, since the hash is otherwise lazily written by readers
+    ZSTR_H(str) = ZSTR_H(s) ? ZSTR_H(s) : zend_hash_func(ZSTR_VAL(str), ZSTR_LEN(str));
+}
+
+void pht_shared_string_addref(pht_shared_string_t *ss)
+{
+    pht_atomic_inc(&ss->refcount);
+}
+
+void pht_shared_string_release(pht_shared_string_t *ss)
+{
+    if (!pht_atomic_dec(&ss->refcount)) {
+        free(ss);
+    }
+}
+
+/*
+Creates a copy of a read-only string (of a shared string or an immutable array)
+that is owned by the current thread. Its hash is carried over, so that using
+the copy as an array key does not rehash it.
+*/
+zend_string *pht_shared_string_copy(zend_string *str)
+{
+    zend_string *s = zend_string_init(ZSTR_VAL(str), ZSTR_LEN(str), 0);
+
+    ZSTR_H(s) = ZSTR_H(str);
+
+    return s;
+}
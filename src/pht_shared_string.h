@@ -0,0 +1,43 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef PHT_SHARED_STRING_H
+#define PHT_SHARED_STRING_H
+
+#include "Zend/zend.h"
+
+#include "src/pht_atomic.h"
+
+/*
+Strings of at least this length are stored once in shared memory, rather than
+being copied into each entry that holds them.
+*/
+#define PHT_SHARED_STRING_MIN_LEN 1024
+
+typedef struct _pht_shared_string_t {
+    pht_atomic_t refcount;
+    zend_string str; // must be last member
+} pht_shared_string_t;
+
+pht_shared_string_t *pht_shared_string_create(zend_string *s);
+void pht_shared_string_init(zend_string *str, zend_string *s);
+void pht_shared_string_addref(pht_shared_string_t *ss);
+void pht_shared_string_release(pht_shared_string_t *ss);
+zend_string *pht_shared_string_copy(zend_string *str);
+
+#endif
@@ -19,18 +19,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "src/pht_alloc.h"
 #include "src/pht_string.h"
 
 void pht_str_set_len(pht_string_t *pstr, int len)
 {
     PHT_STRL_P(pstr) = len;
-    PHT_STRV_P(pstr) = malloc(len + 1);
+    PHT_STRV_P(pstr) = pht_alloc(len + 1);
     PHT_STRV_P(pstr)[len] = '\0';
 }
 
 pht_string_t *pht_str_new(char *s, int len)
 {
-    pht_string_t *pstr = malloc(sizeof(pht_string_t));
+    pht_string_t *pstr = pht_alloc(sizeof(pht_string_t));
 
     pht_str_set_len(pstr, len);
     memcpy(PHT_STRV_P(pstr), s, len);
@@ -41,7 +42,7 @@ pht_string_t *pht_str_new(char *s, int len)
 void pht_str_update(pht_string_t *str, char *s, int len)
 {
     PHT_STRL_P(str) = len;
-    PHT_STRV_P(str) = malloc(len + 1);
+    PHT_STRV_P(str) = pht_alloc(len + 1);
     memcpy(PHT_STRV_P(str), s, len);
     PHT_STRV_P(str)[len] = '\0';
 }
@@ -53,5 +54,5 @@ int pht_str_eq(pht_string_t *phtstr1, pht_string_t *phtstr2)
 
 void pht_str_free(pht_string_t *str)
 {
-    free(PHT_STRV_P(str));
+    pht_free(PHT_STRV_P(str));
 }
@@ -0,0 +1,49 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-present The PHP Group                             |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Author: Thomas Punt <tpunt@php.net>                                  |
+  +----------------------------------------------------------------------+
+*/
+
+#include <main/php.h>
+#include <math.h>
+
+#ifdef PHP_WIN32
+# include "win32/time.h"
+#else
+# include <sys/time.h>
+#endif
+
+#include "src/pht_time.h"
+
+/*
+Converts a relative timeout (in seconds) into the absolute deadline expected by
+pthread_cond_timedwait().
+*/
+void pht_timespec_from_timeout(struct timespec *ts, double timeout)
+{
+    struct timeval tv;
+    double seconds = floor(timeout);
+    long nanoseconds = (long) ((timeout - seconds) * 1000000000.0);
+
+    gettimeofday(&tv, NULL);
+
+    ts->tv_sec = tv.tv_sec + (time_t) seconds;
+    ts->tv_nsec = tv.tv_usec * 1000 + nanoseconds;
+
+    if (ts->tv_nsec >= 1000000000) {
+        ++ts->tv_sec;
+        ts->tv_nsec -= 1000000000;
+    }
+}
@@ -0,0 +1,92 @@
+--TEST--
+Testing batch task submission
+--FILE--
+<?php
+
+use pht\{Thread, Pool, Runnable, AtomicInteger};
+
+class Task implements Runnable
+{
+    private $ai;
+    private $n;
+
+    public function __construct(AtomicInteger $ai, int $n)
+    {
+        $this->ai = $ai;
+        $this->n = $n;
+    }
+
+    public function run()
+    {
+        $this->ai->inc();
+        return $this->n;
+    }
+}
+
+function add(int $a, int $b) : int
+{
+    return $a + $b;
+}
+
+function sets()
+{
+    for ($i = 0; $i < 3; ++$i) {
+        yield [$i, 10];
+    }
+}
+
+$thread = new Thread();
+$ai = new AtomicInteger();
+
+$futures = $thread->addFunctionTasks('add', [[1, 2], [3, 4], [5, 6]]);
+$thread->addFunctionTasks('add', sets());
+$thread->addClassTasks(Task::class, [[$ai, 1], [$ai, 2]]);
+
+var_dump(count($futures), $thread->taskCount());
+
+$thread->start();
+
+foreach ($futures as $future) {
+    var_dump($future->get());
+}
+
+try {
+    $thread->addFunctionTasks('add', [[1, 2], 3]);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    $thread->addFunctionTasks('add', 1);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$thread->join();
+
+var_dump($ai->get());
+
+$pool = new Pool(3);
+$futures = $pool->addClassTasks(Task::class, array_map(function ($i) use ($ai) {return [$ai, $i];}, range(1, 10)));
+
+var_dump($pool->taskCount());
+
+$pool->start();
+
+var_dump(array_sum(array_map(function ($future) {return $future->get();}, $futures)));
+
+$pool->join();
+
+var_dump($ai->get());
+--EXPECT--
+int(3)
+int(8)
+int(3)
+int(7)
+int(11)
+string(67) "Argument set 2 given to Thread::addFunctionTasks() must be an array"
+string(70) "The argument sets given to Thread::addFunctionTasks() must be iterable"
+int(2)
+int(10)
+int(55)
+int(12)
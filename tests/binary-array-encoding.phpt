@@ -0,0 +1,103 @@
+--TEST--
+Testing the binary encoding of arrays passed between threads
+--FILE--
+<?php
+
+use pht\{Thread, Queue};
+
+$queue = new Queue();
+$ref = 1;
+$shared = [&$ref, &$ref];
+
+$queue->push([1, 2.5, true, false, null, 'str']);
+$queue->push(['a' => ['b' => [1, 2]], 5 => 'x', -3 => [], 'nested' => ['k' => 'v']]);
+$queue->push([3 => 'holes', 7 => 'in', 9 => 'list']);
+$queue->push(['object' => new ArrayObject([1])]);
+$queue->push($shared);
+
+$thread = new Thread();
+$thread->start();
+
+$future = $thread->addFunctionTask(function ($queue) {
+    $values = [];
+
+    while ($queue->size()) {
+        $values[] = $queue->pop();
+    }
+
+    $values[4][0] = 2; // shared references are preserved
+
+    return $values;
+}, $queue);
+
+var_dump($future->get());
+
+$thread->join();
+--EXPECTF--
+array(5) {
+  [0]=>
+  array(6) {
+    [0]=>
+    int(1)
+    [1]=>
+    float(2.5)
+    [2]=>
+    bool(true)
+    [3]=>
+    bool(false)
+    [4]=>
+    NULL
+    [5]=>
+    string(3) "str"
+  }
+  [1]=>
+  array(4) {
+    ["a"]=>
+    array(1) {
+      ["b"]=>
+      array(2) {
+        [0]=>
+        int(1)
+        [1]=>
+        int(2)
+      }
+    }
+    [5]=>
+    string(1) "x"
+    [-3]=>
+    array(0) {
+    }
+    ["nested"]=>
+    array(1) {
+      ["k"]=>
+      string(1) "v"
+    }
+  }
+  [2]=>
+  array(3) {
+    [3]=>
+    string(5) "holes"
+    [7]=>
+    string(2) "in"
+    [9]=>
+    string(4) "list"
+  }
+  [3]=>
+  array(1) {
+    ["object"]=>
+    object(ArrayObject)#%d (1) {
+      ["storage":"ArrayObject":private]=>
+      array(1) {
+        [0]=>
+        int(1)
+      }
+    }
+  }
+  [4]=>
+  array(2) {
+    [0]=>
+    &int(2)
+    [1]=>
+    &int(2)
+  }
+}
@@ -0,0 +1,70 @@
+--TEST--
+Testing the Buffer implementation
+--FILE--
+<?php
+
+use pht\{Thread, Buffer};
+
+$buffer = new Buffer();
+$buffer->write(2, 'abc');
+
+var_dump($buffer->size(), bin2hex($buffer->read(0)));
+
+var_dump($buffer->pack(5, 'nV', 0x0102, 7), $buffer->size());
+var_dump($buffer->unpack(5, 'nshort/Vlong'));
+
+$slice = $buffer->slice(2, 3);
+$slice->write(0, 'X');
+
+var_dump($buffer->read(2, 3), $slice->size());
+
+try {
+    $slice->write(2, 'long');
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$fixed = new Buffer(4, Buffer::FIXED);
+
+try {
+    $fixed->resize(8);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$mapped = new Buffer(4096, Buffer::MMAP);
+$mapped->write(4092, 'tail');
+
+$thread = new Thread();
+$thread->start();
+
+$future = $thread->addFunctionTask(function ($buffer, $slice, $mapped) {
+    $buffer->write($buffer->size(), '!');
+    $slice->write(1, 'Y');
+
+    return $mapped->read(4092);
+}, $buffer, $slice, $mapped);
+
+var_dump($future->get());
+
+$thread->join();
+
+var_dump($buffer->read(2, 3), $buffer->read($buffer->size() - 1));
+--EXPECT--
+int(5)
+string(10) "0000616263"
+int(6)
+int(11)
+array(2) {
+  ["short"]=>
+  int(258)
+  ["long"]=>
+  int(7)
+}
+string(3) "Xbc"
+int(3)
+string(56) "Invalid range - the range must be within the buffer size"
+string(49) "Fixed-size buffers (and slices) cannot be resized"
+string(4) "tail"
+string(3) "XYc"
+string(1) "!"
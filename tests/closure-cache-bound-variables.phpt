@@ -0,0 +1,41 @@
+--TEST--
+Testing that cached closures keep the values bound to each instance
+--FILE--
+<?php
+
+use pht\{Thread, Queue};
+
+$thread = new Thread();
+$queue = new Queue();
+$futures = [];
+
+$thread->start();
+
+foreach ([1, 2, 3] as $i) {
+    $futures[] = $thread->addFunctionTask(function () use ($i) {
+        return $i * 10;
+    });
+}
+
+foreach ($futures as $future) {
+    var_dump($future->get());
+}
+
+$thread->join();
+
+foreach (['a', 'b'] as $name) {
+    $queue->push(function () use ($name) {
+        return $name;
+    });
+}
+
+$first = $queue->pop();
+$second = $queue->pop();
+
+var_dump($first(), $second());
+--EXPECT--
+int(10)
+int(20)
+int(30)
+string(1) "a"
+string(1) "b"
@@ -0,0 +1,77 @@
+--TEST--
+Testing the reuse of closures materialised in a thread
+--FILE--
+<?php
+
+use pht\{Thread, Queue};
+
+$thread = new Thread();
+$queue = new Queue();
+$fn = function (int $n) {
+    static $calls = 0;
+
+    return [++$calls, $n * 2];
+};
+
+$thread->start();
+
+$futures = [];
+
+for ($i = 0; $i < 3; ++$i) {
+    $futures[] = $thread->addFunctionTask($fn, $i);
+}
+
+for ($i = 0; $i < 100; ++$i) {
+    $thread->addFunctionTask(function () {return 1;});
+}
+
+foreach ($futures as $future) {
+    var_dump($future->get());
+}
+
+$queue->push($fn);
+$queue->push($fn);
+
+$thread->join();
+
+$a = $queue->pop();
+$b = $queue->pop();
+
+var_dump($a(5), $a(5), $b(5));
+--EXPECT--
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(0)
+}
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(2)
+}
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(4)
+}
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(10)
+}
+array(2) {
+  [0]=>
+  int(2)
+  [1]=>
+  int(10)
+}
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(10)
+}
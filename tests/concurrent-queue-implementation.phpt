@@ -0,0 +1,100 @@
+--TEST--
+Testing the concurrent queue implementation
+--FILE--
+<?php
+
+use pht\{Thread, ConcurrentQueue};
+
+$queue = new ConcurrentQueue(3);
+
+$queue->lock(); // no-op
+$queue->unlock();
+
+var_dump($queue->capacity(), $queue->size());
+
+for ($i = 0; $i < 5; ++$i) {
+    var_dump($queue->tryPush([$i]));
+}
+
+var_dump($queue->size());
+
+$value = 'untouched';
+
+while ($queue->tryPop($value)) {
+    var_dump($value[0]);
+}
+
+var_dump($value, $queue->tryPop($value), $queue->tryPush(null), $queue->tryPop($value), $value);
+
+try {
+    new ConcurrentQueue(0);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$threads = [];
+$producerCount = 4;
+$itemCount = 500;
+$results = new ConcurrentQueue($producerCount);
+
+for ($i = 0; $i < $producerCount; ++$i) {
+    $threads[$i] = new Thread();
+    $threads[$i]->addFunctionTask(function ($queue, $itemCount) {
+        for ($i = 1; $i <= $itemCount; ++$i) {
+            while (!$queue->tryPush($i));
+        }
+    }, $queue, $itemCount);
+}
+
+$consumer = new Thread();
+$consumer->addFunctionTask(function ($queue, $results, $count) {
+    $sum = 0;
+
+    for ($i = 0; $i < $count; ) {
+        if ($queue->tryPop($value)) {
+            $sum += $value;
+            ++$i;
+        }
+    }
+
+    $results->tryPush($sum);
+}, $queue, $results, $producerCount * $itemCount);
+
+foreach ($threads as $thread) {
+    $thread->start();
+}
+
+$consumer->start();
+
+foreach ($threads as $thread) {
+    $thread->join();
+}
+
+$consumer->join();
+
+var_dump($results->tryPop($sum), $sum, $queue->size());
+--EXPECT--
+int(4)
+int(0)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+int(4)
+int(0)
+int(1)
+int(2)
+int(3)
+array(1) {
+  [0]=>
+  int(3)
+}
+bool(false)
+bool(true)
+bool(true)
+NULL
+string(66) "Invalid capacity given - capacity must be between 1 and 1073741824"
+bool(true)
+int(501000)
+int(0)
@@ -0,0 +1,67 @@
+--TEST--
+Testing that new threads see functions, classes, and constants declared after earlier threads started
+--FILE--
+<?php
+
+use pht\{Thread, Pool};
+
+function one() {return 1;}
+
+$t1 = new Thread();
+$t1->start();
+var_dump($t1->addFunctionTask(function () {return one() + (function_exists('two') ? 2 : 0);})->get());
+
+// conditionally declared, so that they are only bound at runtime
+if (true) {
+    function two() {return 2;}
+    class Three {const VALUE = 3;}
+}
+
+define('FOUR', 4);
+
+$t2 = new Thread();
+$t2->start();
+var_dump($t2->addFunctionTask(function () {return two() + Three::VALUE + FOUR;})->get());
+
+// workers in a pool all share the one snapshot
+$pool = new Pool(4);
+$pool->start();
+$futures = $pool->addFunctionTasks(function () {return one() + two();}, [[], [], [], []]);
+
+foreach ($futures as $future) {
+    var_dump($future->get());
+}
+
+$pool->join();
+$t1->join();
+$t2->join();
+
+ini_set('precision', '5');
+
+$t3 = new Thread();
+$t3->start();
+var_dump($t3->addFunctionTask(function () {return ini_get('precision');})->get());
+$t3->join();
+
+// the same number of modified directives, but not the same directives
+ini_restore('precision');
+ini_set('serialize_precision', '5');
+
+$t4 = new Thread();
+$t4->start();
+var_dump($t4->addFunctionTask(function () {return [ini_get('precision'), ini_get('serialize_precision')];})->get());
+$t4->join();
+--EXPECT--
+int(1)
+int(9)
+int(3)
+int(3)
+int(3)
+int(3)
+string(1) "5"
+array(2) {
+  [0]=>
+  string(2) "14"
+  [1]=>
+  string(1) "5"
+}
@@ -0,0 +1,115 @@
+--TEST--
+Testing the Future class implementation
+--FILE--
+<?php
+
+use pht\{Thread, Pool, Runnable, Future, AtomicInteger};
+
+class Task implements Runnable
+{
+    private $n;
+
+    public function __construct(int $n)
+    {
+        $this->n = $n;
+    }
+
+    public function run()
+    {
+        return [$this->n, $this->n * 2];
+    }
+}
+
+class TaskException extends Exception {}
+
+function square(int $n) : int
+{
+    return $n * $n;
+}
+
+function fail()
+{
+    throw new TaskException('failed', 3);
+}
+
+function wait(AtomicInteger $ai)
+{
+    while (!$ai->get());
+}
+
+$thread = new Thread();
+
+$f1 = $thread->addClassTask(Task::class, 4);
+$f2 = $thread->addFunctionTask('square', 5);
+$f3 = $thread->addFunctionTask('fail');
+$f4 = $thread->addFunctionTask(function () {});
+$thread->addFunctionTask('square', 6); // result discarded
+
+var_dump($f1 instanceof Future, $f4->isDone());
+
+$thread->start();
+
+var_dump($f1->get(), $f2->get(), $f2->get(), $f4->get());
+
+try {
+    $f3->get();
+} catch (TaskException $e) {
+    var_dump($e->getMessage(), $e->getCode());
+}
+
+$ai = new AtomicInteger();
+$f5 = $thread->addFunctionTask('wait', $ai);
+
+try {
+    $f5->get(0.01);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$ai->set(1);
+$f5->get();
+var_dump($f5->isDone());
+
+$thread->join();
+
+$pool = new Pool(2);
+$pool->start();
+
+$futures = [];
+
+for ($i = 0; $i < 4; ++$i) {
+    $futures[] = $pool->addFunctionTask('square', $i);
+}
+
+foreach ($futures as $future) {
+    var_dump($future->get());
+}
+
+$pool->join();
+
+try {
+    new Future();
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+--EXPECT--
+bool(true)
+bool(false)
+array(2) {
+  [0]=>
+  int(4)
+  [1]=>
+  int(8)
+}
+int(25)
+int(25)
+NULL
+string(6) "failed"
+int(3)
+string(51) "Timed out whilst waiting for the future to complete"
+bool(true)
+int(0)
+int(1)
+int(4)
+int(9)
+string(58) "Future objects can only be obtained from a task submission"
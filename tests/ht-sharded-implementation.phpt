@@ -0,0 +1,95 @@
+--TEST--
+Testing sharded hash tables
+--FILE--
+<?php
+
+use pht\{Thread, HashTable};
+
+$hashTable = new HashTable(8);
+
+$hashTable['a'] = 1;
+$hashTable[2] = [3];
+$hashTable['empty'] = 0;
+$hashTable['null'] = null;
+
+var_dump($hashTable['a'], $hashTable[2], $hashTable->size());
+var_dump(isset($hashTable['a']), isset($hashTable['null']), empty($hashTable['empty']), isset($hashTable['missing']));
+
+unset($hashTable['a'], $hashTable['null']);
+var_dump($hashTable->size(), $hashTable['a'] ?? 'gone');
+
+try {
+    $hashTable[1.5] = 1;
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    new HashTable(-1);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+// an empty, unsharded table cannot be turned into a sharded one either
+try {
+    (new HashTable())->__construct(8);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+// point operations still work whilst every shard is locked by this thread
+$hashTable->lock();
+$hashTable['b'] = 2;
+var_dump($hashTable['b'], $hashTable->size());
+$hashTable->unlock();
+
+$threads = [];
+$threadCount = 4;
+$keyCount = 250;
+
+for ($i = 0; $i < $threadCount; ++$i) {
+    $threads[$i] = new Thread();
+    $threads[$i]->addFunctionTask(function ($hashTable, $i, $keyCount) {
+        for ($j = 0; $j < $keyCount; ++$j) {
+            $hashTable["$i:$j"] = $j;
+            $hashTable[$i * $keyCount + $j + 100] = $j;
+        }
+    }, $hashTable, $i, $keyCount);
+    $threads[$i]->start();
+}
+
+foreach ($threads as $thread) {
+    $thread->join();
+}
+
+$sum = 0;
+
+foreach ((array) $hashTable as $key => $value) {
+    if (is_int($value)) {
+        $sum += $value;
+    }
+}
+
+var_dump($hashTable->size(), $sum, $hashTable["3:249"], $hashTable[100 + $keyCount]);
+--EXPECT--
+int(1)
+array(1) {
+  [0]=>
+  int(3)
+}
+int(4)
+bool(true)
+bool(false)
+bool(true)
+bool(false)
+int(2)
+string(4) "gone"
+string(19) "Invalid offset type"
+string(57) "Invalid shard count given - it must be between 0 and 1024"
+string(43) "The hash table has already been constructed"
+int(2)
+int(3)
+int(2003)
+int(249002)
+int(249)
+int(0)
@@ -0,0 +1,37 @@
+--TEST--
+Ensure idle threads are woken up by new tasks and by joining.
+--FILE--
+<?php
+
+use pht\{Thread, AtomicInteger};
+
+$ai = new AtomicInteger();
+$threads = [new Thread(), new Thread(1000)];
+
+foreach ($threads as $thread) {
+    $thread->start();
+}
+
+usleep(100000); // let both threads go idle
+
+foreach ($threads as $thread) {
+    $thread->addFunctionTask(function ($ai) {$ai->inc();}, $ai);
+}
+
+while ($ai->get() !== 2);
+
+foreach ($threads as $thread) {
+    $thread->addFunctionTask(function ($ai) {$ai->inc();}, $ai);
+    $thread->join();
+}
+
+var_dump($ai->get());
+
+try {
+    new Thread(-1);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+--EXPECT--
+int(4)
+string(60) "Invalid spin count given - it must be a non-negative integer"
@@ -0,0 +1,112 @@
+--TEST--
+Testing the ImmutableArray implementation
+--FILE--
+<?php
+
+use pht\{Thread, Queue, ImmutableArray};
+
+$config = new ImmutableArray([
+    'db' => ['host' => 'localhost', 'port' => 3306],
+    'debug' => false,
+    'ratio' => 0.5,
+    'tags' => ['a', 'b', 'c'],
+    10 => null,
+    '11' => 'numeric string key',
+]);
+
+var_dump(count($config), $config['db']['host'], $config[11], isset($config['debug']), empty($config['debug']), isset($config[10]));
+
+try {
+    $config['debug'] = true;
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+var_dump($config instanceof ArrayAccess, $config->offsetGet('ratio'), $config->offsetExists('tags'), $config->offsetExists(10));
+
+try {
+    $config->offsetUnset('ratio');
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    $config['missing'];
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    new ImmutableArray([new stdClass()]);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$queue = new Queue();
+$queue->push($config['tags']);
+
+$thread = new Thread();
+$thread->start();
+
+$future = $thread->addFunctionTask(function ($config, $queue) {
+    $values = [];
+
+    foreach ($config as $key => $value) {
+        $values[] = $key;
+    }
+
+    $tags = $queue->pop();
+
+    return [$values, $config['db']['port'], $config['tags'][2], $tags->toArray(), $config['db'] instanceof pht\ImmutableArray];
+}, $config, $queue);
+
+var_dump($future->get());
+
+$thread->join();
+--EXPECT--
+int(6)
+string(9) "localhost"
+string(18) "numeric string key"
+bool(true)
+bool(true)
+bool(false)
+string(41) "ImmutableArray objects cannot be modified"
+bool(true)
+float(0.5)
+bool(true)
+bool(false)
+string(41) "ImmutableArray objects cannot be modified"
+string(16) "Undefined offset"
+string(51) "ImmutableArray values may only be scalars or arrays"
+array(5) {
+  [0]=>
+  array(6) {
+    [0]=>
+    string(2) "db"
+    [1]=>
+    string(5) "debug"
+    [2]=>
+    string(5) "ratio"
+    [3]=>
+    string(4) "tags"
+    [4]=>
+    int(10)
+    [5]=>
+    int(11)
+  }
+  [1]=>
+  int(3306)
+  [2]=>
+  string(1) "c"
+  [3]=>
+  array(3) {
+    [0]=>
+    string(1) "a"
+    [1]=>
+    string(1) "b"
+    [2]=>
+    string(1) "c"
+  }
+  [4]=>
+  bool(true)
+}
@@ -0,0 +1,50 @@
+--TEST--
+Testing the storage of strings of varying sizes in ITC data structures
+--FILE--
+<?php
+
+use pht\{Thread, Queue, HashTable, Vector};
+
+$lengths = [0, 1, 7, 15, 16, 100, 1023, 1024, 5000];
+$strings = [];
+
+foreach ($lengths as $length) {
+    $strings[] = substr(str_repeat('0123456789', 500), 0, $length);
+}
+
+$queue = new Queue();
+$hashTable = new HashTable();
+$vector = new Vector();
+
+foreach ($strings as $i => $string) {
+    $queue->push($string);
+    $hashTable[$i] = $string;
+    $vector->push($string);
+}
+
+$thread = new Thread();
+$thread->start();
+
+$future = $thread->addFunctionTask(function ($queue, $hashTable, $vector, $strings) {
+    $matches = [];
+
+    foreach ($strings as $i => $string) {
+        $matches[] = $queue->pop() === $string && $hashTable[$i] === $string && $vector[$i] === $string;
+    }
+
+    $vector[0] = 'replaced';
+    $vector[1] = str_repeat('x', 50);
+
+    return $matches;
+}, $queue, $hashTable, $vector, $strings);
+
+var_dump(array_sum($future->get()));
+
+$thread->join();
+
+var_dump($vector[0], strlen($vector[1]), $vector->size());
+--EXPECT--
+int(9)
+string(8) "replaced"
+int(50)
+int(9)
@@ -0,0 +1,28 @@
+--TEST--
+Testing that integers keep their full range when stored in entries
+--SKIPIF--
+<?php if (PHP_INT_SIZE < 8) die('skip 64-bit only'); ?>
+--FILE--
+<?php
+
+use pht\{Thread, Queue};
+
+$queue = new Queue();
+
+$queue->push(PHP_INT_MAX);
+$queue->push(PHP_INT_MIN);
+$queue->push(-(1 << 33));
+
+var_dump($queue->pop(), $queue->pop(), $queue->pop());
+
+$thread = new Thread();
+$thread->start();
+
+var_dump($thread->addFunctionTask(function ($id) {return $id;}, 1234567890123)->get());
+
+$thread->join();
+--EXPECT--
+int(9223372036854775807)
+int(-9223372036854775808)
+int(-8589934592)
+int(1234567890123)
@@ -0,0 +1,35 @@
+--TEST--
+Testing the lazy importing of functions that create closures
+--INI--
+pht.lazy_import=1
+--FILE--
+<?php
+
+use pht\Thread;
+
+function multiplier(int $n) : Closure
+{
+    return function (int $x) use ($n) {
+        return $x * $n;
+    };
+}
+
+if (true) {
+    function conditional() : string {return 'conditional';}
+}
+
+$thread = new Thread();
+$thread->start();
+
+var_dump($thread->addFunctionTask(function () {
+    return [multiplier(3)(5), conditional()];
+})->get());
+
+$thread->join();
+--EXPECT--
+array(2) {
+  [0]=>
+  int(15)
+  [1]=>
+  string(11) "conditional"
+}
@@ -0,0 +1,71 @@
+--TEST--
+Testing the lazy importing of functions and classes into threads
+--INI--
+pht.lazy_import=1
+--FILE--
+<?php
+
+namespace NS;
+
+use pht\{Thread, Runnable};
+
+interface Greeter
+{
+    public function greet() : string;
+}
+
+trait Shouting
+{
+    public function shout(string $s) : string {return strtoupper($s);}
+}
+
+abstract class Base implements Greeter {}
+
+class Hello extends Base
+{
+    use Shouting;
+
+    public function greet() : string {return $this->shout(helper('hello'));}
+}
+
+class Task implements Runnable
+{
+    public function run()
+    {
+        return [class_exists('NS\Unused', false), (new Hello())->greet(), class_exists('NS\Hello', false)];
+    }
+}
+
+class Unused {}
+
+function helper(string $s) : string {return "$s!";}
+function unused() {}
+
+$thread = new Thread();
+$thread->start();
+
+var_dump($thread->addClassTask(Task::class)->get());
+var_dump($thread->addFunctionTask('NS\helper', 'hi')->get());
+var_dump($thread->addFunctionTask(function () {
+    return [function_exists('NS\unused'), \strlen(helper('x')), new Hello() instanceof Greeter];
+})->get());
+
+$thread->join();
+--EXPECT--
+array(3) {
+  [0]=>
+  bool(false)
+  [1]=>
+  string(6) "HELLO!"
+  [2]=>
+  bool(true)
+}
+string(3) "hi!"
+array(3) {
+  [0]=>
+  bool(false)
+  [1]=>
+  int(2)
+  [2]=>
+  bool(true)
+}
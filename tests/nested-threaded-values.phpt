@@ -0,0 +1,62 @@
+--TEST--
+Testing Threaded objects nested inside of arrays
+--FILE--
+<?php
+
+use pht\{Thread, Queue, HashTable, Vector, AtomicInteger};
+
+$in = new Queue();
+$out = new Queue();
+$counter = new AtomicInteger(0);
+
+$in->push(1);
+$in->push(2);
+
+$hashTable = new HashTable();
+$hashTable['channels'] = ['in' => $in, 'out' => $out, 'nested' => [$counter, 'label']];
+
+$vector = new Vector();
+$vector->push([$counter]);
+
+$thread = new Thread();
+$thread->start();
+
+$future = $thread->addFunctionTask(function ($channels, $hashTable, $vector) {
+    $channels['in']->lock();
+    $channels['out']->lock();
+
+    while ($channels['in']->size()) {
+        $channels['out']->push($channels['in']->pop() * 10);
+    }
+
+    $channels['out']->unlock();
+    $channels['in']->unlock();
+
+    $hashTable['channels']['nested'][0]->inc();
+    $vector[0][0]->inc();
+
+    return $channels['nested'][1];
+}, ['in' => $in, 'out' => $out, 'nested' => [$counter, 'label']], $hashTable, $vector);
+
+var_dump($future->get());
+
+$thread->join();
+
+var_dump($out->pop(), $out->pop(), $counter->get());
+
+// the stored arrays keep the objects they reference alive
+unset($in, $out, $counter);
+
+$channels = $hashTable['channels'];
+var_dump($channels['in'] instanceof Queue, $channels['nested'][0]->get());
+
+$hashTable['channels'] = [new stdClass()];
+var_dump($hashTable['channels'][0] instanceof stdClass);
+--EXPECT--
+string(5) "label"
+int(10)
+int(20)
+int(2)
+bool(true)
+int(2)
+bool(true)
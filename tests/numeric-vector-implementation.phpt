@@ -0,0 +1,98 @@
+--TEST--
+Testing the IntVector and FloatVector implementations
+--FILE--
+<?php
+
+use pht\{Thread, IntVector, FloatVector};
+
+$ints = IntVector::fromArray([3, -1, 4, 1, 5]);
+$floats = new FloatVector(3, 0.5);
+
+var_dump(count($ints), $ints->sum(), $ints->min(), $ints->max());
+var_dump($ints->getRange(1, 3), $floats->toArray());
+
+$ints[0] = 10;
+$floats->setRange(1, [2, 4.5]);
+$ints->resize(6, 2);
+
+var_dump($ints[0], $ints[5], isset($ints[6]), $floats->sum());
+var_dump(IntVector::fromArray([1, 2, 3])->dot(IntVector::fromArray([4, 5, 6])));
+
+try {
+    $ints[1] = 1.5;
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    $ints->getRange(4, 3);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    (new FloatVector())->min();
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$thread = new Thread();
+$thread->start();
+
+$future = $thread->addFunctionTask(function ($ints, $floats) {
+    $ints->scale(3);
+    $floats[0] = 1.25;
+
+    return get_class($floats);
+}, $ints, $floats);
+
+var_dump($future->get());
+
+$thread->join();
+
+var_dump($ints->toArray(), $floats[0]);
+--EXPECT--
+int(5)
+int(12)
+int(-1)
+int(5)
+array(3) {
+  [0]=>
+  int(-1)
+  [1]=>
+  int(4)
+  [2]=>
+  int(1)
+}
+array(3) {
+  [0]=>
+  float(0.5)
+  [1]=>
+  float(0.5)
+  [2]=>
+  float(0.5)
+}
+int(10)
+int(2)
+bool(false)
+float(7)
+int(32)
+string(64) "Invalid value type - only integers can be stored in an IntVector"
+string(56) "Invalid range - the range must be within the vector size"
+string(48) "Attempted to find the minimum of an empty vector"
+string(15) "pht\FloatVector"
+array(6) {
+  [0]=>
+  int(30)
+  [1]=>
+  int(-3)
+  [2]=>
+  int(12)
+  [3]=>
+  int(3)
+  [4]=>
+  int(15)
+  [5]=>
+  int(6)
+}
+float(1.25)
@@ -0,0 +1,65 @@
+--TEST--
+Testing the sharing of opcodes between threads
+--INI--
+pht.share_opcodes=1
+--FILE--
+<?php
+
+use pht\{Thread, Runnable};
+
+function counter()
+{
+    static $count = 0;
+
+    return ++$count;
+}
+
+function describe(array $values, string $prefix = 'values') : string
+{
+    try {
+        if (!$values) {
+            throw new Exception('empty');
+        }
+
+        return "$prefix: " . implode(', ', array_map(function ($v) {return $v * 2;}, $values));
+    } catch (Exception $e) {
+        return $e->getMessage();
+    }
+}
+
+class Task implements Runnable
+{
+    private const PREFIX = 'doubled';
+
+    public function run()
+    {
+        return [counter(), counter(), describe([1, 2, 3], self::PREFIX), describe([])];
+    }
+}
+
+$thread = new Thread();
+$thread->start();
+
+var_dump($thread->addClassTask(Task::class)->get());
+var_dump($thread->addFunctionTask('counter')->get());
+var_dump($thread->addFunctionTask(function () {
+    return describe([4]);
+})->get());
+
+$thread->join();
+
+var_dump(counter());
+--EXPECT--
+array(4) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(2)
+  [2]=>
+  string(16) "doubled: 2, 4, 6"
+  [3]=>
+  string(5) "empty"
+}
+int(3)
+string(9) "values: 8"
+int(1)
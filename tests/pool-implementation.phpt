@@ -0,0 +1,68 @@
+--TEST--
+Testing the Pool class implementation
+--FILE--
+<?php
+
+use pht\{Pool, Runnable, AtomicInteger};
+
+class Task implements Runnable
+{
+    private $ai;
+
+    public function __construct(AtomicInteger $ai)
+    {
+        $this->ai = $ai;
+    }
+
+    public function run()
+    {
+        $this->ai->inc();
+    }
+}
+
+function task(AtomicInteger $ai, int $sleep)
+{
+    usleep($sleep);
+    $ai->inc();
+}
+
+$ai = new AtomicInteger();
+$pool = new Pool(4);
+
+var_dump($pool->size());
+
+for ($i = 0; $i < 10; ++$i) {
+    $pool->addClassTask(Task::class, $ai);
+    // uneven task lengths, so that idle threads have to steal work
+    $pool->addFunctionTask('task', $ai, $i % 4 ? 0 : 10000);
+}
+
+var_dump($pool->taskCount());
+
+$pool->start();
+
+while ($ai->get() !== 20);
+
+$pool->join();
+
+var_dump($ai->get(), $pool->taskCount(), $pool->inFlightCount());
+
+try {
+    $pool->join();
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    new Pool(0);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+--EXPECT--
+int(4)
+int(20)
+int(20)
+int(0)
+int(0)
+string(32) "The pool has already been joined"
+string(55) "Invalid pool size given - it must be a positive integer"
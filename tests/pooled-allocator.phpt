@@ -0,0 +1,57 @@
+--TEST--
+Testing the pooled allocator used by the ITC data structures
+--INI--
+pht.pooled_allocator=1
+--FILE--
+<?php
+
+use pht\{Thread, Queue};
+
+$queue = new Queue();
+$thread = new Thread();
+
+$before = pht\allocator_stats();
+
+var_dump(array_keys($before), $before['pooled']);
+
+for ($i = 0; $i < 1000; ++$i) {
+    $queue->push("value $i");
+}
+
+$during = pht\allocator_stats();
+
+var_dump($during['bytes_in_use'] > $before['bytes_in_use']);
+var_dump($during['bytes_reserved'] >= $during['bytes_in_use']);
+
+$thread->start();
+
+$thread->addFunctionTask(function ($queue) {
+    while ($queue->size()) {
+        $queue->pop();
+    }
+}, $queue);
+
+$thread->join();
+
+$after = pht\allocator_stats();
+
+var_dump($queue->size());
+var_dump($after['bytes_in_use'] < $during['bytes_in_use']);
+var_dump($after['bytes_pooled_free'] > 0);
+--EXPECT--
+array(4) {
+  [0]=>
+  string(6) "pooled"
+  [1]=>
+  string(12) "bytes_in_use"
+  [2]=>
+  string(17) "bytes_pooled_free"
+  [3]=>
+  string(14) "bytes_reserved"
+}
+bool(true)
+bool(true)
+bool(true)
+int(0)
+bool(true)
+bool(true)
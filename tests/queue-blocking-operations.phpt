@@ -0,0 +1,86 @@
+--TEST--
+Testing the blocking operations of queues
+--FILE--
+<?php
+
+use pht\{Thread, Queue};
+
+$queue = new Queue(2);
+
+var_dump($queue->capacity(), (new Queue())->capacity());
+
+try {
+    $queue->__construct(); // would otherwise make the queue unbounded
+} catch (Error $e) {
+    var_dump($e->getMessage(), $queue->capacity());
+}
+
+$queue->push(1);
+$queue->waitPush(2);
+
+try {
+    $queue->push(3);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    $queue->waitPush(3, 0.01);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+var_dump($queue->waitPop(), $queue->waitPop(0), $queue->size());
+
+try {
+    $queue->waitPop(0.01);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$queue->lock();
+
+try {
+    $queue->waitPop();
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$queue->unlock();
+
+$thread = new Thread();
+$itemCount = 50;
+
+$thread->addFunctionTask(function ($queue, $itemCount) {
+    for ($i = 1; $i <= $itemCount; ++$i) {
+        $queue->waitPush($i); // blocks whenever the consumer falls behind
+    }
+
+    $queue->waitPush(null);
+}, $queue, $itemCount);
+
+$thread->start();
+
+$sum = 0;
+
+while (($value = $queue->waitPop()) !== null) {
+    $sum += $value;
+}
+
+$thread->join();
+
+var_dump($sum, $queue->size());
+--EXPECT--
+int(2)
+int(0)
+string(38) "The queue has already been constructed"
+int(2)
+string(46) "Attempted to push an element onto a full queue"
+string(42) "Timed out whilst waiting for space to push"
+int(1)
+int(2)
+int(0)
+string(46) "Timed out whilst waiting for an element to pop"
+string(52) "This mutex lock is already being held by this thread"
+int(1275)
+int(0)
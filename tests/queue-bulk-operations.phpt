@@ -0,0 +1,76 @@
+--TEST--
+Testing the bulk operations of queues
+--FILE--
+<?php
+
+use pht\{Thread, Queue};
+
+$queue = new Queue();
+$value = 'c';
+
+$queue->pushMany(['x' => 'a', 'y' => 'b', 'z' => &$value]);
+$queue->pushMany([]);
+$queue->lock();
+$queue->push('d');
+$queue->unlock();
+
+var_dump($queue->size(), $queue->popMany(2), $queue->popMany(10), $queue->popMany(1), $queue->drain());
+
+try {
+    $queue->popMany(0);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+
+$bounded = new Queue(3);
+$bounded->pushMany([1, 2]);
+
+try {
+    $bounded->pushMany([3, 4]);
+} catch (Error $e) {
+    var_dump($e->getMessage(), $bounded->size());
+}
+
+$thread = new Thread();
+$batchCount = 10;
+
+$thread->addFunctionTask(function ($queue, $batchCount) {
+    for ($i = 0; $i < $batchCount; ++$i) {
+        $queue->pushMany(range($i * 10 + 1, $i * 10 + 10));
+    }
+}, $queue, $batchCount);
+
+$thread->start();
+
+for ($popped = 0; $popped < $batchCount * 10; ) {
+    $queue->waitPop(); // wait for the next batch to begin arriving
+    $batch = $queue->drain();
+    $popped += 1 + count($batch);
+}
+
+$thread->join();
+
+var_dump($popped, $queue->size());
+--EXPECT--
+int(4)
+array(2) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(1) "b"
+}
+array(2) {
+  [0]=>
+  string(1) "c"
+  [1]=>
+  string(1) "d"
+}
+array(0) {
+}
+array(0) {
+}
+string(62) "Invalid maximum given - the maximum must be a positive integer"
+string(60) "Attempted to push more elements than the queue has space for"
+int(2)
+int(100)
+int(0)
@@ -0,0 +1,55 @@
+--TEST--
+Testing queues holding elements across many storage segments
+--FILE--
+<?php
+
+use pht\Queue;
+
+$queue = new Queue();
+$expected = 0;
+$next = 0;
+$ok = true;
+
+// interleave pushes and pops, so that segments are emptied and reused
+for ($round = 0; $round < 20; ++$round) {
+    for ($i = 0; $i < 45; ++$i) {
+        $queue->push($next++);
+    }
+
+    for ($i = 0; $i < 40; ++$i) {
+        $ok = $ok && $queue->front() === $expected && $queue->pop() === $expected;
+        ++$expected;
+    }
+}
+
+var_dump($ok, $queue->size());
+
+$batch = $queue->popMany(37); // ends part-way through a segment
+var_dump(count($batch), $batch[0] === $expected, $batch[36] === $expected + 36);
+
+$expected += 37;
+$properties = (array) $queue;
+var_dump(count($properties), $properties[0] === $expected, end($properties) === $next - 1);
+
+$rest = $queue->drain();
+var_dump(count($rest), $rest[0] === $expected, $queue->size(), $queue->drain());
+
+$queue->pushMany(range(1, 100));
+$queue->push(101);
+var_dump($queue->size(), array_sum($queue->drain()));
+--EXPECT--
+bool(true)
+int(100)
+int(37)
+bool(true)
+bool(true)
+int(63)
+bool(true)
+bool(true)
+int(63)
+bool(true)
+int(0)
+array(0) {
+}
+int(101)
+int(5151)
@@ -0,0 +1,49 @@
+--TEST--
+Testing the sharing of large strings between threads
+--FILE--
+<?php
+
+use pht\{Thread, HashTable};
+
+$ht = new HashTable();
+$html = str_repeat('<p>fragment</p>', 200);
+
+$ht['html'] = $html;
+$ht['small'] = 'abc';
+
+$thread = new Thread();
+$thread->start();
+
+$future = $thread->addFunctionTask(function ($ht) {
+    $a = $ht['html'];
+    $b = $ht['html'];
+    $c = $a . '!';
+
+    $ht['copy'] = $a;
+    $ht['html'] = null; // the thread's copy remains valid after the entry is dropped
+
+    return [strlen($a), $a === $b, strlen($c), substr($c, -5), [$a => 1] === [$b => 1], $ht['small']];
+}, $ht);
+
+var_dump($future->get());
+
+$thread->join();
+
+var_dump($ht['copy'] === $html, $ht['html']);
+--EXPECT--
+array(6) {
+  [0]=>
+  int(3000)
+  [1]=>
+  bool(true)
+  [2]=>
+  int(3001)
+  [3]=>
+  string(5) "</p>!"
+  [4]=>
+  bool(true)
+  [5]=>
+  string(3) "abc"
+}
+bool(true)
+NULL
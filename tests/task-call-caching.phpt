@@ -0,0 +1,77 @@
+--TEST--
+Testing the caching of resolved classes and callables for tasks
+--FILE--
+<?php
+
+use pht\{Thread, Pool, Runnable};
+
+class Task implements Runnable
+{
+    private $n;
+
+    public function __construct(int $n) {$this->n = $n;}
+
+    public function run() {return $this->n;}
+}
+
+class Maths
+{
+    public static function double(int $n) : int {return $n * 2;}
+}
+
+$thread = new Thread();
+$thread->start();
+
+$results = [];
+
+for ($i = 0; $i < 3; ++$i) {
+    $results[] = $thread->addClassTask(Task::class, $i);
+    $results[] = $thread->addFunctionTask('strtoupper', 'a');
+    $results[] = $thread->addFunctionTask([Maths::class, 'double'], $i);
+}
+
+$thread->addFunctionTask(function () {});
+
+foreach ($results as $result) {
+    echo $result->get(), ' ';
+}
+
+echo PHP_EOL;
+
+$thread->join();
+
+var_dump($thread->cacheStats());
+
+$pool = new Pool(2);
+$pool->start();
+$pool->addClassTasks(Task::class, [[1], [2], [3], [4]]);
+$pool->join();
+
+$stats = $pool->cacheStats();
+
+var_dump($stats['classes']['hits'] + $stats['classes']['misses'], $stats['functions']);
+--EXPECT--
+0 A 0 1 A 2 2 A 4 
+array(2) {
+  ["classes"]=>
+  array(2) {
+    ["hits"]=>
+    int(2)
+    ["misses"]=>
+    int(1)
+  }
+  ["functions"]=>
+  array(2) {
+    ["hits"]=>
+    int(4)
+    ["misses"]=>
+    int(2)
+  }
+}
+int(4)
+array(2) {
+  ["hits"]=>
+  int(0)
+  ["misses"]=>
+  int(0)
+}
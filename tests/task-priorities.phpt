@@ -0,0 +1,63 @@
+--TEST--
+Testing task priorities
+--FILE--
+<?php
+
+use pht\{Thread, Pool, Queue};
+
+function record(Queue $queue, string $name)
+{
+    $queue->lock();
+    $queue->push($name);
+    $queue->unlock();
+}
+
+$queue = new Queue();
+$thread = new Thread();
+
+$thread->setTaskPriority(Thread::PRIORITY_LOW);
+$thread->addFunctionTask('record', $queue, 'low');
+$thread->setTaskPriority(Thread::PRIORITY_NORMAL);
+$thread->addFunctionTask('record', $queue, 'normal');
+$thread->setTaskPriority(Thread::PRIORITY_HIGH);
+$thread->addFunctionTasks('record', [[$queue, 'high1'], [$queue, 'high2']]);
+
+$thread->start();
+$thread->join();
+
+while ($queue->size()) {
+    var_dump($queue->pop());
+}
+
+// a starved task is run after being passed over 16 times
+$thread = new Thread();
+
+$thread->setTaskPriority(Thread::PRIORITY_LOW);
+$thread->addFunctionTask('record', $queue, 'low');
+$thread->setTaskPriority(Thread::PRIORITY_HIGH);
+
+for ($i = 0; $i < 20; ++$i) {
+    $thread->addFunctionTask('record', $queue, 'high');
+}
+
+$thread->start();
+$thread->join();
+
+for ($i = 0; $queue->size(); ++$i) {
+    if ($queue->pop() === 'low') {
+        var_dump($i);
+    }
+}
+
+try {
+    (new Pool(1))->setTaskPriority(3);
+} catch (Error $e) {
+    var_dump($e->getMessage());
+}
+--EXPECT--
+string(5) "high1"
+string(5) "high2"
+string(6) "normal"
+string(3) "low"
+int(15)
+string(72) "Invalid task priority given - it must be one of the PRIORITY_* constants"